@@ -8,13 +8,17 @@
  */
 
 using static ASE.Config;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 
 namespace ASE
 {
-    public static class ACIA
+    public class ACIA
     {
-        private static readonly object _syncLock = new object();
+        readonly Machine _machine;
+
+        // Bytes are pushed from the UI thread and read by the emulator thread
+        private readonly object _syncLock = new object();
 
         public const byte ACIA_RDRF = 1 << 0;
         public const byte ACIA_TDRE = 1 << 1;
@@ -22,23 +26,25 @@ namespace ASE
         public const byte ACIA_OVRN = 1 << 5; // Overrun Error
         public const byte ACIA_FE = 1 << 4;   // Framing Error
 
-        public static Queue<byte> IkbdRx = new();
+        public Queue<byte> IkbdRx = new();
 
-        public static byte AciaKbdStatus;   // ACIA Status register
-        public static byte AciaKbdControl;  // ACIA Control register
+        public byte AciaKbdStatus;   // ACIA Status register
+        public byte AciaKbdControl;  // ACIA Control register
 
         // CPU cycles per byte (7812.5 baud @ 8MHz ~= 10240 cycles)
         private const int CYCLES_PER_BYTE = 10240;
-        private static int _cyclesUntilNextByte = 0;
 
-        public static byte JoystickState = 0;
+        // Set while the next byte is scheduled as CPU.EventId.AciaRx
+        private bool _rxScheduled = false;
+
+        public byte JoystickState = 0;
 
-        private static List<byte> _commandBuffer = new List<byte>();
+        private List<byte> _commandBuffer = new List<byte>();
 
         // Enabled or disabled for the ACIA chip
         // Confirmation pending: after IKBD reset, both mouse and joystick are active?
-        public static bool JoystickEnabled = true;
-        public static bool MouseEnabled = true;
+        public bool JoystickEnabled = true;
+        public bool MouseEnabled = true;
 
         // for the joy -> bit 0 up, 1: down, 2: left, 3: right, 7: fire
         public const byte JOY_UP = 0x01;
@@ -48,10 +54,19 @@ namespace ASE
         public const byte JOY_FIRE = 0x80;
 
         // for the mouse -> bit 0 = No button, 1 = right, 2 = left
-        public static int _mouseButtons = 0;
+        private int _mouseButtons = 0;
+
+        // Input from the host waits here for the next scanline, see Sync
+        private readonly ConcurrentQueue<InputEvent> _input = new();
+
+        /// <summary>Records the input applied, see <see cref="InputLog"/>.</summary>
+        public InputLog.InputRecorder? Recorder;
+
+        /// <summary>Recorded input applied instead of the host's, which is ignored while it is set.</summary>
+        public InputLog.InputReplay? Replay;
 
-        private static byte _latchedData = 0;
-        private static bool _hasLatchedData = false;
+        private byte _latchedData = 0;
+        private bool _hasLatchedData = false;
 
         // IKBD command length table (from Hatari ikbd.c KeyboardCommands[])
         // Key = first byte (command), Value = total bytes expected (including command byte)
@@ -149,7 +164,12 @@ namespace ASE
             0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0, 0
         };
 
-        public static void Reset()
+        public ACIA(Machine machine)
+        {
+            _machine = machine;
+        }
+
+        public void Reset()
         {
             lock (_syncLock)
             {
@@ -160,7 +180,7 @@ namespace ASE
 
                 _hasLatchedData = false;
                 _latchedData = 0;
-                _cyclesUntilNextByte = 0;
+                CancelRx();
 
                 AciaKbdStatus = ACIA_TDRE;
                 AciaKbdControl = 0;
@@ -170,49 +190,173 @@ namespace ASE
                 MouseEnabled = true;
 
                 // MFP IRQ On
-                ASEMain._mfp.SetGPIOBit(4, true);
+                _machine.Mfp.SetGPIOBit(4, true);
             }
         }
 
-        public static void Sync(int cycles)
+        public void SaveState(BinaryWriter w)
         {
             lock (_syncLock)
             {
-                // If there’s already a byte waiting for the CPU to read,
-                // PAUSE TIME. I don’t pull anything else from the queue.
-                // This protects the st from receiving data faster than it can read it.
-                if (_hasLatchedData) return;
-
-                // If there’s nothing in the queue, reset the counter so that the
-                // next incoming byte is instantaneous (start bit).
-                if (IkbdRx.Count == 0)
-                {
-                    _cyclesUntilNextByte = 0;
+                w.Write(AciaKbdStatus);
+                w.Write(AciaKbdControl);
+                w.Write(_latchedData);
+                w.Write(_hasLatchedData);
+                w.Write(_rxScheduled);
+
+                w.Write(IkbdRx.Count);
+                foreach (byte b in IkbdRx)
+                    w.Write(b);
+
+                w.Write(_commandBuffer.Count);
+                foreach (byte b in _commandBuffer)
+                    w.Write(b);
+
+                w.Write(JoystickState);
+                w.Write(_mouseButtons);
+                w.Write(JoystickEnabled);
+                w.Write(MouseEnabled);
+            }
+        }
+
+        public void LoadState(BinaryReader r)
+        {
+            lock (_syncLock)
+            {
+                AciaKbdStatus = r.ReadByte();
+                AciaKbdControl = r.ReadByte();
+                _latchedData = r.ReadByte();
+                _hasLatchedData = r.ReadBoolean();
+                _rxScheduled = r.ReadBoolean();
+
+                IkbdRx.Clear();
+                for (int n = r.ReadInt32(); n > 0; n--)
+                    IkbdRx.Enqueue(r.ReadByte());
+
+                _commandBuffer.Clear();
+                for (int n = r.ReadInt32(); n > 0; n--)
+                    _commandBuffer.Add(r.ReadByte());
+
+                JoystickState = r.ReadByte();
+                _mouseButtons = r.ReadInt32();
+                JoystickEnabled = r.ReadBoolean();
+                MouseEnabled = r.ReadBoolean();
+            }
+        }
+
+        /// <summary>
+        /// Applies the input queued by the host and delivers the first byte of a burst, called on every scanline.
+        /// </summary>
+        /// <remarks>Input comes from the UI thread at any time, applying it here makes the cycle it lands at depend
+        /// on the emulation only, so it can be recorded and replayed. The first byte of a burst is picked up here,
+        /// the following ones are scheduled from <see cref="ReadData"/> CYCLES_PER_BYTE after the CPU frees the
+        /// receive register.</remarks>
+        public void Sync()
+        {
+            ApplyInput();
+
+            lock (_syncLock)
+            {
+                // If there’s already a byte waiting for the CPU to read (or the next one
+                // is on its way), nothing to do. This protects the st from receiving data
+                // faster than it can read it.
+                if (_hasLatchedData || _rxScheduled || IkbdRx.Count == 0)
                     return;
-                }
 
-                // Hay datos en la cola y el registro está libre. Avanzamos el tiempo.
-                _cyclesUntilNextByte -= cycles;
+                // Idle line: the next incoming byte is instantaneous (start bit).
+                DeliverByte();
+            }
+        }
 
-                if (_cyclesUntilNextByte <= 0)
-                {
-                    // Movemos el dato al registro visible
-                    _latchedData = IkbdRx.Dequeue();
-                    _hasLatchedData = true;
+        /// <summary>
+        /// CPU.EventId.AciaRx handler, the next byte has been received.
+        /// </summary>
+        public void OnRxEvent(long cycle)
+        {
+            lock (_syncLock)
+            {
+                _rxScheduled = false;
 
-                    // Activamos flags
-                    AciaKbdStatus |= (ACIA_RDRF | ACIA_IRQ);
+                if (!_hasLatchedData && IkbdRx.Count > 0)
+                    DeliverByte();
+            }
+        }
+
+        private void DeliverByte()
+        {
+            // Movemos el dato al registro visible
+            _latchedData = IkbdRx.Dequeue();
+            _hasLatchedData = true;
 
-                    // Disparamos interrupción (Línea Baja = Activa)
-                    ASEMain._mfp.SetGPIOBit(4, false);
+            // Activamos flags
+            AciaKbdStatus |= (ACIA_RDRF | ACIA_IRQ);
 
-                    // Reiniciamos el temporizador para el SIGUIENTE byte
-                    _cyclesUntilNextByte = CYCLES_PER_BYTE;
+            // Disparamos interrupción (Línea Baja = Activa)
+            _machine.Mfp.SetGPIOBit(4, false);
+        }
+
+        private void ApplyInput()
+        {
+            if (Replay != null)
+            {
+                long clock = _machine.Cpu.Clock;
+                while (Replay.TryTake(clock, out InputEvent e))
+                    Apply(e);
+                return;
+            }
+
+            if (_input.IsEmpty)
+                return;
+
+            long now = _machine.Cpu.Clock;
+            while (_input.TryDequeue(out InputEvent e))
+            {
+                Recorder?.Write(now, e);
+                Apply(e);
+            }
+        }
+
+        private void Apply(InputEvent e)
+        {
+            lock (_syncLock)
+            {
+                switch (e.Kind)
+                {
+                    case InputKind.Key:
+                        PushIkbd_Internal(e.A);
+                        break;
+                    case InputKind.Mouse:
+                        ApplyMousePacket((sbyte)e.A, (sbyte)e.B);
+                        break;
+                    case InputKind.MouseButton:
+                        if (e.B != 0)
+                            _mouseButtons |= e.A;
+                        else
+                            _mouseButtons &= ~e.A;
+
+                        // Fuerza la actualización del ratón en el ST
+                        ApplyMousePacket(0, 0);
+                        break;
+                    case InputKind.Joystick:
+                        ApplyJoystick(e.A, e.B != 0);
+                        break;
                 }
             }
         }
 
-        public static void WriteControl(byte v)
+        private void QueueInput(InputKind kind, byte a, byte b)
+        {
+            if (Replay == null)
+                _input.Enqueue(new InputEvent(kind, a, b));
+        }
+
+        private void CancelRx()
+        {
+            _rxScheduled = false;
+            _machine.Cpu.CancelEvent((int)CPU.EventId.AciaRx);
+        }
+
+        public void WriteControl(byte v)
         {
             lock (_syncLock)
             {
@@ -227,7 +371,7 @@ namespace ASE
             }
         }
 
-        public static byte ReadStatus()
+        public byte ReadStatus()
         {
             lock (_syncLock)
             {
@@ -235,7 +379,7 @@ namespace ASE
             }
         }
 
-        public static byte ReadData()
+        public byte ReadData()
         {
             lock (_syncLock)
             {
@@ -248,10 +392,14 @@ namespace ASE
                 AciaKbdStatus &= unchecked((byte)~(ACIA_RDRF | ACIA_IRQ | ACIA_OVRN | ACIA_FE));
 
                 // IMPORTANTE: Subimos la línea de interrupción (Inactiva)
-                ASEMain._mfp.SetGPIOBit(4, true);
+                _machine.Mfp.SetGPIOBit(4, true);
 
-                // No tocamos _cyclesUntilNextByte. El método Sync() empezará a contar
-                // en la siguiente iteración del emulador.
+                // The next byte arrives one byte time after the register is free
+                if (IkbdRx.Count > 0 && !_rxScheduled)
+                {
+                    _rxScheduled = true;
+                    _machine.Cpu.ScheduleEvent(_machine.Cpu.Clock + CYCLES_PER_BYTE, (int)CPU.EventId.AciaRx);
+                }
 
                 return result;
             }
@@ -272,7 +420,7 @@ namespace ASE
         // WITHOUT this logic, any unrecognized multi-byte command
         // (like 0x07 sent by TOS) will jam the buffer and prevent
         // ALL subsequent commands from being processed.
-        public static void HandleCommand(byte b)
+        public void HandleCommand(byte b)
         {
             lock (_syncLock)
             {
@@ -303,7 +451,7 @@ namespace ASE
             }
         }
 
-        private static void ExecuteCommand(byte cmd)
+        private void ExecuteCommand(byte cmd)
         {
             // Already inside _syncLock from HandleCommand
 
@@ -316,10 +464,10 @@ namespace ASE
                         JoystickState = 0;
 
                         _hasLatchedData = false;
-                        _cyclesUntilNextByte = 0;
+                        CancelRx();
 
                         AciaKbdStatus &= unchecked((byte)~(ACIA_RDRF | ACIA_IRQ));
-                        ASEMain._mfp.SetGPIOBit(4, true);
+                        _machine.Mfp.SetGPIOBit(4, true);
 
                         // After reset, both mouse and joystick are active
                         // (matches Hatari's IKBD_Boot_ROM)
@@ -437,37 +585,51 @@ namespace ASE
             }
         }
 
-        public static void SendMousePacket(int dx, int dy)
+        // Input from the host. Queued for the next scanline, see Sync.
+
+        public void SendMousePacket(int dx, int dy)
         {
-            lock (_syncLock)
-            {
-                if (!MouseEnabled) return;
+            dx = dx / ConfigOptions.RunninConfig.MouseXSensitivity;
+            dy = dy / ConfigOptions.RunninConfig.MouseYSensitivity;
+            if (dx < -127) dx = -127; if (dx > 127) dx = 127;
+            if (dy < -127) dy = -127; if (dy > 127) dy = 127;
 
-                dx = dx / ConfigOptions.RunninConfig.MouseXSensitivity;
-                dy = dy / ConfigOptions.RunninConfig.MouseYSensitivity;
-                if (dx < -127) dx = -127; if (dx > 127) dx = 127;
-                if (dy < -127) dy = -127; if (dy > 127) dy = 127;
+            QueueInput(InputKind.Mouse, (byte)(sbyte)dx, (byte)(sbyte)dy);
+        }
 
-                PushIkbd_Internal((byte)(0xF8 | _mouseButtons));
-                PushIkbd_Internal((byte)dx);
-                PushIkbd_Internal((byte)dy);
-            }
+        /// <summary>
+        /// Presses or releases a mouse button (0x02 left, 0x01 right) and sends the packet that reports it.
+        /// </summary>
+        public void SetMouseButton(int button, bool pressed)
+        {
+            QueueInput(InputKind.MouseButton, (byte)button, (byte)(pressed ? 1 : 0));
         }
 
-        public static void PushIkbd(byte b)
+        public void PushIkbd(byte b)
         {
-            lock (_syncLock)
-            {
-                PushIkbd_Internal(b);
-            }
+            QueueInput(InputKind.Key, b, 0);
+        }
+
+        public void UpdateJoystick(byte mask, bool pressed)
+        {
+            QueueInput(InputKind.Joystick, mask, (byte)(pressed ? 1 : 0));
+        }
+
+        private void ApplyMousePacket(int dx, int dy)
+        {
+            if (!MouseEnabled) return;
+
+            PushIkbd_Internal((byte)(0xF8 | _mouseButtons));
+            PushIkbd_Internal((byte)dx);
+            PushIkbd_Internal((byte)dy);
         }
 
-        private static void PushIkbd_Internal(byte b)
+        private void PushIkbd_Internal(byte b)
         {
             IkbdRx.Enqueue(b);
         }
 
-        public static void UpdateJoystick(byte mask, bool pressed)
+        private void ApplyJoystick(byte mask, bool pressed)
         {
             lock (_syncLock)
             {
@@ -10,7 +10,6 @@ using System.Diagnostics;
 using Avalonia.Threading;
 using TinyDialogsNet;
 using static ASE.Config;
-using static ASE.Video;
 using static SDL2.SDL;
 
 namespace ASE
@@ -21,28 +20,29 @@ namespace ASE
         public const int ScreenHeight = 400;
         public const int ScreenViewSize = ScreenWidth * ScreenHeight;
 
-        public static Memory? _mem;
-        public static MFP68901? _mfp;
-        public static YM2149 _ym;
+        // The machine shown in the window, replaced on every power on
+        public static Machine? Machine;
 
         static SDL.SDL_AudioCallback _audiocallback;
         static uint _audiodev;
+        static int _audioDeviceSamples;     // Samples the device takes per callback
+
+        // The emulator thread sleeps on it between frames, set to wake it at once
+        static readonly AutoResetEvent _pacing = new AutoResetEvent(false);
         static nint GamepadController;
         const int GamepadDeadzone = 8000;
 
         public static FloppyImage driveA = new FloppyImage();
         public static FloppyImage driveB = new FloppyImage();
 
-        public static uint[] ScreenBuffer = new uint[ScreenViewSize];
+        // Screen buffers handed from the emulator thread to the GL control, kept across power ons
+        public static readonly FrameRing Frames = new FrameRing(ScreenViewSize);
         public static bool IsMouseCaptured = false;
         public static MainWindow MainWindow;
 
-        static readonly object _syncLock = new object();
         static Thread _thread;
         static bool _isRunning;
 
-        static public event Action OnFrameComplete;
-
         static public void Init(MainWindow mainWindow)
         {
             MainWindow = mainWindow;
@@ -88,6 +88,8 @@ namespace ASE
                 ConfigOptions.RunninConfig.SampleRate = have.freq;
             }
 
+            _audioDeviceSamples = have.samples;
+
             SDL.SDL_PauseAudioDevice(_audiodev, 0); // Turn on sound
 
             TurnOn();
@@ -99,98 +101,13 @@ namespace ASE
             const double frame = 1.0 / 50.0; // 1 ST pal frame -> 0.02 s
             var sw = Stopwatch.StartNew();
             double next = 0.0;
-            var last = Stopwatch.StartNew();
+            double fillError = 0.0;
+
+            Machine machine = Machine!;
 
             while (_isRunning)
             {
-                uint frameStart = SDL_GetTicks();
-
-                uint baseHigh = _mem.Read8(Memory.STPortAdress.ST_SCRHIGHADDR);
-                uint baseMid = _mem.Read8(Memory.STPortAdress.ST_SCRMIDADDR);
-                uint videoBase = (baseHigh << 16) | (baseMid << 8);  // low byte 0 en ST
-                uint videoCounter = videoBase;
-
-                _mem.Write8(Memory.STPortAdress.ST_HIVADRPOINT, (byte)baseHigh);
-                _mem.Write8(Memory.STPortAdress.ST_MIVADRPOINT, (byte)baseMid);
-                _mem.Write8(Memory.STPortAdress.ST_LOVADRPOINT, (byte)0);
-
-                /*
-                 * The PAL Color Atari ST has 313 full scanlines per vertical synchronization (vsync), 
-                 * of which 200 are visible lines and 112 belong to the top and bottom borders. 
-                 * In monochrome mode, there would be 400 visible and 100 non-visible lines, 
-                 * but in this emulator we will only support color mode.
-                 */
-                for (int scanline = 0; scanline < 313; scanline++)
-                {
-                    int ElapsedCycles = 0;
-
-                    // Each scanline lasts 512 CPU cycles at 8 MHz = 15.66 kHz, or 64 microseconds.
-
-                    /*
-                     * This is how screen synchronization is handled in this emulator. It is not the most accurate method, 
-                     * but it is sufficient for the vast majority of ST games and programs. I ported this loop directly 
-                     * from the MS-DOS version of ASE, and it would need to be rewritten in order to also synchronize what 
-                     * happens in the screen borders in some demos and games.
-                     * 
-                     *              448 cycles active display + 64 cycles H-Blank (right border)
-                     *              -------------------+++
-                     *              ********************** <- Top border (not rendered)
-                     *              **********************
-                     *              ***                *** <- Active display starts here (scanline 63)
-                     *              ***                ***
-                     *              ***                ***
-                     *              ***                ***
-                     *              ***                *** <- Active display ends here (scanline 262)
-                     *              **********************
-                     *              ********************** <- Bottom border (not rendered), Vsync
-                     */
-
-                    // Active display
-                    int cyclesDuringScreenActive = 448; // 512 (total cycles/scanline) - 64 (right border) cycles;
-                    CPU._moira.RunForCycles(cyclesDuringScreenActive);
-                    ElapsedCycles += cyclesDuringScreenActive;
-
-                    // Sync audio
-                    _ym.Sync(cyclesDuringScreenActive);
-                    // Sync interrupts
-                    _mfp.UpdateTimers(cyclesDuringScreenActive);
-
-                    // Actives H-Blank (right border)
-                    int cyclesDuringHBL = 64;
-                    CPU._moira.RunForCycles(cyclesDuringHBL);
-                    ElapsedCycles += cyclesDuringHBL;
-
-                    // Sync audio again
-                    _ym.Sync(cyclesDuringHBL);
-                    // Sync interrupts again when outscreen
-                    _mfp.irqController.RaiseHBL();
-                    _mfp.UpdateTimers(cyclesDuringHBL);
-                    
-                    // Sync ACIA
-                    ACIA.Sync(ElapsedCycles);
-
-                    if (scanline > 62 && scanline < 263)
-                    {
-                        _mem.Write8(Memory.STPortAdress.ST_HIVADRPOINT, (byte)(videoCounter >> 16));
-                        _mem.Write8(Memory.STPortAdress.ST_MIVADRPOINT, (byte)(videoCounter >> 8));
-                        _mem.Write8(Memory.STPortAdress.ST_LOVADRPOINT, (byte)(videoCounter));
-
-                        // Render scanline
-                        lock (_syncLock)
-                        {
-                            AtariStRenderer.BlitStLineToBuffer(ScreenBuffer, videoCounter, 0, scanline - 63);
-                        }
-
-                        // Next line: +160 bytes
-                        videoCounter = (videoCounter + 160u) & 0xFFFFFFu;
-
-                        _mfp.TickTimerA_EventCount();
-                        _mfp.TickTimerB_EventCount();   // Timer B updates on every scanline
-                    }
-                }
-
-                // Vsync completed
-                _mfp.irqController.RaiseVBL();
+                machine.RunFrame();
 
                 Dispatcher.UIThread.InvokeAsync(() => 
                 {
@@ -202,29 +119,23 @@ namespace ASE
                     }
                 }, DispatcherPriority.Background);
 
-                // For future use: Screenshot, recording, etc.
-                OnFrameComplete?.Invoke();
-
                 MainWindow.RefreshDriveLed();
 
                 next += frame;
 
                 if (!ConfigOptions.RunninConfig.MaxSpeed)
                 {
-                    // Dynamic wait loop. It combines longer waits using SDL_Delay, which do not block the process,
-                    // and then performs a fine-grained adjustment during the last few microseconds using SpinWait,
-                    // which does block but is more precise. The longer waits allow SDL to keep collecting events in
-                    // the meantime, making the emulator feel smoother.
-                    while (true)
+                    if (ConfigOptions.RunninConfig.AudioSync)
+                        fillError = AdjustAudioRate(machine.Ym, fillError);
+
+                    // Sleep until the frame deadline. The schedule is absolute, waking up to a millisecond early
+                    // does not add up from one frame to the next. _pacing cuts the wait short on shutdown.
+                    while (_isRunning)
                     {
-                        double now = (double)sw.ElapsedTicks / Stopwatch.Frequency;
-                        double remaining = next - now;
-                        if (remaining <= 0) break;
-
-                        if (remaining > 0.002) // > 2 ms, delay - sleep thread
-                            SDL_Delay(1);
-                        else
-                            Thread.SpinWait(10); // < 2 ms, active wait
+                        double remaining = next - (double)sw.ElapsedTicks / Stopwatch.Frequency;
+                        if (remaining < 0.001) break;
+
+                        _pacing.WaitOne((int)(remaining * 1000));
                     }
 
                     // Check if we are late
@@ -232,7 +143,33 @@ namespace ASE
                     if (late > 0.1)
                         next = (double)sw.ElapsedTicks / Stopwatch.Frequency;
                 }
+                else
+                    machine.Ym.SetRateAdjust(1.0);
             }
+
+            // Still on the emulator thread, the core is idle
+            Profiler.WriteIfEnabled(machine);
+            machine.Capture?.Dispose();
+        }
+
+        /// <summary>
+        /// Dynamic rate control: the frames are paced by the host clock and the sound card plays from its own
+        /// crystal, so the audio ring slowly fills or drains. The YM output rate is moved, at most 0.5%, to hold
+        /// the ring at a device buffer plus two frames of audio, so it never underruns nor drops.
+        /// </summary>
+        /// <returns>The smoothed fill error, to give back on the next frame.</returns>
+        static double AdjustAudioRate(YM2149 ym, double fillError)
+        {
+            const double MaxAdjust = 0.005;
+            const double Smoothing = 0.05;      // The fill moves in whole device buffers, look at the trend
+
+            int target = _audioDeviceSamples + 2 * ConfigOptions.RunninConfig.SampleRate / 50;
+            double error = (double)(ym.Audio.Count - target) / target;
+            fillError += (error - fillError) * Smoothing;
+
+            // Above the target generate fewer samples, below it more
+            ym.SetRateAdjust(1.0 - Math.Clamp(fillError * 0.01, -MaxAdjust, MaxAdjust));
+            return fillError;
         }
 
         public static bool TurnOn()
@@ -240,13 +177,7 @@ namespace ASE
             // Starts with mouse uncaptured
             CaptureMouse(false);
 
-            _isRunning = true;
-            _ym = new YM2149(sampleRate: Config.ConfigOptions.RunninConfig.SampleRate, chipClockHz: 2000000.0);
-
-            CPU.InitCpu();
-
-            // Init ok?
-            if (!_isRunning)
+            if (!PowerOn())
                 return false;         // No, just exit
 
             _thread = new Thread(EmulatorLoop);
@@ -255,9 +186,56 @@ namespace ASE
             return true;
         }
 
+        /// <summary>
+        /// Builds a new machine in place of the previous one, without starting the emulator thread.
+        /// </summary>
+        /// <remarks>The emulator thread must be stopped. The disks inserted stay in their drives.</remarks>
+        /// <returns>False if the machine could not be started (no TOS, ...).</returns>
+        static bool PowerOn()
+        {
+            Machine?.Dispose();
+            Machine = Machine.Create(driveA, driveB, Frames);
+
+            if (Machine == null)
+            {
+                Shutdown();
+                return false;
+            }
+
+            _isRunning = true;
+
+            Machine.DriveLed = on => Dispatcher.UIThread.InvokeAsync(() =>
+            {
+                MainWindow.DriveLed(on);
+            }, DispatcherPriority.Background);
+
+            // Resume from a save state given in the command line, only on the first power on
+            if (!string.IsNullOrEmpty(ConfigOptions.RunninConfig.StatePath))
+            {
+                SaveState.LoadFromFile(Machine, ConfigOptions.RunninConfig.StatePath);
+                ConfigOptions.RunninConfig.StatePath = "";
+            }
+
+            InputLog.Attach(Machine);
+            Capture.Attach(Machine);
+
+            return true;
+        }
+
+        /// <summary>
+        /// Runs <paramref name="action"/> on the emulator thread once the current frame is done, with the
+        /// machine running at that moment.
+        /// </summary>
+        public static void RunAtFrameEnd(Action<Machine> action)
+        {
+            Machine? machine = Machine;
+            machine?.RunAtFrameEnd(() => action(machine));
+        }
+
         public static void HardReset()
         {
             _isRunning = false;
+            _pacing.Set();
             _thread.Join();
 
             TurnOn();
@@ -266,6 +244,7 @@ namespace ASE
         public static void Shutdown()
         {
             _isRunning = false;
+            _pacing.Set();
 
             if (_audiodev != 0)
             {
@@ -293,6 +272,11 @@ namespace ASE
         {
             bool IgnoreCtlrKeyUp = false;
 
+            // Input goes to the machine running now, none while it is being replaced
+            ACIA? acia = Machine?.Acia;
+            if (acia == null)
+                return;
+
             // First, check the host keyboard that emulates the joystick
             // Numpad mapping: 8=Up, 5=Down, 4=Left, 6=Right, 0=Fire
             // This should be configurable in the future...
@@ -304,19 +288,19 @@ namespace ASE
                 switch (e.key.keysym.scancode)
                 {
                     case SDL_Scancode.SDL_SCANCODE_KP_8:
-                        ACIA.UpdateJoystick(ACIA.JOY_UP, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_UP, pressed);
                         break;
                     case SDL_Scancode.SDL_SCANCODE_KP_5:
-                        ACIA.UpdateJoystick(ACIA.JOY_DOWN, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_DOWN, pressed);
                         break;
                     case SDL_Scancode.SDL_SCANCODE_KP_4:
-                        ACIA.UpdateJoystick(ACIA.JOY_LEFT, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_LEFT, pressed);
                         break;
                     case SDL_Scancode.SDL_SCANCODE_KP_6:
-                        ACIA.UpdateJoystick(ACIA.JOY_RIGHT, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_RIGHT, pressed);
                         break;
                     case SDL_Scancode.SDL_SCANCODE_KP_0:
-                        ACIA.UpdateJoystick(ACIA.JOY_FIRE, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_FIRE, pressed);
                         break;
                     default:
                         isJoyKey = false;
@@ -335,19 +319,19 @@ namespace ASE
                 switch (btn)
                 {
                     case SDL.SDL_GameControllerButton.SDL_CONTROLLER_BUTTON_DPAD_UP:
-                        ACIA.UpdateJoystick(ACIA.JOY_UP, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_UP, pressed);
                         break;
                     case SDL.SDL_GameControllerButton.SDL_CONTROLLER_BUTTON_DPAD_DOWN:
-                        ACIA.UpdateJoystick(ACIA.JOY_DOWN, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_DOWN, pressed);
                         break;
                     case SDL.SDL_GameControllerButton.SDL_CONTROLLER_BUTTON_DPAD_LEFT:
-                        ACIA.UpdateJoystick(ACIA.JOY_LEFT, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_LEFT, pressed);
                         break;
                     case SDL.SDL_GameControllerButton.SDL_CONTROLLER_BUTTON_DPAD_RIGHT:
-                        ACIA.UpdateJoystick(ACIA.JOY_RIGHT, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_RIGHT, pressed);
                         break;
                     case SDL.SDL_GameControllerButton.SDL_CONTROLLER_BUTTON_A:
-                        ACIA.UpdateJoystick(ACIA.JOY_FIRE, pressed);
+                        acia.UpdateJoystick(ACIA.JOY_FIRE, pressed);
                         break;
                 }
 
@@ -365,14 +349,14 @@ namespace ASE
                     bool left = v < -GamepadDeadzone;
                     bool right = v > GamepadDeadzone;
 
-                    ACIA.UpdateJoystick(ACIA.JOY_LEFT, left);
-                    ACIA.UpdateJoystick(ACIA.JOY_RIGHT, right);
+                    acia.UpdateJoystick(ACIA.JOY_LEFT, left);
+                    acia.UpdateJoystick(ACIA.JOY_RIGHT, right);
 
                     // center stick
                     if (!left && !right)
                     {
-                        ACIA.UpdateJoystick(ACIA.JOY_LEFT, false);
-                        ACIA.UpdateJoystick(ACIA.JOY_RIGHT, false);
+                        acia.UpdateJoystick(ACIA.JOY_LEFT, false);
+                        acia.UpdateJoystick(ACIA.JOY_RIGHT, false);
                     }
                 }
                 else if (axis == SDL.SDL_GameControllerAxis.SDL_CONTROLLER_AXIS_LEFTY)
@@ -380,13 +364,13 @@ namespace ASE
                     bool up = v < -GamepadDeadzone;
                     bool down = v > GamepadDeadzone;
 
-                    ACIA.UpdateJoystick(ACIA.JOY_UP, up);
-                    ACIA.UpdateJoystick(ACIA.JOY_DOWN, down);
+                    acia.UpdateJoystick(ACIA.JOY_UP, up);
+                    acia.UpdateJoystick(ACIA.JOY_DOWN, down);
 
                     if (!up && !down)
                     {
-                        ACIA.UpdateJoystick(ACIA.JOY_UP, false);
-                        ACIA.UpdateJoystick(ACIA.JOY_DOWN, false);
+                        acia.UpdateJoystick(ACIA.JOY_UP, false);
+                        acia.UpdateJoystick(ACIA.JOY_DOWN, false);
                     }
                 }
 
@@ -408,8 +392,15 @@ namespace ASE
                     {
                         IgnoreCtlrKeyUp = true;
 
+                        // The trace ring is filled by the emulator thread, it is read there between frames
                         if (ConfigOptions.RunninConfig.DebugMode)
-                            Debug.DisassembleRunningPC();
+                        {
+                            RunAtFrameEnd(machine =>
+                            {
+                                Debug.DisassembleRunningPC();
+                                Debug.DumpTrace(machine, 64);
+                            });
+                        }
 
                         return;
                     }
@@ -423,7 +414,7 @@ namespace ASE
                     int scancode = (int)e.key.keysym.scancode;
 
                     if (scancode < ACIA.AtariScancodes.Length && ACIA.AtariScancodes[scancode] != 0)
-                        ACIA.PushIkbd(ACIA.AtariScancodes[scancode]);
+                        acia.PushIkbd(ACIA.AtariScancodes[scancode]);
                 }
             }
 
@@ -446,7 +437,7 @@ namespace ASE
 
                     if (scancode < ACIA.AtariScancodes.Length && ACIA.AtariScancodes[scancode] != 0)
                         // Scancode | 0x80 -> Scancode que se ha soltado en el ST
-                        ACIA.PushIkbd((byte)(ACIA.AtariScancodes[scancode] | 0x80));
+                        acia.PushIkbd((byte)(ACIA.AtariScancodes[scancode] | 0x80));
                 }
             }
 
@@ -455,27 +446,16 @@ namespace ASE
                 if (e.type == SDL.SDL_EventType.SDL_MOUSEMOTION && (e.motion.xrel != 0 || e.motion.yrel != 0))
                 {
                     // Transporta el movimiento relativo del ratón dentro de la ventana del emulador al ST
-                    ACIA.SendMousePacket(e.motion.xrel, e.motion.yrel);
+                    acia.SendMousePacket(e.motion.xrel, e.motion.yrel);
                 }
-                else if (e.type == SDL.SDL_EventType.SDL_MOUSEBUTTONDOWN)
+                else if (e.type == SDL.SDL_EventType.SDL_MOUSEBUTTONDOWN || e.type == SDL.SDL_EventType.SDL_MOUSEBUTTONUP)
                 {
-                    if (e.button.button == SDL.SDL_BUTTON_LEFT)
-                        ACIA._mouseButtons |= 0x02; // Bit 1
-                    if (e.button.button == SDL.SDL_BUTTON_RIGHT)
-                        ACIA._mouseButtons |= 0x01; // Bit 0
+                    bool pressed = e.type == SDL.SDL_EventType.SDL_MOUSEBUTTONDOWN;
 
-                    // Fuerza la actualización del ratón en el ST
-                    ACIA.SendMousePacket(0, 0);
-                }
-                else if (e.type == SDL.SDL_EventType.SDL_MOUSEBUTTONUP)
-                {
                     if (e.button.button == SDL.SDL_BUTTON_LEFT)
-                        ACIA._mouseButtons &= ~0x02; // Apagar Bit 1
+                        acia.SetMouseButton(0x02, pressed); // Bit 1
                     if (e.button.button == SDL.SDL_BUTTON_RIGHT)
-                        ACIA._mouseButtons &= ~0x01; // Apagar Bit 0
-
-                    // Fuerza la actualización del ratón en el ST
-                    ACIA.SendMousePacket(0, 0);
+                        acia.SetMouseButton(0x01, pressed); // Bit 0
                 }
             }
         }
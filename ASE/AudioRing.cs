@@ -0,0 +1,143 @@
+﻿/*
+ *
+ * Lock-free sample ring between the emulator and the audio device
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+namespace ASE
+{
+    /// <summary>
+    /// Fixed capacity ring of samples with one producer (the emulator thread) and one consumer (the SDL audio
+    /// thread). Both sides copy whole blocks and never lock or allocate.
+    /// </summary>
+    /// <remarks>Positions are free running sample counts, each written by one side only. When the ring is full the
+    /// producer drops the newest samples, when it is empty the consumer gets less than it asked for. Both cases
+    /// are counted in <see cref="Statistics"/>, along with the fill levels seen by the consumer, so the pacing
+    /// can steer the emulation speed with them.</remarks>
+    public sealed class AudioRing
+    {
+        public readonly struct Stats
+        {
+            public int Fill { get; init; }          // Samples buffered now
+            public int Capacity { get; init; }
+            public int MinFill { get; init; }       // Lowest and highest fill seen by the consumer before a read
+            public int MaxFill { get; init; }
+            public long Underruns { get; init; }    // Samples the consumer asked for without data
+            public long Dropped { get; init; }      // Samples the producer could not fit
+
+            public double FillRatio => Capacity > 0 ? (double)Fill / Capacity : 0;
+        }
+
+        readonly float[] _samples;
+
+        long _write;                    // Producer only
+        long _read;                     // Consumer only
+        long _clearAt;                  // Producer only, everything before it is discarded by the consumer
+
+        // Statistics, each written by one side only
+        long _dropped;
+        long _underruns;
+        int _minFill = int.MaxValue;
+        int _maxFill;
+
+        public AudioRing(int capacity)
+        {
+            _samples = new float[capacity];
+        }
+
+        /// <summary>
+        /// Ring holding a quarter of a second of audio, the latency bound the emulator always had.
+        /// </summary>
+        public static AudioRing ForSampleRate(int sampleRate) => new AudioRing(Math.Max(sampleRate / 4, 1024));
+
+        public int Capacity => _samples.Length;
+
+        /// <summary>Samples buffered, exact on either side.</summary>
+        public int Count => (int)(Volatile.Read(ref _write) - Math.Max(Volatile.Read(ref _read), Volatile.Read(ref _clearAt)));
+
+        /// <summary>
+        /// Appends samples. Producer only.
+        /// </summary>
+        /// <returns>The samples stored, the rest did not fit and was dropped.</returns>
+        public int Write(ReadOnlySpan<float> samples)
+        {
+            long write = _write;
+
+            // Space is counted from the consumer position even after a Clear: the samples cleared are only given
+            // back once the consumer has skipped them, a read in progress may still be copying them out
+            int free = Capacity - (int)(write - Volatile.Read(ref _read));
+            int count = Math.Min(samples.Length, free);
+
+            int index = (int)(write % Capacity);
+            int first = Math.Min(count, Capacity - index);
+            samples.Slice(0, first).CopyTo(_samples.AsSpan(index));
+            samples.Slice(first, count - first).CopyTo(_samples);
+
+            if (count < samples.Length)
+                Volatile.Write(ref _dropped, _dropped + samples.Length - count);
+
+            // Samples are in place before the position moves
+            Volatile.Write(ref _write, write + count);
+            return count;
+        }
+
+        /// <summary>
+        /// Takes up to <paramref name="samples"/>.Length samples. Consumer only.
+        /// </summary>
+        /// <returns>The samples read, less than asked for on underrun.</returns>
+        public int Read(Span<float> samples)
+        {
+            // The write position first: samples written after a Clear come with the clear position that skips the
+            // ones before it. A Clear in between can put the clear position past the write position read.
+            long write = Volatile.Read(ref _write);
+            long read = Math.Max(_read, Volatile.Read(ref _clearAt));
+            int fill = (int)Math.Max(write - read, 0);
+            int count = Math.Min(samples.Length, fill);
+
+            int index = (int)(read % Capacity);
+            int first = Math.Min(count, Capacity - index);
+            _samples.AsSpan(index, first).CopyTo(samples);
+            _samples.AsSpan(0, count - first).CopyTo(samples.Slice(first));
+
+            if (fill < _minFill) Volatile.Write(ref _minFill, fill);
+            if (fill > _maxFill) Volatile.Write(ref _maxFill, fill);
+            if (count < samples.Length)
+                Volatile.Write(ref _underruns, _underruns + samples.Length - count);
+
+            // Samples are copied out before the space is given back
+            Volatile.Write(ref _read, read + count);
+            return count;
+        }
+
+        /// <summary>
+        /// Discards everything buffered (reset, state load). Producer only. The consumer skips the samples on its
+        /// next read, and their space is only reused after that, so the device never gets old and new audio mixed.
+        /// </summary>
+        public void Clear()
+        {
+            Volatile.Write(ref _clearAt, _write);
+        }
+
+        public Stats Statistics => new Stats
+        {
+            Fill = Count,
+            Capacity = Capacity,
+            MinFill = Volatile.Read(ref _minFill) == int.MaxValue ? 0 : Volatile.Read(ref _minFill),
+            MaxFill = Volatile.Read(ref _maxFill),
+            Underruns = Volatile.Read(ref _underruns),
+            Dropped = Volatile.Read(ref _dropped),
+        };
+
+        /// <summary>
+        /// Starts a new window for <see cref="Stats.MinFill"/> and <see cref="Stats.MaxFill"/>. The counters keep
+        /// running, compare two snapshots for rates. Racy against a read in progress, which only blurs the window.
+        /// </summary>
+        public void ResetFillWindow()
+        {
+            Volatile.Write(ref _minFill, int.MaxValue);
+            Volatile.Write(ref _maxFill, 0);
+        }
+    }
+}
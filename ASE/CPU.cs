@@ -11,72 +11,83 @@ using static ASE.Config;
 namespace ASE
 {
     /// <summary>
-    /// Represents a Motorola 68K CPU emulator that manages interrupt requests, simulates bus errors, and initializes
-    /// the CPU and related hardware components.
+    /// Binds the native Motorola 68K core and names the device events scheduled on the CPU clock.
     /// </summary>
-    /// <remarks>The CPU class provides core functionality for emulating the behavior of a 68K processor,
-    /// including handling interrupt acknowledgments and simulating bus error exceptions. It also coordinates the
-    /// initialization of the CPU state and associated subsystems such as memory, MFP, ACIA, WD1772, and YM. This class
-    /// is essential for accurate emulation of system-level CPU interactions and exception handling.</remarks>
-    public class CPU
+    /// <remarks>The core of each machine, with its memory map, interrupt acknowledge and event handlers, is built
+    /// by <see cref="Machine"/>. What lives here is shared by every machine of the process: the native library is
+    /// loaded and checked once, before the first core is created.</remarks>
+    public static class CPU
     {
-        public static Moira _moira;
-
         /// <summary>
-        /// Get interrupt vector based on level
+        /// Ids of the device events scheduled on the CPU clock (see <see cref="Moira.ScheduleEvent"/>).
         /// </summary>
-        /// <param name="level">Interrupt level</param>
-        /// <returns></returns>
-        static ushort IrqAck(byte level)
+        public enum EventId
         {
-            switch (level)
-            {
-                case 2: // HBL
-                    ASEMain._mfp.irqController.ClearHBL();
-                    break;
+            AciaRx = 0,     // Next IKBD byte in the ACIA receive register
+            FdcCommand = 1, // WD1772 command completion
+            BlitterDone = 2, // End of a blit of the native blitter
+            MfpTimer = 3,   // Next underflow of an MFP timer
+        }
 
-                case 4: // VBL
-                    ASEMain._mfp.irqController.ClearVBL();
-                    break;
+        static readonly object _bindLock = new object();
+        static bool _bound;
+        static Moira.BuildInfo _info;
 
-                case 6: // MFP
-                    ushort vector = ASEMain._mfp.GetInterruptVector();
-                    return vector;
+        /// <summary>Build settings of the bound core library, binding it first if no machine did yet.</summary>
+        public static Moira.BuildInfo Core
+        {
+            get
+            {
+                BindCore();
+                return _info;
             }
-
-            return (ushort)(24 + level);
         }
 
         /// <summary>
-        /// Initializes the CPU and all associated hardware components to a known state, preparing the system for
-        /// operation.
+        /// Selects the core library given in the configuration and checks that it implements the C API this
+        /// build expects. Exits when it is missing, lacks the entry points of this build or implements another
+        /// version of the API, since no machine could run.
         /// </summary>
-        /// <remarks>Call this method before performing any CPU operations to ensure that memory and all
-        /// hardware interfaces are properly set up and reset. This method must be invoked once during application
-        /// startup or before reinitializing the emulated system.</remarks>
-        public static void InitCpu()
+        /// <remarks>Only the first call does anything, machines started at the same time on several threads
+        /// all wait for it.</remarks>
+        public static void BindCore()
         {
-            ASEMain._mem = new Memory();
+            lock (_bindLock)
+            {
+                if (_bound)
+                    return;
 
-            if (ASEMain._mem.ROM == null)
-                return;
+                Moira.LibraryName = ConfigOptions.RunninConfig.CpuCore;
 
-            _moira = new Moira(
-                ASEMain._mem.Read8,
-                ASEMain._mem.Read16,
-                ASEMain._mem.Write8,
-                ASEMain._mem.Write16,
-                null,
-                IrqAck
-                );
+                Moira.BuildInfo info = default;
 
-            ASEMain._mfp = new MFP68901();
+                try
+                {
+                    info = Moira.GetBuildInfo();
+                }
+                catch (DllNotFoundException)
+                {
+                    ColoredConsole.WriteLine($"ERROR: [[red]]{Moira.LibraryName}[[/red]] could not be loaded, build it from the Moira directory.");
+                    Environment.Exit(1);
+                }
+                catch (EntryPointNotFoundException)
+                {
+                    // Libraries older than the versioned C API have no moira_get_build_info at all
+                    ColoredConsole.WriteLine($"ERROR: [[red]]{Moira.LibraryName}[[/red]] does not implement C API version {Moira.AbiVersion}, rebuild it from the Moira directory.");
+                    Environment.Exit(1);
+                }
 
-            ACIA.Reset();
-            WD1772.Reset();
-            ASEMain._ym.Reset();
+                if (info.AbiVersion != Moira.AbiVersion)
+                {
+                    ColoredConsole.WriteLine($"ERROR: [[red]]{Moira.LibraryName}[[/red]] C API version {info.AbiVersion} does not match the expected {Moira.AbiVersion}.");
+                    Environment.Exit(1);
+                }
 
-            _moira.Reset();
+                _info = info;
+
+                ColoredConsole.WriteLine($"CPU core [[green]]{info.Profile}[[/green]] (precise timing: {info.PreciseTiming}, FC: {info.EmulateFC}, dasm: {info.Dasm}).");
+                _bound = true;
+            }
         }
     }
 }
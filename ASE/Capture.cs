@@ -0,0 +1,393 @@
+﻿/*
+ *
+ * Video and sound capture
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// Records the frames and the sound of a machine: the frames to a Y4M file, or through ffmpeg for any other
+    /// extension, and the sound to a WAV file next to it.
+    /// </summary>
+    /// <remarks>The emulator thread only copies every finished frame into a free buffer of a fixed pool, and the
+    /// YM writes its samples to a ring of its own (<see cref="YM2149.CaptureAudio"/>). A background thread
+    /// converts and writes both. Nothing is allocated or waited for on the emulator thread: when the writer falls
+    /// behind and no buffer is free the frame is dropped and counted, and the writer repeats the previous frame in
+    /// its place so the video keeps the length of the sound.</remarks>
+    public sealed class Capture : IDisposable
+    {
+        const int PoolSize = 16;            // Frames buffered for the writer, a third of a second
+        const int Width = ASEMain.ScreenWidth;
+        const int Height = FrameRing.Lines;
+
+        readonly Machine _machine;
+        readonly string _path;
+        readonly Action _onFrame;
+
+        // Frame buffers, each one in _free (owned by the emulator thread) or in _filled (owned by the writer)
+        readonly uint[][] _pool = new uint[PoolSize][];
+        readonly int[] _repeats = new int[PoolSize];    // Frames lost before the one in the buffer
+        readonly SlotQueue _free = new SlotQueue(PoolSize);
+        readonly SlotQueue _filled = new SlotQueue(PoolSize);
+
+        readonly AudioRing _audio;
+        readonly float[] _samples = new float[4096];
+
+        readonly Thread _writer;
+        readonly AutoResetEvent _wake = new AutoResetEvent(false);
+        volatile bool _stopping;
+        bool _disposed;
+
+        // Emulator thread only
+        long _published;
+        int _repeat;
+
+        long _frames;
+        long _dropped;
+
+        // Writer thread only
+        readonly Stream _video;
+        readonly Process? _ffmpeg;
+        readonly WavWriter _wav;
+        readonly byte[] _frame;             // Last frame written, as written
+        readonly int _frameStart;           // Bytes of the Y4M frame header at the start of _frame
+        bool _failed;
+
+        Capture(Machine machine, string path, Stream video, Process? ffmpeg, WavWriter wav)
+        {
+            _machine = machine;
+            _path = path;
+            _video = video;
+            _ffmpeg = ffmpeg;
+            _wav = wav;
+
+            for (int i = 0; i < PoolSize; i++)
+            {
+                _pool[i] = new uint[Width * Height];
+                _free.Enqueue(i);
+            }
+
+            if (ffmpeg == null)
+            {
+                // YUV 4:4:4, the ST pixels are 5:12 in a 4:3 picture of 640x200
+                video.Write(System.Text.Encoding.ASCII.GetBytes($"YUV4MPEG2 W{Width} H{Height} F50:1 Ip A5:12 C444\n"));
+                _frameStart = "FRAME\n"u8.Length;
+                _frame = new byte[_frameStart + Width * Height * 3];
+                "FRAME\n"u8.CopyTo(_frame);
+            }
+            else
+            {
+                _frame = new byte[Width * Height * 4];
+            }
+
+            // Two seconds of sound, the writer empties it every frame
+            _audio = new AudioRing(machine.Ym.SampleRate * 2);
+            machine.Ym.CaptureAudio = _audio;
+
+            _onFrame = OnFrame;
+            machine.OnFrameComplete += _onFrame;
+
+            _writer = new Thread(WriterLoop) { Name = "Capture writer", IsBackground = true };
+            _writer.Start();
+        }
+
+        /// <summary>Frames captured so far, the dropped ones included.</summary>
+        public long Frames => Volatile.Read(ref _frames);
+
+        /// <summary>Frames the writer could not keep up with, written again as the previous one.</summary>
+        public long Dropped => Volatile.Read(ref _dropped);
+
+        /// <summary>
+        /// Starts the capture asked for with --capture on <paramref name="machine"/>, once per session like the
+        /// input recording (see <see cref="InputLog.Attach"/>).
+        /// </summary>
+        public static void Attach(Machine machine)
+        {
+            var config = ConfigOptions.RunninConfig;
+            if (string.IsNullOrEmpty(config.CapturePath))
+                return;
+
+            string path = config.CapturePath;
+            config.CapturePath = "";
+
+            machine.Capture = Start(machine, path);
+        }
+
+        /// <summary>
+        /// Opens the output files and the writer thread.
+        /// </summary>
+        /// <returns>Null if the files or ffmpeg could not be opened, the reason is on the console.</returns>
+        static Capture? Start(Machine machine, string path)
+        {
+            string wavPath = Path.ChangeExtension(path, ".wav");
+            Stream? video = null;
+            Process? ffmpeg = null;
+
+            try
+            {
+                if (Path.GetExtension(path).Equals(".y4m", StringComparison.OrdinalIgnoreCase))
+                {
+                    video = new FileStream(path, FileMode.Create, FileAccess.Write, FileShare.Read, 1 << 20);
+                }
+                else
+                {
+                    var info = new ProcessStartInfo("ffmpeg")
+                    {
+                        RedirectStandardInput = true,
+                        UseShellExecute = false,
+                    };
+                    foreach (string arg in new[] { "-y", "-loglevel", "error", "-f", "rawvideo", "-pixel_format", "rgb0",
+                        "-video_size", $"{Width}x{Height}", "-framerate", "50", "-i", "-", "-vf", "setsar=5/12", path })
+                        info.ArgumentList.Add(arg);
+
+                    ffmpeg = Process.Start(info) ?? throw new IOException("ffmpeg did not start");
+                    video = ffmpeg.StandardInput.BaseStream;
+                }
+
+                var capture = new Capture(machine, path, video, ffmpeg, new WavWriter(wavPath, machine.Ym.SampleRate));
+                ColoredConsole.WriteLine($"Capturing to [[green]]{path}[[/green]] and [[green]]{wavPath}[[/green]]");
+                return capture;
+            }
+            catch (Exception ex)
+            {
+                video?.Dispose();
+                ffmpeg?.Dispose();
+                ColoredConsole.WriteLine($"[[red]]Cannot capture to {path}: {ex.Message}[[/red]]");
+                return null;
+            }
+        }
+
+        // Machine.OnFrameComplete, on the emulator thread
+        void OnFrame()
+        {
+            Volatile.Write(ref _frames, _frames + 1);
+
+            // A frame that was not rendered shows the previous one again
+            FrameRing ring = _machine.Frames;
+            if (ring.PublishedCount == _published || !_free.TryDequeue(out int slot))
+            {
+                if (ring.PublishedCount != _published)
+                    Volatile.Write(ref _dropped, _dropped + 1);
+
+                _published = ring.PublishedCount;
+                _repeat++;
+                return;
+            }
+
+            _published = ring.PublishedCount;
+            ring.LastPublished.AsSpan().CopyTo(_pool[slot]);
+            _repeats[slot] = _repeat;
+            _repeat = 0;
+
+            _filled.Enqueue(slot);
+            _wake.Set();
+        }
+
+        void WriterLoop()
+        {
+            bool first = true;
+
+            while (true)
+            {
+                // Read before draining, so nothing queued before the stop is left behind
+                bool stopping = _stopping;
+
+                while (_filled.TryDequeue(out int slot))
+                {
+                    // The first frame has nothing to repeat
+                    for (int i = first ? 0 : _repeats[slot]; i > 0; i--)
+                        WriteFrame();
+
+                    Encode(_pool[slot]);
+                    _free.Enqueue(slot);
+
+                    WriteFrame();
+                    first = false;
+                }
+
+                int read;
+                while ((read = _audio.Read(_samples)) > 0)
+                {
+                    if (!_failed)
+                        Output(() => _wav.Write(_samples.AsSpan(0, read)));
+                }
+
+                if (stopping)
+                    break;
+
+                _wake.WaitOne(100);
+            }
+
+            Output(() =>
+            {
+                _video.Dispose();
+                _ffmpeg?.WaitForExit();
+                _wav.Dispose();
+            });
+            _ffmpeg?.Dispose();
+        }
+
+        void WriteFrame()
+        {
+            if (!_failed)
+                Output(() => _video.Write(_frame));
+        }
+
+        // A write error (disk full, ffmpeg gone) ends the output, the frames are still taken and thrown away
+        void Output(Action write)
+        {
+            try
+            {
+                write();
+            }
+            catch (IOException ex)
+            {
+                if (!_failed)
+                    ColoredConsole.WriteLine($"[[red]]Capture to {_path} stopped: {ex.Message}[[/red]]");
+                _failed = true;
+            }
+        }
+
+        // Frame in the layout of the output: Y, Cb and Cr planes (BT.601, studio range) or the pixels as they are
+        void Encode(uint[] pixels)
+        {
+            if (_ffmpeg != null)
+            {
+                MemoryMarshal.AsBytes(pixels.AsSpan()).CopyTo(_frame);
+                return;
+            }
+
+            const int plane = Width * Height;
+            Span<byte> y = _frame.AsSpan(_frameStart, plane);
+            Span<byte> cb = _frame.AsSpan(_frameStart + plane, plane);
+            Span<byte> cr = _frame.AsSpan(_frameStart + plane * 2, plane);
+
+            for (int i = 0; i < plane; i++)
+            {
+                uint p = pixels[i];
+                int r = (int)(p & 0xFF);
+                int g = (int)((p >> 8) & 0xFF);
+                int b = (int)((p >> 16) & 0xFF);
+
+                y[i] = (byte)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                cb[i] = (byte)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                cr[i] = (byte)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+
+        /// <summary>
+        /// Writes what is still queued and closes the files. Called on the emulator thread, or with it stopped.
+        /// </summary>
+        public void Dispose()
+        {
+            if (_disposed)
+                return;
+            _disposed = true;
+
+            _machine.OnFrameComplete -= _onFrame;
+            _machine.Ym.CaptureAudio = null;
+
+            _stopping = true;
+            _wake.Set();
+            _writer.Join();
+            _wake.Dispose();
+
+            ColoredConsole.WriteLine($"Captured [[green]]{Frames}[[/green]] frames to [[green]]{_path}[[/green]]" +
+                (Dropped > 0 ? $", [[yellow]]{Dropped} dropped[[/yellow]]" : "") +
+                (_audio.Statistics.Dropped > 0 ? $", [[yellow]]{_audio.Statistics.Dropped} samples dropped[[/yellow]]" : ""));
+        }
+
+        /// <summary>
+        /// Indices of the pool buffers passed from one thread to the other. Holds every index at most once, so it
+        /// is never full.
+        /// </summary>
+        sealed class SlotQueue
+        {
+            readonly int[] _slots;
+            long _head;                     // Consumer only
+            long _tail;                     // Producer only
+
+            public SlotQueue(int capacity)
+            {
+                _slots = new int[capacity];
+            }
+
+            public void Enqueue(int slot)
+            {
+                long tail = _tail;
+                _slots[tail % _slots.Length] = slot;
+
+                // The slot, and what the producer wrote in its buffer, are visible before the position moves
+                Volatile.Write(ref _tail, tail + 1);
+            }
+
+            public bool TryDequeue(out int slot)
+            {
+                long head = _head;
+                if (head == Volatile.Read(ref _tail))
+                {
+                    slot = 0;
+                    return false;
+                }
+
+                slot = _slots[head % _slots.Length];
+                Volatile.Write(ref _head, head + 1);
+                return true;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Mono 32-bit float WAV file, the sizes in the header are patched on dispose.
+    /// </summary>
+    sealed class WavWriter : IDisposable
+    {
+        readonly BinaryWriter _w;
+        long _samples;
+
+        public WavWriter(string path, int sampleRate)
+        {
+            _w = new BinaryWriter(File.Create(path));
+
+            _w.Write("RIFF"u8);
+            _w.Write(0);                    // RIFF size, patched
+            _w.Write("WAVE"u8);
+            _w.Write("fmt "u8);
+            _w.Write(16);
+            _w.Write((ushort)3);            // IEEE float
+            _w.Write((ushort)1);            // Mono
+            _w.Write(sampleRate);
+            _w.Write(sampleRate * 4);       // Bytes per second
+            _w.Write((ushort)4);            // Block align
+            _w.Write((ushort)32);           // Bits per sample
+            _w.Write("data"u8);
+            _w.Write(0);                    // Data size, patched
+        }
+
+        // Little-endian hosts only, like the rest of the emulator
+        public void Write(ReadOnlySpan<float> samples)
+        {
+            _w.Write(MemoryMarshal.AsBytes(samples));
+            _samples += samples.Length;
+        }
+
+        public void Dispose()
+        {
+            // Past 4GB (some 6 hours at 44.1kHz) the sizes stay at their maximum, which most readers take as "to the end"
+            uint data = (uint)Math.Min(_samples * 4, uint.MaxValue - 36);
+
+            _w.Seek(4, SeekOrigin.Begin);
+            _w.Write(36 + data);
+            _w.Seek(40, SeekOrigin.Begin);
+            _w.Write(data);
+            _w.Dispose();
+        }
+    }
+}
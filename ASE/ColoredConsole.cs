@@ -19,6 +19,11 @@ namespace ASE
     /// default console color. The WriteLine method appends a new line after the text is written.</remarks>
     public class ColoredConsole
     {
+        const string Markup = @"\[\[(\w+)\]\](.*?)\[\[/\1\]\]";
+
+        // Machines running on several threads log at the same time, each write keeps its colors and its line
+        static readonly object _writeLock = new object();
+
         /// <summary>
         /// Writes the specified text to the console, applying color formatting based on embedded color tags.
         /// </summary>
@@ -28,14 +33,19 @@ namespace ASE
         /// <param name="text">The text to be written to the console, which may contain color tags in the format
         /// [[ColorName]]Content[[/ColorName]].</param>
         public static void Write(string text)
+        {
+            lock (_writeLock)
+                WriteColored(text);
+        }
+
+        static void WriteColored(string text)
         {
             var defaultColor = Console.ForegroundColor;
-            var pattern = @"\[\[(\w+)\]\](.*?)\[\[/\1\]\]";
             var lastIndex = 0;
 
             Console.OutputEncoding = System.Text.Encoding.UTF8;
 
-            foreach (Match match in Regex.Matches(text, pattern))
+            foreach (Match match in Regex.Matches(text, Markup))
             {
                 if (match.Index > lastIndex)
                 {
@@ -77,8 +87,16 @@ namespace ASE
         /// <param name="text">The text to write to the output. This parameter cannot be null.</param>
         public static void WriteLine(string text)
         { 
-            Write(text);
-            Write(Environment.NewLine);
+            lock (_writeLock)
+            {
+                WriteColored(text);
+                WriteColored(Environment.NewLine);
+            }
         }
+
+        /// <summary>
+        /// Removes the color tags, for text that does not go to the console (reports, dialogs, ...).
+        /// </summary>
+        public static string StripMarkup(string text) => Regex.Replace(text, Markup, "$2");
     }
 }
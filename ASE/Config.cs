@@ -56,6 +56,40 @@ namespace ASE
             public int MouseXSensitivity { get; set; } = 2;
             public int MouseYSensitivity { get; set; } = 2;
             public int SampleRate { get; set; } = 44100;
+            public bool TurboFloppy { get; set; } = false; // Floppy commands complete at once, see WD1772.EndCommandOK
+            public bool AudioSync { get; set; } = true; // Pace the frames to keep the audio buffer level, see ASEMain.EmulatorLoop
+            public string CpuCore { get; set; } = "moira"; // Native library: moira, moira_fast, moira_accurate, moira_static
+            public bool Blitter { get; set; } = false; // Mega ST BLiTTER at $FF8A00, see Moira.MapBlitter. Off, its registers raise a bus error like on the ST
+            public bool RasterEffects { get; set; } = false; // Palette and resolution changes split the line being displayed, see Video.AtariStRenderer.Raster
+            public int TraceLength { get; set; } = 0; // Instructions kept by the native trace for Debug.DumpTrace, 0 is off
+            public int CounterFrames { get; set; } = 0; // Frames between two logs of the CPU bus counters, see PerfCounters, 0 is off
+            [JsonIgnore]
+            public string ProfilePath { get; set; } = ""; // Hot spot profile written on exit, see Profiler, command line only
+            public int ProfileSample { get; set; } = 0; // Cycles between profiler samples, 0 counts every instruction
+            [JsonIgnore]
+            public string StatePath { get; set; } = ""; // Save state to resume from, command line only
+            [JsonIgnore]
+            public string RecordPath { get; set; } = ""; // Input recording written from the start, see InputLog, command line only
+            [JsonIgnore]
+            public string ReplayPath { get; set; } = ""; // Input recording replayed instead of the host input, command line only
+            [JsonIgnore]
+            public string CapturePath { get; set; } = ""; // Video recorded from the start with the sound next to it, see Capture, command line only
+
+            // Headless mode, command line only
+            [JsonIgnore]
+            public bool Headless { get; set; } = false;
+            [JsonIgnore]
+            public int HeadlessFrames { get; set; } = 500;
+            [JsonIgnore]
+            public string WavPath { get; set; } = "";
+            [JsonIgnore]
+            public string DumpFrames { get; set; } = "";
+            [JsonIgnore]
+            public string ReportPath { get; set; } = "";
+            [JsonIgnore]
+            public string CorpusPath { get; set; } = ""; // Directory of floppy images run in parallel, see Headless.RunCorpus
+            [JsonIgnore]
+            public int Jobs { get; set; } = 0; // Machines running at the same time in a corpus run, 0 is one per core
 
             // Screen flags
             public float Curvature { get; set; } = 0.01f;
@@ -114,6 +148,14 @@ namespace ASE
                         if (parts.Length > 1 && bool.TryParse(parts[1], out bool _maxs))
                             ConfigOptions.RunninConfig.MaxSpeed = _maxs;
                         break;
+                    case "--turbofloppy":
+                        if (parts.Length > 1 && bool.TryParse(parts[1], out bool _turbo))
+                            ConfigOptions.RunninConfig.TurboFloppy = _turbo;
+                        break;
+                    case "--audiosync":
+                        if (parts.Length > 1 && bool.TryParse(parts[1], out bool _async))
+                            ConfigOptions.RunninConfig.AudioSync = _async;
+                        break;
                     case "--floppy":
                         if (parts.Length > 1)
                             ConfigOptions.RunninConfig.FloppyImagePath = parts[1];
@@ -136,6 +178,76 @@ namespace ASE
                             ColoredConsole.WriteLine($"Using default sensitivity [[cyan]]{ConfigOptions.RunninConfig.MouseXSensitivity},{ConfigOptions.RunninConfig.MouseYSensitivity}[[/cyan]].");
                         }
                         break;
+                    case "--cpucore":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.CpuCore = parts[1];
+                        break;
+                    case "--raster":
+                        if (parts.Length > 1 && bool.TryParse(parts[1], out bool _raster))
+                            ConfigOptions.RunninConfig.RasterEffects = _raster;
+                        break;
+                    case "--blitter":
+                        if (parts.Length > 1 && bool.TryParse(parts[1], out bool _blitter))
+                            ConfigOptions.RunninConfig.Blitter = _blitter;
+                        break;
+                    case "--trace":
+                        if (parts.Length > 1 && int.TryParse(parts[1], out int _trace) && _trace >= 0)
+                            ConfigOptions.RunninConfig.TraceLength = _trace;
+                        break;
+                    case "--counters":
+                        if (parts.Length > 1 && int.TryParse(parts[1], out int _counterFrames) && _counterFrames >= 0)
+                            ConfigOptions.RunninConfig.CounterFrames = _counterFrames;
+                        break;
+                    case "--profile":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.ProfilePath = parts[1];
+                        break;
+                    case "--profile-sample":
+                        if (parts.Length > 1 && int.TryParse(parts[1], out int _sample) && _sample >= 0)
+                            ConfigOptions.RunninConfig.ProfileSample = _sample;
+                        break;
+                    case "--state":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.StatePath = parts[1];
+                        break;
+                    case "--record":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.RecordPath = parts[1];
+                        break;
+                    case "--replay":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.ReplayPath = parts[1];
+                        break;
+                    case "--capture":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.CapturePath = parts[1];
+                        break;
+                    case "--headless":
+                        ConfigOptions.RunninConfig.Headless = true;
+                        if (parts.Length > 1 && int.TryParse(parts[1], out int _frames) && _frames > 0)
+                            ConfigOptions.RunninConfig.HeadlessFrames = _frames;
+                        break;
+                    case "--wav":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.WavPath = parts[1];
+                        break;
+                    case "--dump-frame":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.DumpFrames = parts[1];
+                        break;
+                    case "--report":
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.ReportPath = parts[1];
+                        break;
+                    case "--corpus":
+                        ConfigOptions.RunninConfig.Headless = true;
+                        if (parts.Length > 1)
+                            ConfigOptions.RunninConfig.CorpusPath = parts[1];
+                        break;
+                    case "--jobs":
+                        if (parts.Length > 1 && int.TryParse(parts[1], out int _jobs) && _jobs >= 0)
+                            ConfigOptions.RunninConfig.Jobs = _jobs;
+                        break;
                     case "--altconfig":
                         if (parts.Length > 1)
                         {
@@ -151,8 +263,27 @@ namespace ASE
                         Console.WriteLine("  --altconfig=<path>            Loads alternative config");
                         Console.WriteLine("  --debug                       Debug mode");
                         Console.WriteLine("  --maxspeed=[true/false]       Run at max speed or ST speed");
+                        Console.WriteLine("  --turbofloppy=[true/false]    Floppy commands take no seek or rotation time (default: false)");
+                        Console.WriteLine("  --audiosync=[true/false]      Adjust the audio rate to the sound card clock (default: true)");
                         Console.WriteLine("  --floppy=[image.st]           Starts with .st floppy image inserted");
                         Console.WriteLine("  --mouse-sensitivity=X,Y       Set mouse sensitivity for X and Y axes (default: 2,2)");
+                        Console.WriteLine("  --cpucore=<library>           Moira build to load: moira, moira_fast, moira_accurate, moira_static (default: moira)");
+                        Console.WriteLine("  --raster=[true/false]         Palette and resolution changes take effect mid line (default: false)");
+                        Console.WriteLine("  --blitter=[true/false]        Emulates the Mega ST BLiTTER (default: false)");
+                        Console.WriteLine("  --trace=N                     Keeps the last N instructions executed, dumped with Ctrl+F12 in debug mode");
+                        Console.WriteLine("  --counters=N                  Logs the CPU bus counters per frame every N frames (headless: adds them to the report)");
+                        Console.WriteLine("  --profile=<file>              Profiles the guest code, writes flamegraph stacks to <file> and a report to <file>.txt on exit");
+                        Console.WriteLine("  --profile-sample=N            Profiler samples every N cycles instead of counting every instruction (default: 0)");
+                        Console.WriteLine("  --state=<file>                Resumes from a save state file");
+                        Console.WriteLine("  --record=<file>               Records the keyboard, mouse and joystick input, stamped with the CPU cycle");
+                        Console.WriteLine("  --replay=<file>               Replays a recorded input from the same start (power on or --state)");
+                        Console.WriteLine("  --capture=<file>              Records the video (.y4m, other extensions go through ffmpeg) and the sound to a .wav next to it");
+                        Console.WriteLine("  --headless[=frames]           Runs unthrottled with no window for N frames (default: 500)");
+                        Console.WriteLine("  --wav=<file>                  Headless: records the audio to a WAV file");
+                        Console.WriteLine("  --dump-frame=N[,N...]         Headless: renders these frames to frameNNNNN.ppm");
+                        Console.WriteLine("  --report=<file>               Headless: writes the JSON report to a file (default: stdout)");
+                        Console.WriteLine("  --corpus=<dir>                Headless: runs every floppy image in <dir>, each in its own machine");
+                        Console.WriteLine("  --jobs=N                      Corpus: machines running at the same time (default: one per core)");
                         Console.WriteLine("  --help, -h                    Show this help message");
                         Environment.Exit(0);
                         break;
@@ -140,7 +140,7 @@ namespace ASE
             Program.Config.DumpJsonConfig();
 
             if (ForceReset)
-                CPU.InitCpu();
+                ASEMain.HardReset();
 
             Close();
         }
@@ -12,11 +12,16 @@ namespace ASE
     /// for use in diagnostic or development environments.</remarks>
     public class Debug
     {
+        // Called from the window, always about the machine shown in it
+        static Machine Machine => ASEMain.Machine!;
+
         public static void DumnpRegs()
         {
+            Moira.CpuState state = Machine.Cpu.GetState();
+
             for (int t = 0; t < 8; t++)
             {
-                uint dn = CPU._moira.D[t];
+                uint dn = state.D[t];
                 Console.Write($"D{t}={dn:X8}");
                 if (t < 7)
                     Console.Write(" ");
@@ -26,7 +31,7 @@ namespace ASE
 
             for (int t = 0; t < 8; t++)
             {
-                uint an = CPU._moira.A[t];
+                uint an = state.A[t];
                 Console.Write($"A{t}={an:X8}");
                 if (t < 7)
                     Console.Write(" ");
@@ -34,9 +39,11 @@ namespace ASE
 
             Console.Write(Environment.NewLine);
 
-            Console.WriteLine("PC=" + CPU._moira.PC.ToString("X8") + 
-                " SR=" + CPU._moira.SR.ToString("X8") +
-                " SP=" + CPU._moira.SP.ToString("X8"));
+            Console.WriteLine("PC=" + state.PC.ToString("X8") + 
+                " SR=" + state.SR.ToString("X8") +
+                " SP=" + state.A[7].ToString("X8") +
+                " USP=" + state.USP.ToString("X8") +
+                " SSP=" + state.SSP.ToString("X8"));
         }
 
         public static void DisassembleRunningPC()
@@ -44,7 +51,7 @@ namespace ASE
             Console.Clear();
 
             Debug.DumnpRegs();
-            Debug.DisassembleAt(CPU._moira.PC - 40, 20);
+            Debug.DisassembleAt(Machine.Cpu.PC - 40, 20);
         }
 
         public static void DisassembleAt(uint addr, int instructions)
@@ -57,13 +64,13 @@ namespace ASE
             {
                 var lineAddr = addr + offset;
                 var sb = new StringBuilder(250);
-                var (disStr, disSize) = CPU._moira.Disassemble(lineAddr, 250);
+                var (disStr, disSize) = Machine.Cpu.Disassemble(lineAddr, 250);
 
                 string data = "";
                 for (uint x = 0 ; x < disSize; x+=2)
-                    data += $"{ASEMain._mem.Read16(lineAddr + x):X4} ";
+                    data += $"{Machine.Mem.Read16(lineAddr + x):X4} ";
 
-                Console.ForegroundColor = (lineAddr == CPU._moira.PC) ? ConsoleColor.White : ConsoleColor.DarkGray;
+                Console.ForegroundColor = (lineAddr == Machine.Cpu.PC) ? ConsoleColor.White : ConsoleColor.DarkGray;
                 Console.WriteLine($"{lineAddr:X8} {data.PadRight(20)} {disStr}");
 
                 offset += (uint)disSize;
@@ -72,6 +79,28 @@ namespace ASE
             Console.ForegroundColor = precolor;
         }
 
+        /// <summary>
+        /// Prints the last <paramref name="count"/> instructions recorded by the native trace (see --trace), the
+        /// newest at the bottom. The disassembly is of the memory as it is now. Must run on the thread of
+        /// <paramref name="machine"/>, which fills the trace ring, see <see cref="Machine.RunAtFrameEnd"/>.
+        /// </summary>
+        public static void DumpTrace(Machine machine, int count)
+        {
+            if (Config.ConfigOptions.RunninConfig.TraceLength <= 0)
+                return;
+
+            var entries = new Moira.TraceEntry[Math.Max(machine.Cpu.TraceCount, 1)];
+            int fetched = machine.Cpu.FetchTrace(entries);
+            int first = Math.Max(0, fetched - count);
+
+            Console.WriteLine($"Trace, last {fetched - first} instructions:");
+            for (int i = first; i < fetched; i++)
+            {
+                var (disStr, _) = machine.Cpu.Disassemble(entries[i].PC, 250);
+                Console.WriteLine($"{entries[i].Clock,12} {entries[i].PC:X8} {entries[i].Opcode:X4} SR={entries[i].SR:X4} {disStr}");
+            }
+        }
+
         public static void DumpMemory(uint startAddr, uint length)
         {
             Console.WriteLine($"Memory Dump from {startAddr:X8} to {startAddr + length - 1:X8}:");
@@ -81,7 +110,7 @@ namespace ASE
                 line.AppendFormat("{0:X8}: ", addr);
                 for (uint offset = 0; offset < 16 && (addr + offset) < (startAddr + length); offset++)
                 {
-                    byte value = ASEMain._mem.Read8(addr + offset);
+                    byte value = Machine.Mem.Read8(addr + offset);
                     line.AppendFormat("{0:X2} ", value);
                 }
                 Console.WriteLine(line.ToString().TrimEnd());
@@ -2,6 +2,8 @@
 using SkiaSharp;
 using System;
 using System.Collections.Generic;
+using System.IO.MemoryMappedFiles;
+using System.Security.Cryptography;
 using System.Text;
 using static ASE.Config;
 
@@ -18,13 +20,24 @@ namespace ASE
             public int SectorSize = 512; // in bytes
         }
 
-        public byte[]? Data;
         public Configuration? DiskConfig;
         public List<Configuration> Configurations = new List<Configuration>();
 
         public bool WriteProtected = true;
 
-        public bool HasDisk => Data != null;
+        // Image contents, mapped or decoded on demand
+        DiskStorage? _storage;
+
+        // Storage released while the FDC may still be reading it, kept until the frame end disposes it (see Release)
+        DiskStorage? _retired;
+
+        public bool HasDisk => _storage != null;
+
+        // Machine whose FDC reads this drive, see Release
+        internal Machine? Owner;
+
+        /// <summary>Size of the image contents in bytes, 0 with no disk.</summary>
+        public int Size => (_storage ?? _retired)?.Length ?? 0;
 
         public FloppyImage()
         {
@@ -53,6 +66,8 @@ namespace ASE
 
             if (File.Exists(path))
             {
+                Release();
+
                 // ST image format
                 if (path.EndsWith(".st", StringComparison.OrdinalIgnoreCase))
                 {
@@ -77,90 +92,53 @@ namespace ASE
                         return false;
                     }
 
-                    Data = File.ReadAllBytes(path);
+                    _storage = new MappedStorage(path, DiskConfig.SizeInBytes);
                     message = $"Floppy image loaded: [[green]]{path}[[/green]]";
                 }
                 // MSA image format
                 else if (path.EndsWith(".msa", StringComparison.OrdinalIgnoreCase))
                 {
-                    using (FileStream fileStream = File.OpenRead(path))
+                    byte[] file = File.ReadAllBytes(path);
+
+                    // Header 5 words:
+                    //
+                    // Word: Signature (&h0E0F)
+                    // Word: Number of sectors
+                    // Word: Number of sides
+                    // Word: Start track
+                    // Word: End track
+                    // Check signature 0x0E0F big-endian
+                    if (file.Length < 10 || file[0] != 0x0E || file[1] != 0x0F)
                     {
-                        // Header 5 words:
-                        //
-                        // Word: Signature (&h0E0F)
-                        // Word: Number of sectors
-                        // Word: Number of sides
-                        // Word: Start track
-                        // Word: End track
-                        byte[] signatureBytes = new byte[10];
-                        fileStream.ReadExactly(signatureBytes, 0, 10);
-
-                        // Check signature 0x0E0F big-endian
-                        if (signatureBytes[0] != 0x0E || signatureBytes[1] != 0x0F)
-                        {
-                            message = $"Invalid MSA file: [[red]]{path}[[/red]]";
-                            Eject();
-                            return false;
-                        }
+                        message = $"Invalid MSA file: [[red]]{path}[[/red]]";
+                        Eject();
+                        return false;
+                    }
 
-                        DiskConfig = new Configuration();
-                        DiskConfig.SectorSize = 512;
-                        DiskConfig.SectorsPerTrack = signatureBytes[3];
-                        DiskConfig.Sides = signatureBytes[5] + 1;
-                        DiskConfig.Tracks = signatureBytes[9] - signatureBytes[7];
+                    DiskConfig = new Configuration();
+                    DiskConfig.SectorSize = 512;
+                    DiskConfig.SectorsPerTrack = file[3];
+                    DiskConfig.Sides = file[5] + 1;
+                    DiskConfig.Tracks = file[9] - file[7];
 
-                        int totalSectors = DiskConfig.Sides * DiskConfig.Tracks * DiskConfig.SectorsPerTrack;
-                        int trackDataSize = DiskConfig.SectorsPerTrack * DiskConfig.SectorSize;
-                        Data = new byte[totalSectors * DiskConfig.SectorSize];
-                        
-                        int index = 0;
+                    // A disk seen before is taken decoded from the cache, otherwise tracks are decoded on first access
+                    string cachePath = MsaStorage.CachePath(file);
 
-                        for(int track = 0; track < DiskConfig.Tracks * DiskConfig.Sides; track++)
+                    if (File.Exists(cachePath) && new FileInfo(cachePath).Length == DiskConfig.SizeInBytes)
+                        _storage = new MappedStorage(cachePath, DiskConfig.SizeInBytes);
+                    else
+                    {
+                        MsaStorage? msa = MsaStorage.Open(file, DiskConfig, cachePath);
+                        if (msa == null)
                         {
-                            // Reads track size
-                            byte[] trackSizeBytes = new byte[2];
-                            fileStream.ReadExactly(trackSizeBytes, 0, 2);
-                            int readedtrackSize = (trackSizeBytes[0] << 8) | trackSizeBytes[1];
-
-                            // If track size == track data size, read directly
-                            if (readedtrackSize == trackDataSize)
-                            {
-                                fileStream.ReadExactly(Data, index, trackDataSize);
-                                index += trackDataSize;
-                            }
-                            // If track size < track data size, read RLE compressed data
-                            else 
-                            {
-                                int startindex = index;
-
-                                do
-                                {
-                                    byte bytestream = (byte)fileStream.ReadByte();
-
-                                    // If 0xE5, RLE compression
-                                    if (bytestream == 0xE5)
-                                    {
-                                        // RLE compression -> 1 byte count, 1 byte repeated value
-                                        byte value = (byte)fileStream.ReadByte();
-                                        byte[] repeatBE = new byte[2];
-                                        fileStream.ReadExactly(repeatBE, 0, 2);
-                                        int count = (repeatBE[0] << 8) | repeatBE[1];
-                                        for (int i = 0; i < count; i++)
-                                        {
-                                            Data[index] = value;
-                                            index++;
-                                        }
-                                    }
-                                    else
-                                    {
-                                        Data[index] = bytestream;
-                                        index++;
-                                    }
-                                } while (index - startindex != trackDataSize);
-                            }
+                            message = $"Invalid MSA file: [[red]]{path}[[/red]]";
+                            Eject();
+                            return false;
                         }
-                        message = $"Floppy image loaded: [[green]]{path}[[/green]]";
+                        _storage = msa;
                     }
+
+                    message = $"Floppy image loaded: [[green]]{path}[[/green]]";
                 }
                 else
                 {
@@ -183,8 +161,248 @@ namespace ASE
         public void Eject() 
         {
             ConfigOptions.RunninConfig.FloppyImagePath = "";
-            Data = null; 
+            Release();
+        }
+
+        /// <summary>
+        /// Image bytes [<paramref name="offset"/>, <paramref name="offset"/> + <paramref name="length"/>), decoded if
+        /// needed. The span is only valid until the disk is changed.
+        /// </summary>
+        public ReadOnlySpan<byte> ReadSectors(int offset, int length) => (_storage ?? _retired)!.Get(offset, length, write: false);
+
+        /// <summary>
+        /// Like <see cref="ReadSectors"/>, for the FDC to write into. Changes stay in memory, the image file is
+        /// never written.
+        /// </summary>
+        public Span<byte> WriteSectors(int offset, int length) => (_storage ?? _retired)!.Get(offset, length, write: true);
+
+        // The FDC can be in the middle of a transfer from the emulator thread, past its HasDisk check: the old
+        // storage stays reachable through _retired until the frame end, where it is released. With no machine
+        // running the drive nothing can be using it.
+        void Release()
+        {
+            DiskStorage? old = _storage;
+            if (old == null)
+                return;
+
+            Machine? owner = Owner;
+            if (owner != null)
+            {
+                _retired = old;
+                _storage = null;
+                owner.RunAtFrameEnd(() =>
+                {
+                    if (_retired == old)
+                        _retired = null;
+                    old.Dispose();
+                });
+            }
+            else
+            {
+                _storage = null;
+                old.Dispose();
+            }
+        }
+
+        abstract class DiskStorage : IDisposable
+        {
+            public abstract int Length { get; }
+            public abstract Span<byte> Get(int offset, int length, bool write);
+            public virtual void Dispose() { }
         }
 
+        /// <summary>
+        /// Raw image mapped copy on write: only the sectors read are paged in and FDC writes stay private.
+        /// </summary>
+        sealed unsafe class MappedStorage : DiskStorage
+        {
+            readonly MemoryMappedFile _file;
+            readonly MemoryMappedViewAccessor _view;
+            readonly byte* _data;
+            readonly int _length;
+
+            public MappedStorage(string path, int length)
+            {
+                _length = length;
+                _file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.CopyOnWrite);
+                _view = _file.CreateViewAccessor(0, length, MemoryMappedFileAccess.CopyOnWrite);
+
+                byte* ptr = null;
+                _view.SafeMemoryMappedViewHandle.AcquirePointer(ref ptr);
+                _data = ptr + _view.PointerOffset;
+            }
+
+            public override int Length => _length;
+
+            public override Span<byte> Get(int offset, int length, bool write) => new Span<byte>(_data + offset, length);
+
+            public override void Dispose()
+            {
+                _view.SafeMemoryMappedViewHandle.ReleasePointer();
+                _view.Dispose();
+                _file.Dispose();
+            }
+        }
+
+        /// <summary>
+        /// MSA image decoded one track at a time on first access. Once every track is decoded and none was
+        /// written, the image is stored in the cache so the next insert of the same file maps it directly. An
+        /// image released unmodified before that has its remaining tracks decoded and is stored then.
+        /// </summary>
+        sealed class MsaStorage : DiskStorage
+        {
+            readonly byte[] _file;
+            readonly int[] _trackStart;         // Offset of the packed data of every track in _file
+            readonly int[] _trackSize;
+            readonly bool[] _decoded;
+            readonly byte[] _data;
+            readonly int _trackDataSize;
+            readonly string _cachePath;
+            int _pending;
+            bool _modified;
+
+            MsaStorage(byte[] file, int tracks, int trackDataSize, string cachePath)
+            {
+                _file = file;
+                _trackStart = new int[tracks];
+                _trackSize = new int[tracks];
+                _decoded = new bool[tracks];
+                _data = new byte[tracks * trackDataSize];
+                _trackDataSize = trackDataSize;
+                _cachePath = cachePath;
+                _pending = tracks;
+            }
+
+            public static string CachePath(byte[] file)
+            {
+                string hash = Convert.ToHexString(SHA1.HashData(file));
+                return Path.Combine(Config.GetAppDefaultConfigsFilePath(), "msacache", hash + ".st");
+            }
+
+            /// <summary>
+            /// Indexes the tracks of the file, nothing is decoded yet.
+            /// </summary>
+            /// <returns>Null if the track table runs past the end of the file.</returns>
+            public static MsaStorage? Open(byte[] file, Configuration config, string cachePath)
+            {
+                int tracks = config.Tracks * config.Sides;
+                int trackDataSize = config.SectorsPerTrack * config.SectorSize;
+
+                if (tracks <= 0 || trackDataSize <= 0)
+                    return null;
+
+                var msa = new MsaStorage(file, tracks, trackDataSize, cachePath);
+                int pos = 10;
+
+                for (int track = 0; track < tracks; track++)
+                {
+                    // Reads track size
+                    if (pos + 2 > file.Length)
+                        return null;
+
+                    int size = (file[pos] << 8) | file[pos + 1];
+                    pos += 2;
+
+                    if (pos + size > file.Length)
+                        return null;
+
+                    msa._trackStart[track] = pos;
+                    msa._trackSize[track] = size;
+                    pos += size;
+                }
+
+                return msa;
+            }
+
+            public override int Length => _data.Length;
+
+            public override Span<byte> Get(int offset, int length, bool write)
+            {
+                if (length > 0)
+                {
+                    for (int track = offset / _trackDataSize; track <= (offset + length - 1) / _trackDataSize; track++)
+                    {
+                        if (!_decoded[track])
+                            Decode(track);
+                    }
+                }
+
+                _modified |= write;
+                return _data.AsSpan(offset, length);
+            }
+
+            void Decode(int track)
+            {
+                ReadOnlySpan<byte> packed = _file.AsSpan(_trackStart[track], _trackSize[track]);
+                Span<byte> output = _data.AsSpan(track * _trackDataSize, _trackDataSize);
+
+                // If track size == track data size, it is stored as is
+                if (packed.Length == _trackDataSize)
+                    packed.CopyTo(output);
+                // If track size < track data size, RLE compressed data. A damaged track leaves the rest zeroed.
+                else
+                {
+                    int index = 0;
+                    int pos = 0;
+
+                    while (index < output.Length && pos < packed.Length)
+                    {
+                        byte bytestream = packed[pos++];
+
+                        // If 0xE5, RLE compression -> 1 byte repeated value, 1 word count
+                        if (bytestream == 0xE5 && pos + 3 <= packed.Length)
+                        {
+                            byte value = packed[pos];
+                            int count = Math.Min((packed[pos + 1] << 8) | packed[pos + 2], output.Length - index);
+                            pos += 3;
+
+                            output.Slice(index, count).Fill(value);
+                            index += count;
+                        }
+                        else
+                            output[index++] = bytestream;
+                    }
+                }
+
+                _decoded[track] = true;
+
+                if (--_pending == 0 && !_modified)
+                    StoreInCache();
+            }
+
+            public override void Dispose()
+            {
+                // Written disks are not cached, and a complete one is already there
+                if (_modified || _pending == 0)
+                    return;
+
+                for (int track = 0; track < _decoded.Length; track++)
+                {
+                    if (!_decoded[track])
+                        Decode(track);
+                }
+            }
+
+            void StoreInCache()
+            {
+                try
+                {
+                    Directory.CreateDirectory(Path.GetDirectoryName(_cachePath)!);
+
+                    // Written aside and renamed, a cache file is always complete
+                    string temp = _cachePath + ".tmp";
+                    File.WriteAllBytes(temp, _data);
+                    File.Move(temp, _cachePath, overwrite: true);
+                }
+                catch (IOException e)
+                {
+                    ColoredConsole.WriteLine($"[[yellow]]MSA cache not written: {e.Message}[[/yellow]]");
+                }
+                catch (UnauthorizedAccessException e)
+                {
+                    ColoredConsole.WriteLine($"[[yellow]]MSA cache not written: {e.Message}[[/yellow]]");
+                }
+            }
+        }
     }
 }
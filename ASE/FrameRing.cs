@@ -0,0 +1,118 @@
+﻿/*
+ *
+ * Triple buffered frame handoff between the emulator and the display
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+namespace ASE
+{
+    /// <summary>
+    /// Three screen buffers passed between one producer (the emulator thread) and one consumer (the GL control)
+    /// with atomic index swaps, neither side ever waits for the other.
+    /// </summary>
+    /// <remarks>The producer owns <see cref="Back"/> for a whole frame and swaps it with the ready slot at VBL.
+    /// The consumer swaps its front buffer with the ready slot when a newer frame is there, so it always gets the
+    /// latest completed frame and frames it missed are simply dropped. Every published frame carries the lines
+    /// that changed against the previous one, and <see cref="TryAcquire"/> merges the masks of the dropped frames
+    /// so the consumer can update only those lines.</remarks>
+    public sealed class FrameRing
+    {
+        public const int Lines = 200;
+        public const int RowWords = (Lines + 63) / 64;
+
+        const int IndexMask = 3;
+        const int Fresh = 4;            // Set in _ready while the consumer has not taken it
+        const int History = 16;         // Frames of changed line masks kept for the consumer
+
+        readonly uint[][] _buffers;
+        readonly long[] _sequence = new long[3];
+        readonly ulong[] _changed = new ulong[History * RowWords];
+
+        int _back = 0;                  // Producer only
+        int _ready = 1;                 // Shared, slot index | Fresh
+        int _front = 2;                 // Consumer only
+        int _last = 1;                  // Producer only, slot of the last frame published
+        long _published;                // Last sequence published
+        long _acquired;                 // Consumer only, sequence of the front buffer
+
+        public FrameRing(int size)
+        {
+            _buffers = new uint[][] { new uint[size], new uint[size], new uint[size] };
+        }
+
+        /// <summary>Buffer the producer renders the current frame into.</summary>
+        public uint[] Back => _buffers[_back];
+
+        /// <summary>Slot of <see cref="Back"/>, so the renderer can tell the three buffers apart.</summary>
+        public int BackIndex => _back;
+
+        /// <summary>
+        /// Last frame published. Producer only: the producer does not write it until its next
+        /// <see cref="Publish"/>, whether the consumer has taken it or not.
+        /// </summary>
+        public uint[] LastPublished => _buffers[_last];
+
+        /// <summary>Frames published so far.</summary>
+        public long PublishedCount => _published;
+
+        /// <summary>Buffer the consumer last acquired.</summary>
+        public uint[] Front => _buffers[_front];
+
+        /// <summary>
+        /// Publishes the back buffer as the newest frame and takes a free buffer for the next one. Producer only.
+        /// </summary>
+        /// <param name="changedRows">Lines that differ from the previous published frame, one bit per line.</param>
+        public void Publish(ReadOnlySpan<ulong> changedRows)
+        {
+            long sequence = _published + 1;
+
+            changedRows.CopyTo(_changed.AsSpan((int)(sequence % History) * RowWords, RowWords));
+            _sequence[_back] = sequence;
+
+            // Full fence, the mask and the sequence are visible before the slot
+            _last = _back;
+            _back = Interlocked.Exchange(ref _ready, _back | Fresh) & IndexMask;
+            Volatile.Write(ref _published, sequence);
+        }
+
+        /// <summary>
+        /// Takes the newest published frame into <see cref="Front"/> if there is one. Consumer only.
+        /// </summary>
+        /// <param name="changedRows">Receives the lines that differ from the previous front buffer.</param>
+        /// <returns>False if no frame was published since the last call.</returns>
+        public bool TryAcquire(Span<ulong> changedRows)
+        {
+            if ((Volatile.Read(ref _ready) & Fresh) == 0)
+                return false;
+
+            _front = Interlocked.Exchange(ref _ready, _front) & IndexMask;
+
+            long last = _acquired;
+            long sequence = _sequence[_front];
+            _acquired = sequence;
+
+            changedRows.Clear();
+
+            if (last == 0 || sequence - last > History)
+            {
+                changedRows.Fill(ulong.MaxValue);
+                return true;
+            }
+
+            for (long s = last + 1; s <= sequence; s++)
+            {
+                ReadOnlySpan<ulong> mask = _changed.AsSpan((int)(s % History) * RowWords, RowWords);
+                for (int i = 0; i < RowWords; i++)
+                    changedRows[i] |= mask[i];
+            }
+
+            // The producer may have wrapped around the oldest mask while it was read
+            if (Volatile.Read(ref _published) + 1 - History > last)
+                changedRows.Fill(ulong.MaxValue);
+
+            return true;
+        }
+    }
+}
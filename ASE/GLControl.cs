@@ -172,7 +172,7 @@ namespace ASE
         private const int SrcW = ASEMain.ScreenWidth;
         private const int SrcH = ASEMain.ScreenHeight / 2;
 
-        private readonly byte[] pixels = new byte[SrcW * SrcH * 4];
+        private bool _uploadAll = true;   // The texture starts empty
 
         private void CheckShader(uint shader, string name)
         {
@@ -265,6 +265,7 @@ namespace ASE
                            GLEnum.Rgba, GLEnum.UnsignedByte, null);
 
             _gl.GenerateMipmap(GLEnum.Texture2D);
+            _uploadAll = true;
             
             // Cache uniforms + set constantes
             _gl.UseProgram(_program);
@@ -320,15 +321,8 @@ namespace ASE
             if (_uMaskLoc >= 0) _gl.Uniform1(_uMaskLoc, Config.ConfigOptions.RunninConfig.Mask);
             if (_uNoiseLoc >= 0) _gl.Uniform1(_uNoiseLoc, Config.ConfigOptions.RunninConfig.Noise);
 
-            // Subir píxeles
-            // ObtenerPixelesRGBA se encarga de copiar los píxeles en el buffer del bucle principal
-            // El bucle principal debería tener un método de copia, esto es sólo temporal.
-            byte[] pixelData = ObtenerPixelesRGBA();
-            fixed (void* pData = pixelData)
-            {
-                _gl.TexSubImage2D(GLEnum.Texture2D, 0, 0, 0, SrcW, SrcH,
-                                  GLEnum.Rgba , GLEnum.UnsignedByte, pData);
-            }
+            // Subir píxeles, sólo las líneas que el renderer ha cambiado
+            UploadDirtyRows();
 
             _gl.DrawArrays(GLEnum.TriangleFan, 0, 4);
 
@@ -344,10 +338,44 @@ namespace ASE
             base.OnOpenGlDeinit(gl);
         }
 
-        private byte[] ObtenerPixelesRGBA()
+        // Takes the newest frame from the emulator, never waiting for it, and uploads every run of consecutive
+        // changed lines straight from the frame buffer, whose pixels are already laid out as RGBA bytes
+        private unsafe void UploadDirtyRows()
         {
-            System.Buffer.BlockCopy(ASEMain.ScreenBuffer, 0, pixels, 0, pixels.Length);
-            return pixels;
+            Span<ulong> rows = stackalloc ulong[FrameRing.RowWords];
+
+            if (!ASEMain.Frames.TryAcquire(rows))
+            {
+                if (!_uploadAll)
+                    return;
+                rows.Clear();
+            }
+
+            if (_uploadAll)
+            {
+                rows.Fill(ulong.MaxValue);
+                _uploadAll = false;
+            }
+
+            fixed (uint* screen = ASEMain.Frames.Front)
+            {
+                int y = 0;
+                while (y < SrcH)
+                {
+                    if ((rows[y >> 6] & (1ul << (y & 63))) == 0)
+                    {
+                        y++;
+                        continue;
+                    }
+
+                    int first = y;
+                    while (y < SrcH && (rows[y >> 6] & (1ul << (y & 63))) != 0)
+                        y++;
+
+                    _gl.TexSubImage2D(GLEnum.Texture2D, 0, 0, first, SrcW, (uint)(y - first),
+                                      GLEnum.Rgba, GLEnum.UnsignedByte, screen + first * SrcW);
+                }
+            }
         }
     }
 }
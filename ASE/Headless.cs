@@ -0,0 +1,325 @@
+﻿/*
+ *
+ * Headless turbo mode
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Diagnostics;
+using System.Runtime.InteropServices;
+using System.Security.Cryptography;
+using System.Text.Json;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// Runs the machine for a fixed number of frames with no window, no SDL and no throttling, for CI and
+    /// benchmarking. Writes a JSON report with the emulated speed at the end, alone on stdout unless --report gives
+    /// a file: the console log goes to stderr in this mode.
+    /// </summary>
+    /// <remarks>Frames are only rendered when requested with --dump-frame (written as PPM), and audio is only
+    /// synthesized when recorded with --wav. --capture renders and records everything. All runs on the calling
+    /// thread but the capture writer. With --corpus every floppy image of a directory gets a machine of its own, up
+    /// to --jobs of them running at the same time.</remarks>
+    public static class Headless
+    {
+        const double StClockHz = 8012800.0;   // 313 lines * 512 cycles * 50 Hz
+
+        public static int Run()
+        {
+            var config = ConfigOptions.RunninConfig;
+
+            if (!string.IsNullOrEmpty(config.CorpusPath))
+                return RunCorpus(config);
+
+            HashSet<int> dumpFrames = ParseFrameList(config.DumpFrames);
+
+            using Machine? machine = Machine.Create(ASEMain.driveA, ASEMain.driveB);
+            if (machine == null)
+                return 1;
+
+            if (!string.IsNullOrEmpty(config.StatePath))
+                SaveState.LoadFromFile(machine, config.StatePath);
+
+            InputLog.Attach(machine);
+            Capture.Attach(machine);
+
+            // Frames are rendered on request (see the frame loop), a capture needs the sound as well as every frame
+            machine.RenderFrame = false;
+            machine.SynthesizeAudio = !string.IsNullOrEmpty(config.WavPath) || machine.Capture != null;
+
+            using WavWriter wav = !string.IsNullOrEmpty(config.WavPath) ? new WavWriter(config.WavPath, config.SampleRate) : null;
+
+            ColoredConsole.WriteLine($"Headless run of [[yellow]]{config.HeadlessFrames}[[/yellow]] frames...");
+
+            long startClock = machine.Cpu.Clock;
+            Moira.Counters startCounters = machine.Cpu.GetCounters();
+            var sw = Stopwatch.StartNew();
+            int framesDumped = 0;
+            string? screenHash = null;
+            Span<ulong> changedRows = stackalloc ulong[FrameRing.RowWords];
+            float[] samples = new float[4096];
+
+            for (int frame = 0; frame < config.HeadlessFrames; frame++)
+            {
+                // The last frame is always rendered, for the hash in the report
+                bool last = frame == config.HeadlessFrames - 1;
+                machine.RenderFrame = last || dumpFrames.Contains(frame) || machine.Capture != null;
+
+                machine.RunFrame();
+
+                if (machine.RenderFrame && machine.Frames.TryAcquire(changedRows))
+                {
+                    if (dumpFrames.Contains(frame))
+                    {
+                        WritePpm($"frame{frame:D5}.ppm", machine.Frames.Front);
+                        framesDumped++;
+                    }
+
+                    if (last)
+                        screenHash = ScreenHash(machine.Frames.Front);
+                }
+
+                if (wav != null)
+                {
+                    int read;
+                    while ((read = machine.Ym.Audio.Read(samples)) > 0)
+                        wav.Write(samples.AsSpan(0, read));
+                }
+            }
+
+            sw.Stop();
+            Profiler.WriteIfEnabled(machine);
+
+            long cycles = machine.Cpu.Clock - startClock;
+            double seconds = sw.Elapsed.TotalSeconds;
+            double mhz = seconds > 0 ? cycles / seconds / 1e6 : 0;
+
+            WriteReport(config, cycles, seconds, mhz, machine.SynthesizeAudio, framesDumped, screenHash, machine.Acia.Replay,
+                machine.Cpu.GetCounters() - startCounters);
+            ColoredConsole.WriteLine($"Emulated [[green]]{mhz:F2} MHz[[/green]] ({mhz * 1e6 / StClockHz:F2}x real time) in {seconds:F3} s.");
+
+            return 0;
+        }
+
+        static void WriteReport(ConfigOptions config, long cycles, double seconds, double mhz, bool audio, int framesDumped,
+            string? screenHash, InputLog.InputReplay? replay, in Moira.Counters counters)
+        {
+            using var stream = string.IsNullOrEmpty(config.ReportPath) ? Console.OpenStandardOutput() : File.Create(config.ReportPath);
+            using (var json = new Utf8JsonWriter(stream, new JsonWriterOptions { Indented = true }))
+            {
+                json.WriteStartObject();
+                json.WriteString("cpu_core", CPU.Core.Profile);
+                json.WriteNumber("frames", config.HeadlessFrames);
+                json.WriteNumber("cycles", cycles);
+                json.WriteNumber("seconds", seconds);
+                json.WriteNumber("emulated_mhz", mhz);
+                json.WriteNumber("realtime_factor", mhz * 1e6 / StClockHz);
+                json.WriteBoolean("audio", audio);
+                json.WriteNumber("frames_dumped", framesDumped);
+                json.WriteString("screen_sha1", screenHash);
+                if (replay != null)
+                {
+                    json.WriteNumber("input_events", replay.Count);
+                    json.WriteNumber("input_replayed", replay.Replayed);
+                }
+                if (PerfCounters.Enabled)
+                    PerfCounters.WriteJson(json, counters, config.HeadlessFrames);
+                json.WriteEndObject();
+            }
+            stream.WriteByte((byte)'\n');
+        }
+
+        /// <summary>
+        /// Outcome of one image of a corpus run.
+        /// </summary>
+        sealed class CorpusResult
+        {
+            public required string Image;
+            public long Cycles;
+            public double Seconds;
+            public string? ScreenHash;
+            public string? Error;
+        }
+
+        /// <summary>
+        /// Boots every floppy image of the --corpus directory for the headless frame count, one machine per image
+        /// on up to --jobs threads. The report gives, per image, the speed and a hash of the last frame, which is
+        /// what two builds are compared on.
+        /// </summary>
+        /// <returns>0 if every image ran to the end.</returns>
+        static int RunCorpus(ConfigOptions config)
+        {
+            string[] images = Directory.Exists(config.CorpusPath)
+                ? Directory.GetFiles(config.CorpusPath).Where(IsDiskImage).Order(StringComparer.Ordinal).ToArray()
+                : Array.Empty<string>();
+
+            if (images.Length == 0)
+            {
+                ColoredConsole.WriteLine($"[[red]]No floppy images found in {config.CorpusPath}[[/red]]");
+                return 1;
+            }
+
+            int jobs = config.Jobs > 0 ? config.Jobs : Environment.ProcessorCount;
+            ColoredConsole.WriteLine($"Headless run of [[yellow]]{images.Length}[[/yellow]] images, {config.HeadlessFrames} frames each, {jobs} at a time...");
+
+            var results = new CorpusResult[images.Length];
+            var sw = Stopwatch.StartNew();
+
+            // Each image runs start to end on the thread that picked it, machines never move between threads
+            Parallel.For(0, images.Length, new ParallelOptions { MaxDegreeOfParallelism = jobs },
+                i => results[i] = RunImage(images[i], config.HeadlessFrames));
+
+            sw.Stop();
+
+            WriteCorpusReport(config, jobs, sw.Elapsed.TotalSeconds, results);
+
+            int failed = results.Count(r => r.Error != null);
+            long cycles = results.Sum(r => r.Cycles);
+            double mhz = sw.Elapsed.TotalSeconds > 0 ? cycles / sw.Elapsed.TotalSeconds / 1e6 : 0;
+            ColoredConsole.WriteLine($"Emulated [[green]]{mhz:F2} MHz[[/green]] in total over {images.Length} images in {sw.Elapsed.TotalSeconds:F3} s, " +
+                (failed == 0 ? "[[green]]all ran[[/green]]." : $"[[red]]{failed} failed[[/red]]."));
+
+            return failed == 0 ? 0 : 1;
+        }
+
+        static bool IsDiskImage(string path)
+        {
+            string ext = Path.GetExtension(path);
+            return ext.Equals(".st", StringComparison.OrdinalIgnoreCase) || ext.Equals(".msa", StringComparison.OrdinalIgnoreCase);
+        }
+
+        static CorpusResult RunImage(string path, int frames)
+        {
+            var result = new CorpusResult { Image = Path.GetFileName(path) };
+            var driveA = new FloppyImage();
+            var driveB = new FloppyImage();
+
+            if (!driveA.Insert(path, out string message))
+            {
+                result.Error = ColoredConsole.StripMarkup(message);
+                return result;
+            }
+
+            Machine? machine = null;
+            try
+            {
+                machine = Machine.Create(driveA, driveB);
+                if (machine == null)
+                {
+                    result.Error = "The machine could not be built";
+                    return result;
+                }
+
+                machine.RenderFrame = false;
+                machine.SynthesizeAudio = false;
+
+                long startClock = machine.Cpu.Clock;
+                var sw = Stopwatch.StartNew();
+
+                // Only the last frame is rendered, for the hash
+                for (int frame = 0; frame < frames; frame++)
+                {
+                    machine.RenderFrame = frame == frames - 1;
+                    machine.RunFrame();
+                }
+
+                sw.Stop();
+                result.Cycles = machine.Cpu.Clock - startClock;
+                result.Seconds = sw.Elapsed.TotalSeconds;
+
+                Span<ulong> changedRows = stackalloc ulong[FrameRing.RowWords];
+                if (machine.Frames.TryAcquire(changedRows))
+                    result.ScreenHash = ScreenHash(machine.Frames.Front);
+            }
+            catch (Exception ex)
+            {
+                // One broken image does not stop the rest of the corpus
+                result.Error = ex.Message;
+            }
+            finally
+            {
+                machine?.Dispose();
+                driveA.Eject();
+            }
+
+            return result;
+        }
+
+        static string ScreenHash(uint[] frame) => Convert.ToHexString(SHA1.HashData(MemoryMarshal.AsBytes(frame.AsSpan())));
+
+        static void WriteCorpusReport(ConfigOptions config, int jobs, double seconds, CorpusResult[] results)
+        {
+            using var stream = string.IsNullOrEmpty(config.ReportPath) ? Console.OpenStandardOutput() : File.Create(config.ReportPath);
+            using (var json = new Utf8JsonWriter(stream, new JsonWriterOptions { Indented = true }))
+            {
+                json.WriteStartObject();
+                json.WriteString("cpu_core", CPU.Core.Profile);
+                json.WriteNumber("frames", config.HeadlessFrames);
+                json.WriteNumber("jobs", jobs);
+                json.WriteNumber("seconds", seconds);
+
+                json.WriteStartArray("images");
+                foreach (CorpusResult r in results)
+                {
+                    json.WriteStartObject();
+                    json.WriteString("image", r.Image);
+                    if (r.Error != null)
+                    {
+                        json.WriteString("error", r.Error);
+                    }
+                    else
+                    {
+                        json.WriteNumber("cycles", r.Cycles);
+                        json.WriteNumber("seconds", r.Seconds);
+                        json.WriteNumber("emulated_mhz", r.Seconds > 0 ? r.Cycles / r.Seconds / 1e6 : 0);
+                        json.WriteString("screen_sha1", r.ScreenHash);
+                    }
+                    json.WriteEndObject();
+                }
+                json.WriteEndArray();
+
+                json.WriteEndObject();
+            }
+            stream.WriteByte((byte)'\n');
+        }
+
+        static HashSet<int> ParseFrameList(string list)
+        {
+            var frames = new HashSet<int>();
+
+            foreach (string item in list.Split(',', StringSplitOptions.RemoveEmptyEntries | StringSplitOptions.TrimEntries))
+            {
+                if (int.TryParse(item, out int frame))
+                    frames.Add(frame);
+            }
+
+            return frames;
+        }
+
+        // 640x200 RGB, the pixel layout of the frame buffers (red in the low byte)
+        static void WritePpm(string path, uint[] buffer)
+        {
+            const int width = ASEMain.ScreenWidth;
+            const int height = 200;
+
+            using var file = File.Create(path);
+            file.Write(System.Text.Encoding.ASCII.GetBytes($"P6\n{width} {height}\n255\n"));
+
+            byte[] row = new byte[width * 3];
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    uint p = buffer[y * width + x];
+                    row[x * 3 + 0] = (byte)p;
+                    row[x * 3 + 1] = (byte)(p >> 8);
+                    row[x * 3 + 2] = (byte)(p >> 16);
+                }
+                file.Write(row);
+            }
+        }
+    }
+}
@@ -0,0 +1,167 @@
+﻿/*
+ *
+ * Input recording and replay
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using static ASE.Config;
+
+namespace ASE
+{
+    public enum InputKind : byte
+    {
+        Key = 0,            // A: IKBD scancode, with bit 7 set on release
+        Mouse = 1,          // A, B: relative motion as signed bytes, sensitivity already applied
+        MouseButton = 2,    // A: button bit, B: pressed
+        Joystick = 3,       // A: JOY_* mask, B: pressed
+    }
+
+    /// <summary>
+    /// One input from the host to the IKBD, as queued by <see cref="ACIA"/>.
+    /// </summary>
+    public readonly record struct InputEvent(InputKind Kind, byte A, byte B);
+
+    /// <summary>
+    /// Starts the --record or --replay given in the command line.
+    /// </summary>
+    /// <remarks>The host input reaches the machine on the first scanline after it arrives (see
+    /// <see cref="ACIA.Sync"/>), so it lands at a cycle that only depends on the emulation. A session recorded from
+    /// a power on or a save state replays the same way from that same start, with the same configuration and disks,
+    /// which together with the headless mode gives runs that can be timed and compared frame by frame. Loading a
+    /// state while recording breaks the recording.</remarks>
+    public static class InputLog
+    {
+        const uint Magic = 0x49455341;      // "ASEI"
+        const int Version = 1;
+
+        /// <summary>
+        /// Attaches the recorder or the replay asked for to <paramref name="machine"/>, once per session: the
+        /// machines built by later resets run without them.
+        /// </summary>
+        public static void Attach(Machine machine)
+        {
+            var config = ConfigOptions.RunninConfig;
+
+            if (!string.IsNullOrEmpty(config.ReplayPath))
+            {
+                machine.Acia.Replay = InputReplay.Load(config.ReplayPath, machine.Cpu.Clock);
+                config.ReplayPath = "";
+            }
+            else if (!string.IsNullOrEmpty(config.RecordPath))
+            {
+                machine.Acia.Recorder = new InputRecorder(config.RecordPath, machine.Cpu.Clock);
+                ColoredConsole.WriteLine($"Recording input to [[green]]{config.RecordPath}[[/green]]");
+                config.RecordPath = "";
+            }
+        }
+
+        /// <summary>
+        /// Writes the input applied to a machine, each event stamped with the CPU cycle it was applied at.
+        /// </summary>
+        public sealed class InputRecorder : IDisposable
+        {
+            readonly BinaryWriter _w;
+
+            public InputRecorder(string path, long startClock)
+            {
+                _w = new BinaryWriter(File.Create(path));
+                _w.Write(Magic);
+                _w.Write(Version);
+                _w.Write(startClock);
+                _w.Flush();
+            }
+
+            /// <summary>Called from the thread of the machine. Input is rare, each event goes to the file at once.</summary>
+            public void Write(long cycle, InputEvent e)
+            {
+                _w.Write(cycle);
+                _w.Write((byte)e.Kind);
+                _w.Write(e.A);
+                _w.Write(e.B);
+                _w.Flush();
+            }
+
+            public void Dispose() => _w.Dispose();
+        }
+
+        /// <summary>
+        /// A recorded session, handed back to the machine at the cycles it was recorded at.
+        /// </summary>
+        public sealed class InputReplay
+        {
+            readonly long[] _cycles;
+            readonly InputEvent[] _events;
+            int _next;
+
+            InputReplay(long[] cycles, InputEvent[] events)
+            {
+                _cycles = cycles;
+                _events = events;
+            }
+
+            /// <summary>Events replayed so far.</summary>
+            public int Replayed => _next;
+
+            public int Count => _events.Length;
+
+            /// <summary>
+            /// Reads a recording made by <see cref="InputRecorder"/>.
+            /// </summary>
+            /// <param name="startClock">Clock of the machine it will drive, to warn when it does not start where
+            /// the recording did.</param>
+            /// <returns>Null if the file cannot be read, the reason is on the console.</returns>
+            public static InputReplay? Load(string path, long startClock)
+            {
+                try
+                {
+                    using var r = new BinaryReader(File.OpenRead(path));
+
+                    if (r.ReadUInt32() != Magic || r.ReadInt32() != Version)
+                    {
+                        ColoredConsole.WriteLine($"[[red]]{path} is not an input recording of this ASE version[[/red]]");
+                        return null;
+                    }
+
+                    long recordedStart = r.ReadInt64();
+                    if (recordedStart != startClock)
+                        ColoredConsole.WriteLine($"Warning: [[yellow]]{path}[[/yellow]] was recorded from cycle {recordedStart}, the machine is at {startClock}. The replay will not match.");
+
+                    var cycles = new List<long>();
+                    var events = new List<InputEvent>();
+
+                    // A recording cut short by a crash ends on a partial record, which is dropped
+                    while (r.BaseStream.Length - r.BaseStream.Position >= 11)
+                    {
+                        cycles.Add(r.ReadInt64());
+                        events.Add(new InputEvent((InputKind)r.ReadByte(), r.ReadByte(), r.ReadByte()));
+                    }
+
+                    ColoredConsole.WriteLine($"Replaying [[green]]{events.Count}[[/green]] input events from [[green]]{path}[[/green]]");
+                    return new InputReplay(cycles.ToArray(), events.ToArray());
+                }
+                catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
+                {
+                    ColoredConsole.WriteLine($"[[red]]Cannot read {path}: {ex.Message}[[/red]]");
+                    return null;
+                }
+            }
+
+            /// <summary>
+            /// Takes the next event if it was recorded at or before <paramref name="clock"/>.
+            /// </summary>
+            public bool TryTake(long clock, out InputEvent e)
+            {
+                if (_next < _events.Length && _cycles[_next] <= clock)
+                {
+                    e = _events[_next++];
+                    return true;
+                }
+
+                e = default;
+                return false;
+            }
+        }
+    }
+}
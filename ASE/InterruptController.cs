@@ -10,11 +10,17 @@ namespace ASE
 {
     public class InterruptController
     {
+        private readonly Moira _cpu;
         private int currentIRQLevel = 0;
         private bool vblPending = false;
         private bool hblPending = false;
         private bool mfpPending = false;
 
+        public InterruptController(Moira cpu)
+        {
+            _cpu = cpu;
+        }
+
         public void RaiseMFP()
         {
             mfpPending = true;
@@ -51,6 +57,23 @@ namespace ASE
             UpdateIRQ();
         }
 
+        public void SaveState(BinaryWriter w)
+        {
+            w.Write(currentIRQLevel);
+            w.Write(vblPending);
+            w.Write(hblPending);
+            w.Write(mfpPending);
+        }
+
+        // The CPU IPL is restored with the CPU state
+        public void LoadState(BinaryReader r)
+        {
+            currentIRQLevel = r.ReadInt32();
+            vblPending = r.ReadBoolean();
+            hblPending = r.ReadBoolean();
+            mfpPending = r.ReadBoolean();
+        }
+
         private void UpdateIRQ()
         {
             byte newLevel = 0;
@@ -65,7 +88,7 @@ namespace ASE
             if (newLevel != currentIRQLevel)
             {
                 currentIRQLevel = newLevel;
-                CPU._moira.IPL = newLevel;
+                _cpu.IPL = newLevel;
             }
         }
     }
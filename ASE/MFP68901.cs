@@ -48,16 +48,22 @@ namespace ASE
         public byte TCDR = 0x00;    // $FFFA23 - Timer C Data
         public byte TDDR = 0x00;    // $FFFA25 - Timer D Data
 
-        // Internal timer counters
-        public int timerACounter = 0;
-        public int timerBCounter = 0;
-        public int timerCCounter = 0;
-        public int timerDCounter = 0;
-
-        public int timerAPredivAcc = 0;
-        int timerBPredivAcc = 0;
-        int timerCPredivAcc = 0;
-        int timerDPredivAcc = 0;
+        // Timers, index of the arrays below
+        public const int TimerA = 0;
+        public const int TimerB = 1;
+        public const int TimerC = 2;
+        public const int TimerD = 3;
+
+        /*
+         * Timers in delay mode are not stepped: each one keeps the MFP clock tick its prescaler counts from and
+         * the counter at that tick, which gives the counter at any later tick. Reads of the data registers work it
+         * out from the CPU clock, and the next underflow of the timers whose interrupt is enabled is the single
+         * CPU.EventId.MfpTimer event, at the cycle it happens. Stopped timers and timers in event count mode
+         * keep their counter in _timerCount.
+         */
+        readonly long[] _timerBase = new long[4];   // MFP tick the prescaler started from
+        readonly int[] _timerCount = new int[4];    // Counter at _timerBase
+        readonly long[] _timerDue = new long[4];    // MFP tick of the next underflow scheduled, long.MaxValue if none
 
         public static class RegA
         {
@@ -77,7 +83,7 @@ namespace ASE
             public const byte ACIA = 0x40;      // GPIP 4 (Joystick/Kbd)
             public const byte TimerC = 0x20;
             public const byte TimerD = 0x10;
-            public const byte Blitter = 0x08;   // Not used on ASE.. by now
+            public const byte Blitter = 0x08;   // GPIP 3
             public const byte GPIP2 = 0x04;
             public const byte GPIP1 = 0x02;
             public const byte GPIP0 = 0x01;
@@ -85,25 +91,26 @@ namespace ASE
 
         public InterruptController irqController;
 
-        // In MFP68901
-        const int CPU_HZ = 8000000;      // ST
-        const int MFP_HZ = 2457600;      // MFP clock
+        // The MFP clock is 2.4576 MHz, 192 ticks every 625 cycles of the 8 MHz CPU
+        const long MFP_TICKS = 192;
+        const long CPU_CYCLES = 625;
 
-        long mfpAcc = 0; // accumulator in "Hz*cycles"
+        readonly Moira _cpu;
 
         public bool SoftwareEOI => (VR & 0x08) != 0; // S bit
         int Reload(byte dr) => dr == 0 ? 256 : dr;
 
-        public MFP68901()
+        public MFP68901(Moira cpu)
         {
-            irqController = new InterruptController();
+            _cpu = cpu;
+            irqController = new InterruptController(cpu);
 
             Reset();
         }
 
         public void Reset()
         {
-            mfpAcc = 0;
+            Array.Fill(_timerDue, long.MaxValue);
             AER = 0x00;
             GPIP = 0xFF; // Inputs por defecto a pull-up
             VR = 0x40;   // Vector base 64 ($40)
@@ -117,6 +124,40 @@ namespace ASE
             irqController.ClearMFP();
         }
 
+        public void SaveState(BinaryWriter w)
+        {
+            w.Write(GPIP); w.Write(AER); w.Write(DDR);
+            w.Write(IERA); w.Write(IERB); w.Write(IPRA); w.Write(IPRB);
+            w.Write(ISRA); w.Write(ISRB); w.Write(IMRA); w.Write(IMRB);
+            w.Write(VR);
+            w.Write(TACR); w.Write(TBCR); w.Write(TCDCR);
+            w.Write(TADR); w.Write(TBDR); w.Write(TCDR); w.Write(TDDR);
+
+            for (int t = 0; t < 4; t++)
+            {
+                w.Write(_timerBase[t]); w.Write(_timerCount[t]); w.Write(_timerDue[t]);
+            }
+
+            irqController.SaveState(w);
+        }
+
+        public void LoadState(BinaryReader r)
+        {
+            GPIP = r.ReadByte(); AER = r.ReadByte(); DDR = r.ReadByte();
+            IERA = r.ReadByte(); IERB = r.ReadByte(); IPRA = r.ReadByte(); IPRB = r.ReadByte();
+            ISRA = r.ReadByte(); ISRB = r.ReadByte(); IMRA = r.ReadByte(); IMRB = r.ReadByte();
+            VR = r.ReadByte();
+            TACR = r.ReadByte(); TBCR = r.ReadByte(); TCDCR = r.ReadByte();
+            TADR = r.ReadByte(); TBDR = r.ReadByte(); TCDR = r.ReadByte(); TDDR = r.ReadByte();
+
+            for (int t = 0; t < 4; t++)
+            {
+                _timerBase[t] = r.ReadInt64(); _timerCount[t] = r.ReadInt32(); _timerDue[t] = r.ReadInt64();
+            }
+
+            irqController.LoadState(r);
+        }
+
         public bool HasActiveInterrupts()
         {
             byte activeA = (byte)(IPRA & IERA & IMRA);
@@ -251,10 +292,10 @@ namespace ASE
         {
             if ((TACR & 0x0F) == 0x08)
             {
-                timerACounter--;
-                if (timerACounter <= 0)
+                _timerCount[TimerA]--;
+                if (_timerCount[TimerA] <= 0)
                 {
-                    timerACounter = Reload(TADR);
+                    _timerCount[TimerA] = Reload(TADR);
                     SetInterruptPending(RegA.TimerA, false);
                 }
             }
@@ -264,112 +305,225 @@ namespace ASE
         {
             if ((TBCR & 0x0F) == 0x08)
             {
-                timerBCounter--;
-                if (timerBCounter <= 0)
+                _timerCount[TimerB]--;
+                if (_timerCount[TimerB] <= 0)
                 {
-                    timerBCounter = Reload(TBDR);
+                    _timerCount[TimerB] = Reload(TBDR);
                     SetInterruptPending(RegA.TimerB, false);
                 }
             }
         }
 
-        public void UpdateTimers(int cpuCycles)
+        // -------------------- Timers --------------------
+
+        static long MfpTick(long cycle) => cycle * MFP_TICKS / CPU_CYCLES;
+
+        // First CPU cycle at or past an MFP tick
+        static long CpuCycle(long tick) => (tick * CPU_CYCLES + MFP_TICKS - 1) / MFP_TICKS;
+
+        int TimerMode(int t)
         {
-            mfpAcc += (long)cpuCycles * MFP_HZ;
-            int mfpTicks = (int)(mfpAcc / CPU_HZ);
-            mfpAcc %= CPU_HZ;
+            switch (t)
+            {
+                case TimerA: return TACR & 0x0F;
+                case TimerB: return TBCR & 0x0F;
+                case TimerC: return (TCDCR >> 4) & 0x07;
+                default: return TCDCR & 0x07;
+            }
+        }
 
-            if (mfpTicks <= 0)
-                return;
+        byte TimerData(int t)
+        {
+            switch (t)
+            {
+                case TimerA: return TADR;
+                case TimerB: return TBDR;
+                case TimerC: return TCDR;
+                default: return TDDR;
+            }
+        }
 
-            UpdateTimerA(mfpTicks);
-            UpdateTimerB(mfpTicks);
-            UpdateTimerC(mfpTicks);
-            UpdateTimerD(mfpTicks);
+        bool TimerInterruptEnabled(int t)
+        {
+            switch (t)
+            {
+                case TimerA: return (IERA & RegA.TimerA) != 0;
+                case TimerB: return (IERA & RegA.TimerB) != 0;
+                case TimerC: return (IERB & RegB.TimerC) != 0;
+                default: return (IERB & RegB.TimerD) != 0;
+            }
+        }
+
+        void TimerInterrupt(int t)
+        {
+            switch (t)
+            {
+                case TimerA: SetInterruptPending(RegA.TimerA, false); break;
+                case TimerB: SetInterruptPending(RegA.TimerB, false); break;
+                case TimerC: SetInterruptPending(RegB.TimerC, true); break;
+                default: SetInterruptPending(RegB.TimerD, true); break;
+            }
+        }
+
+        // Modes 1 to 7 count MFP ticks through the prescaler, 8 counts events and the rest are not emulated
+        bool TimerRunning(int t)
+        {
+            int mode = TimerMode(t);
+            return mode > 0 && mode < 8;
         }
 
-        void UpdateTimerA(int mfpTicks)
+        int TimerCounter(int t, long tick)
         {
-            int mode = TACR & 0x0F;
-            if (mode == 0 || mode > 7) return;
+            if (!TimerRunning(t))
+                return _timerCount[t];
 
-            int div = GetPrescaler(mode);
-            timerAPredivAcc += mfpTicks;
-            int dec = timerAPredivAcc / div;
-            timerAPredivAcc %= div;
+            // The counter goes down once per prescaler period and reloads from the data register when it reaches 0
+            long steps = (tick - _timerBase[t]) / GetPrescaler(TimerMode(t));
+            int count = _timerCount[t];
+            if (steps < count)
+                return count - (int)steps;
 
-            if (dec > 0)
+            int reload = Reload(TimerData(t));
+            return reload - (int)((steps - count) % reload);
+        }
+
+        // MFP tick of the first underflow after 'tick'
+        long NextUnderflow(int t, long tick)
+        {
+            int prescaler = GetPrescaler(TimerMode(t));
+            long steps = (tick - _timerBase[t]) / prescaler;
+            long count = _timerCount[t];
+
+            long step = count;
+            if (steps >= count)
             {
-                timerACounter -= dec;
-                while (timerACounter <= 0)
-                {
-                    timerACounter += Reload(TADR);
-                    SetInterruptPending(RegA.TimerA, false);
-                }
+                int reload = Reload(TimerData(t));
+                step = count + ((steps - count) / reload + 1) * reload;
             }
+            return _timerBase[t] + step * prescaler;
         }
 
-        void UpdateTimerB(int mfpTicks)
+        // Moves the base of a running timer to the last prescaler period before 'tick', before a register changes
+        void RebaseTimer(int t, long tick)
         {
-            int mode = TBCR & 0x0F;
-            if (mode == 0 || mode > 7) return;
+            if (!TimerRunning(t))
+                return;
 
-            int div = GetPrescaler(mode);
-            timerBPredivAcc += mfpTicks;
-            int dec = timerBPredivAcc / div;
-            timerBPredivAcc %= div;
+            int prescaler = GetPrescaler(TimerMode(t));
+            long steps = (tick - _timerBase[t]) / prescaler;
+            _timerCount[t] = TimerCounter(t, tick);
+            _timerBase[t] += steps * prescaler;
+        }
 
-            if (dec > 0)
+        /// <summary>
+        /// Raises the timer interrupts due by now whose event has not run yet. Called before any register the
+        /// timers depend on changes, then <see cref="ScheduleTimers"/> after it.
+        /// </summary>
+        public void SyncTimers()
+        {
+            long now = MfpTick(_cpu.Clock);
+            for (int t = 0; t < 4; t++)
             {
-                timerBCounter -= dec;
-                while (timerBCounter <= 0)
+                if (_timerDue[t] <= now)
                 {
-                    timerBCounter += Reload(TBDR);
-                    SetInterruptPending(RegA.TimerB, false);
+                    _timerDue[t] = long.MaxValue;
+                    TimerInterrupt(t);
                 }
             }
         }
 
-        void UpdateTimerC(int mfpTicks)
+        /// <summary>
+        /// Schedules the next underflow of the timers running with their interrupt enabled, the others need no event.
+        /// </summary>
+        public void ScheduleTimers()
         {
-            int mode = (TCDCR >> 4) & 0x07;
-            if (mode == 0) { timerCPredivAcc = 0; return; }
+            long now = MfpTick(_cpu.Clock);
+            long next = long.MaxValue;
 
-            int div = GetPrescaler(mode);
-            timerCPredivAcc += mfpTicks;
-            int dec = timerCPredivAcc / div;
-            timerCPredivAcc %= div;
+            for (int t = 0; t < 4; t++)
+            {
+                _timerDue[t] = TimerRunning(t) && TimerInterruptEnabled(t) ? NextUnderflow(t, now) : long.MaxValue;
+                next = Math.Min(next, _timerDue[t]);
+            }
 
-            if (dec > 0)
+            if (next == long.MaxValue)
+                _cpu.CancelEvent((int)CPU.EventId.MfpTimer);
+            else
+                _cpu.ScheduleEvent(CpuCycle(next), (int)CPU.EventId.MfpTimer);
+        }
+
+        /// <summary>
+        /// CPU.EventId.MfpTimer handler, a timer reached its underflow.
+        /// </summary>
+        public void OnTimerEvent(long cycle)
+        {
+            SyncTimers();
+            ScheduleTimers();
+        }
+
+        /// <summary>Reads the data register of timer <paramref name="t"/>, the counter as of now.</summary>
+        public byte ReadTimerData(int t) => (byte)TimerCounter(t, MfpTick(_cpu.Clock));
+
+        /// <summary>
+        /// Writes the data register of timer <paramref name="t"/>, which also loads its counter.
+        /// </summary>
+        public void WriteTimerData(int t, byte v)
+        {
+            long now = MfpTick(_cpu.Clock);
+
+            SyncTimers();
+            RebaseTimer(t, now);
+
+            switch (t)
             {
-                timerCCounter -= dec;
-                while (timerCCounter <= 0)
-                {
-                    timerCCounter += Reload(TCDR);
-                    SetInterruptPending(RegB.TimerC, true);
-                }
+                case TimerA: TADR = v; break;
+                case TimerB: TBDR = v; break;
+                case TimerC: TCDR = v; break;
+                default: TDDR = v; break;
             }
+            _timerCount[t] = Reload(v);
+
+            ScheduleTimers();
         }
 
-        void UpdateTimerD(int mfpTicks)
+        /// <summary>
+        /// Writes TACR, TBCR or TCDCR (<paramref name="register"/> is the offset in the MFP page). A change of mode
+        /// restarts the prescaler, a timer started loads its counter from the data register.
+        /// </summary>
+        public void WriteTimerControl(uint register, byte v)
         {
-            int mode = TCDCR & 0x07;
-            if (mode == 0) { timerDPredivAcc = 0; return; }
+            long now = MfpTick(_cpu.Clock);
 
-            int div = GetPrescaler(mode);
-            timerDPredivAcc += mfpTicks;
-            int dec = timerDPredivAcc / div;
-            timerDPredivAcc %= div;
+            SyncTimers();
 
-            if (dec > 0)
+            // Counters of the timers running so far are frozen at now, with the prescaler phase kept
+            Span<int> oldModes = stackalloc int[4];
+            for (int t = 0; t < 4; t++)
             {
-                timerDCounter -= dec;
-                while (timerDCounter <= 0)
-                {
-                    timerDCounter += Reload(TDDR);
-                    SetInterruptPending(RegB.TimerD, true);
-                }
+                oldModes[t] = TimerMode(t);
+                RebaseTimer(t, now);
+            }
+
+            switch (register)
+            {
+                case 0x19: TACR = v; break;
+                case 0x1B: TBCR = v; break;
+                default: TCDCR = v; break;
             }
+
+            for (int t = 0; t < 4; t++)
+            {
+                int mode = TimerMode(t);
+                if (mode == oldModes[t])
+                    continue;
+
+                // Timers C and D always load their counter when they start, A and B only if it ran out
+                _timerBase[t] = now;
+                if (oldModes[t] == 0 && (t >= TimerC || _timerCount[t] == 0))
+                    _timerCount[t] = Reload(TimerData(t));
+            }
+
+            ScheduleTimers();
         }
 
         private int GetPrescaler(int mode)
@@ -418,6 +572,8 @@ namespace ASE
                 if (bit == 4) SetInterruptPending(RegB.ACIA, true);
                 // Bit 5 = FDC (RegB Bit 7)
                 else if (bit == 5) SetInterruptPending(RegB.FDC, true);
+                // Bit 3 = Blitter done (RegB Bit 3)
+                else if (bit == 3) SetInterruptPending(RegB.Blitter, true);
 
                 // (Se podrían añadir el resto de bits si se emularan)
             }
@@ -0,0 +1,281 @@
+﻿/*
+ *
+ * One emulated Atari ST
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Collections.Concurrent;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// A whole Atari ST: CPU core, memory, MFP, YM2149, WD1772, ACIA/IKBD and the video counter, with the frame
+    /// loop that runs them.
+    /// </summary>
+    /// <remarks>Machines share no mutable state, so several can run at the same time as long as each one is only
+    /// run from a single thread. The TOS image is loaded once per process and mapped read-only in all of them (see
+    /// <see cref="Memory.LoadTos"/>). The machine shown in the window is <see cref="ASEMain.Machine"/>, the
+    /// parallel runs of <see cref="Headless"/> build their own.</remarks>
+    public sealed class Machine : IDisposable
+    {
+        // PAL frame timing
+        public const int ScanlinesPerFrame = 313;
+        public const int CyclesPerScanline = 512;
+
+        public readonly Memory Mem;
+        public readonly YM2149 Ym;
+        public readonly Moira Cpu;
+        public readonly MFP68901 Mfp;
+        public readonly ACIA Acia;
+        public readonly WD1772 Fdc;
+        public readonly FloppyImage DriveA;
+        public readonly FloppyImage DriveB;
+        public readonly Video.AtariStRenderer Renderer;
+
+        // Screen buffers handed to whoever shows or checks the frames, published at every VBL
+        public readonly FrameRing Frames;
+        readonly ulong[] _changedRows = new ulong[FrameRing.RowWords];
+
+        // Off in headless mode: frames are only rendered on request and audio is only synthesized when recorded
+        public bool RenderFrame = true;
+        public bool SynthesizeAudio = true;
+
+        internal uint VideoCounter;
+
+        /// <summary>Video and sound recording started with --capture, see <see cref="ASE.Capture.Attach"/>.</summary>
+        public Capture? Capture;
+
+        /// <summary>Called by the FDC when a command starts, null when there is no drive LED to show.</summary>
+        public Action<bool>? DriveLed;
+
+        public event Action? OnFrameComplete;
+
+        readonly Moira.Scanline _onScanline;
+        readonly PerfCounters? _counters;
+
+        // Work queued from other threads that needs the machine stopped between frames (save states, ...)
+        readonly ConcurrentQueue<Action> _frameActions = new ConcurrentQueue<Action>();
+
+        /// <summary>
+        /// Builds and resets a machine with the configuration in <see cref="ConfigOptions.RunninConfig"/>.
+        /// </summary>
+        /// <param name="driveA">Drive A, it stays with the caller and can move to the next machine on a reset.</param>
+        /// <param name="driveB">Drive B.</param>
+        /// <param name="frames">Where the frames go, a new ring if null.</param>
+        /// <returns>Null if the machine cannot be built (no TOS, ...), the reason is on the console.</returns>
+        public static Machine? Create(FloppyImage driveA, FloppyImage driveB, FrameRing? frames = null)
+        {
+            byte[]? rom = Memory.LoadTos(ConfigOptions.RunninConfig.TOSPath);
+            if (rom == null)
+                return null;
+
+            CPU.BindCore();
+
+            return new Machine(rom, driveA, driveB, frames ?? new FrameRing(ASEMain.ScreenViewSize));
+        }
+
+        Machine(byte[] rom, FloppyImage driveA, FloppyImage driveB, FrameRing frames)
+        {
+            var config = ConfigOptions.RunninConfig;
+
+            DriveA = driveA;
+            DriveB = driveB;
+            DriveA.Owner = this;
+            DriveB.Owner = this;
+            Frames = frames;
+            _onScanline = OnScanline;
+
+            Mem = new Memory(this, rom);
+            Ym = new YM2149(this, sampleRate: config.SampleRate, chipClockHz: 2000000.0);
+
+            Cpu = new Moira(
+                Mem.Read8,
+                Mem.Read16,
+                Mem.Write8,
+                Mem.Write16,
+                null,
+                IrqAck
+                );
+
+            Mem.MapToCpu(Cpu);
+            Renderer = new Video.AtariStRenderer(this) { Raster = config.RasterEffects };
+
+            if (config.TraceLength > 0)
+                Cpu.EnableTrace(config.TraceLength);
+
+            if (PerfCounters.Enabled)
+                _counters = new PerfCounters(Cpu);
+
+            if (!string.IsNullOrEmpty(config.ProfilePath))
+                Cpu.StartProfile(config.ProfileSample);
+
+            Mfp = new MFP68901(Cpu);
+            Acia = new ACIA(this);
+            Fdc = new WD1772(this);
+
+            Cpu.OnEvent((int)CPU.EventId.AciaRx, Acia.OnRxEvent);
+            Cpu.OnEvent((int)CPU.EventId.FdcCommand, Fdc.OnCommandEvent);
+            Cpu.OnEvent((int)CPU.EventId.BlitterDone, OnBlitterDone);
+            Cpu.OnEvent((int)CPU.EventId.MfpTimer, Mfp.OnTimerEvent);
+
+            Acia.Reset();
+            Fdc.Reset();
+            Ym.Reset();
+
+            Cpu.Reset();
+        }
+
+        public void Dispose()
+        {
+            // The drives go on to the next machine, or release their images at once
+            if (DriveA.Owner == this)
+                DriveA.Owner = null;
+            if (DriveB.Owner == this)
+                DriveB.Owner = null;
+
+            Acia.Recorder?.Dispose();
+            Capture?.Dispose();
+            Cpu.Dispose();
+        }
+
+        /// <summary>
+        /// Get interrupt vector based on level
+        /// </summary>
+        /// <param name="level">Interrupt level</param>
+        /// <returns></returns>
+        ushort IrqAck(byte level)
+        {
+            switch (level)
+            {
+                case 2: // HBL
+                    Mfp.irqController.ClearHBL();
+                    break;
+
+                case 4: // VBL
+                    Mfp.irqController.ClearVBL();
+                    break;
+
+                case 6: // MFP
+                    ushort vector = Mfp.GetInterruptVector();
+                    return vector;
+            }
+
+            return (ushort)(24 + level);
+        }
+
+        /// <summary>
+        /// CPU.EventId.BlitterDone handler: the blitter drops its interrupt line (GPIP 3) at the end of a blit.
+        /// </summary>
+        void OnBlitterDone(long cycle)
+        {
+            Mfp.SetGPIOBit(3, true);
+            Mfp.SetGPIOBit(3, false);
+        }
+
+        /// <summary>
+        /// Runs <paramref name="action"/> on the thread of this machine once the current frame is done.
+        /// </summary>
+        public void RunAtFrameEnd(Action action)
+        {
+            _frameActions.Enqueue(action);
+        }
+
+        /// <summary>
+        /// Emulates one PAL frame, up to and including the VBL, then runs the frame end work.
+        /// </summary>
+        public void RunFrame()
+        {
+            uint baseHigh = Mem.Read8(Memory.STPortAdress.ST_SCRHIGHADDR);
+            uint baseMid = Mem.Read8(Memory.STPortAdress.ST_SCRMIDADDR);
+            uint videoBase = (baseHigh << 16) | (baseMid << 8);  // low byte 0 en ST
+            VideoCounter = videoBase;
+
+            Mem.Write8(Memory.STPortAdress.ST_HIVADRPOINT, (byte)baseHigh);
+            Mem.Write8(Memory.STPortAdress.ST_MIVADRPOINT, (byte)baseMid);
+            Mem.Write8(Memory.STPortAdress.ST_LOVADRPOINT, (byte)0);
+
+            // The whole frame runs in a single native call, OnScanline does the per line work
+            Renderer.BeginFrame(Cpu.Clock);
+            Cpu.RunScanlines(ScanlinesPerFrame, CyclesPerScanline, 0, _onScanline);
+
+            // Vsync completed
+            Mfp.irqController.RaiseVBL();
+
+            // The sound of the whole frame in one block, register writes land at the cycle they were made
+            if (SynthesizeAudio)
+                Ym.Render(Cpu.Clock);
+            else
+                Ym.Skip(Cpu.Clock);
+
+            if (RenderFrame)
+            {
+                Renderer.TakeChangedRows(_changedRows);
+                Frames.Publish(_changedRows);
+            }
+
+            _counters?.OnFrame();
+
+            // Screenshot, recording, etc. (see Capture)
+            OnFrameComplete?.Invoke();
+
+            while (_frameActions.TryDequeue(out var action))
+                action();
+        }
+
+        /*
+         * The PAL Color Atari ST has 313 full scanlines per vertical synchronization (vsync),
+         * of which 200 are visible lines and 112 belong to the top and bottom borders.
+         * In monochrome mode, there would be 400 visible and 100 non-visible lines,
+         * but in this emulator we will only support color mode.
+         *
+         * Each scanline lasts 512 CPU cycles at 8 MHz = 15.66 kHz, or 64 microseconds.
+         *
+         * This is how screen synchronization is handled in this emulator. It is not the most accurate method,
+         * but it is sufficient for the vast majority of ST games and programs. I ported this loop directly
+         * from the MS-DOS version of ASE, and it would need to be rewritten in order to also synchronize what
+         * happens in the screen borders in some demos and games.
+         *
+         *              448 cycles active display + 64 cycles H-Blank (right border)
+         *              -------------------+++
+         *              ********************** <- Top border (not rendered)
+         *              **********************
+         *              ***                *** <- Active display starts here (scanline 63)
+         *              ***                ***
+         *              ***                ***
+         *              ***                ***
+         *              ***                *** <- Active display ends here (scanline 262)
+         *              **********************
+         *              ********************** <- Bottom border (not rendered), Vsync
+         */
+        bool OnScanline(int scanline, Moira.LinePhase phase)
+        {
+            // H-Blank (right border) done. The MFP timers in delay mode run on their own event, see MFP68901
+            Mfp.irqController.RaiseHBL();
+
+            // Sync ACIA
+            Acia.Sync();
+
+            if (scanline > 62 && scanline < 263)
+            {
+                Mem.Write8(Memory.STPortAdress.ST_HIVADRPOINT, (byte)(VideoCounter >> 16));
+                Mem.Write8(Memory.STPortAdress.ST_MIVADRPOINT, (byte)(VideoCounter >> 8));
+                Mem.Write8(Memory.STPortAdress.ST_LOVADRPOINT, (byte)(VideoCounter));
+
+                // Render scanline
+                if (RenderFrame)
+                    Renderer.RenderLine(Frames.BackIndex, Frames.Back, VideoCounter, scanline - 63);
+
+                // Next line: +160 bytes
+                VideoCounter = (VideoCounter + 160u) & 0xFFFFFFu;
+
+                Mfp.TickTimerA_EventCount();
+                Mfp.TickTimerB_EventCount();   // Timer B updates on every scanline
+            }
+
+            return true;
+        }
+    }
+}
@@ -81,10 +81,11 @@ namespace ASE
             var p = e.GetCurrentPoint(ctrl);
 
             // Transmit the button press to the ACIA mouse handling
-            if (p.Properties.IsLeftButtonPressed && ASEMain.IsMouseCaptured)
+            ACIA? acia = ASEMain.Machine?.Acia;
+
+            if (p.Properties.IsLeftButtonPressed && ASEMain.IsMouseCaptured && acia != null)
             {
-                ACIA._mouseButtons |= 0x02;
-                ACIA.SendMousePacket(0, 0);
+                acia.SetMouseButton(0x02, true);
                 e.Handled = true;
             }
         }
@@ -96,10 +97,11 @@ namespace ASE
             // I’m sure there are better ways to do this, but for now it does what
             // I need it to do and that’s enough for me.
 
-            if (e.InitialPressMouseButton == MouseButton.Left && ASEMain.IsMouseCaptured)
+            ACIA? acia = ASEMain.Machine?.Acia;
+
+            if (e.InitialPressMouseButton == MouseButton.Left && ASEMain.IsMouseCaptured && acia != null)
             {
-                ACIA._mouseButtons &= ~0x02;
-                ACIA.SendMousePacket(0, 0);
+                acia.SetMouseButton(0x02, false);
                 e.Handled = true;
             }
         }
@@ -242,7 +244,25 @@ namespace ASE
             var response = TinyDialogs.MessageBox("Reset ST", "Are you sure?", MessageBoxDialogType.YesNo, MessageBoxIconType.Question, MessageBoxButton.Yes);
 
             if (response == MessageBoxButton.Yes)
-                CPU.InitCpu();
+                ASEMain.HardReset();
+        }
+
+        public void OnQuickSaveClick(object sender, RoutedEventArgs e)
+        {
+            ASEMain.RunAtFrameEnd(machine =>
+            {
+                SaveState.SaveToFile(machine, SaveState.QuickSavePath);
+                Dispatcher.UIThread.InvokeAsync(() => SetStatusBarText("State saved"));
+            });
+        }
+
+        public void OnQuickLoadClick(object sender, RoutedEventArgs e)
+        {
+            ASEMain.RunAtFrameEnd(machine =>
+            {
+                bool loaded = SaveState.LoadFromFile(machine, SaveState.QuickSavePath);
+                Dispatcher.UIThread.InvokeAsync(() => SetStatusBarText(loaded ? "State loaded" : "No valid quick save state"));
+            });
         }
 
         public void OnConfigurationClick(object sender, RoutedEventArgs e)
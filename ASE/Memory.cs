@@ -55,37 +55,72 @@ namespace ASE
         public byte[] ROM;
         public byte[] Ports; // I/O adresses, starting at 0xFF8000 (PortsBase)
 
-        public Memory()
+        // Bumped on every write to the palette registers, the renderer keeps the converted palette until it changes
+        public uint PaletteVersion;
+
+        // Core whose write map tracks the RAM written from here, see MapToCpu
+        Moira? _cpu;
+
+        // Devices behind the I/O pages
+        readonly Machine _machine;
+
+        // TOS images by full path. The ROM is never written, every machine of the process maps the same buffer.
+        static readonly Dictionary<string, byte[]> _tosImages = new Dictionary<string, byte[]>();
+
+        /// <summary>
+        /// Loads a TOS image, or returns the one already loaded from the same file.
+        /// </summary>
+        /// <returns>Null if the file is missing or its size is not a known TOS size.</returns>
+        public static byte[]? LoadTos(string path)
         {
-            if (File.Exists(ConfigOptions.RunninConfig.TOSPath))
-            {
-                ROM = File.ReadAllBytes(ConfigOptions.RunninConfig.TOSPath);
-                ColoredConsole.WriteLine($"TOS loaded from [[green]]{ConfigOptions.RunninConfig.TOSPath}[[/green]], size: [[yellow]]{ROM.Length}[[/yellow]] bytes.");
-            }
-            else
+            string key = Path.GetFullPath(path);
+
+            lock (_tosImages)
             {
-                string ErrorMessage = $"TOS file [[red]]{ConfigOptions.RunninConfig.TOSPath}[[/red]] not found.";
-                ColoredConsole.WriteLine(ErrorMessage);
-                ASEMain.Shutdown();
-                return;
+                if (_tosImages.TryGetValue(key, out byte[]? cached))
+                    return cached;
+
+                if (!File.Exists(path))
+                {
+                    ColoredConsole.WriteLine($"TOS file [[red]]{path}[[/red]] not found.");
+                    return null;
+                }
+
+                byte[] image = File.ReadAllBytes(path);
+
+                if (image.Length != 192 * 1024 && image.Length != 256 * 1024)
+                {
+                    ColoredConsole.WriteLine($"Error: TOS size [[yellow]]{image.Length}[[/yellow]] bytes is unknow.");
+                    return null;
+                }
+
+                // RAM and ROM live on the pinned heap so Moira can access them natively (see MapToCpu)
+                byte[] rom = GC.AllocateArray<byte>(image.Length, pinned: true);
+                image.CopyTo(rom, 0);
+                ColoredConsole.WriteLine($"TOS loaded from [[green]]{path}[[/green]], size: [[yellow]]{rom.Length}[[/yellow]] bytes.");
+
+                _tosImages[key] = rom;
+                return rom;
             }
+        }
+
+        /// <param name="machine">Machine whose devices are reached through the I/O pages.</param>
+        /// <param name="rom">TOS image from <see cref="LoadTos"/>.</param>
+        public Memory(Machine machine, byte[] rom)
+        {
+            _machine = machine;
+            ROM = rom;
 
             if (ROM.Length == 192 * 1024)
             { 
                 TosSize = 192 * 1024;
                 TosBase = 0xFC0000;
             }
-            else if (ROM.Length == 256 * 1024)
+            else
             {
                 TosSize = 256 * 1024;
                 TosBase = 0xE00000;
             }
-            else
-            {
-                ColoredConsole.WriteLine($"Error: TOS size [[]]{ROM.Length}[[/yellow]] bytes is unknow.");
-                ASEMain.Shutdown();
-                return;
-            }
 
             Ports = new byte[(0xffffff - 0xff8000) + 1];
 
@@ -101,22 +136,22 @@ namespace ASE
                 case ConfigOptions.RAMConfigurations.RAM_512KB:
                     MMUConfig = 4; // 01 00 -> 512KB
                     RamSize = 512 * 1024;
-                    RAM = new byte[RamSize];
+                    RAM = GC.AllocateArray<byte>(RamSize, pinned: true);
                     break;
                 case ConfigOptions.RAMConfigurations.RAM_1MB:
                     MMUConfig = 5; // 01 01 -> 1MB
                     RamSize = 1024 * 1024;
-                    RAM = new byte[RamSize];
+                    RAM = GC.AllocateArray<byte>(RamSize, pinned: true);
                     break;
                 case ConfigOptions.RAMConfigurations.RAM_2MB:
                     MMUConfig = 8; // 10 00 -> 2MB
                     RamSize = 2048 * 1024;
-                    RAM = new byte[RamSize];
+                    RAM = GC.AllocateArray<byte>(RamSize, pinned: true);
                     break;
                 case ConfigOptions.RAMConfigurations.RAM_4MB:
                     MMUConfig = 10; // 10 10 -> 4MB
                     RamSize = 4096 * 1024;
-                    RAM = new byte[RamSize];
+                    RAM = GC.AllocateArray<byte>(RamSize, pinned: true);
                     break;
             }
 
@@ -125,6 +160,101 @@ namespace ASE
             Ports[0x20a] = 2;
         }
 
+        /// <summary>
+        /// Writes RAM and the I/O port shadow to a save state.
+        /// </summary>
+        public void SaveState(BinaryWriter w)
+        {
+            w.Write(RamSize);
+            w.Write(RAM, 0, RamSize);
+            w.Write(Ports.Length);
+            w.Write(Ports);
+        }
+
+        /// <summary>
+        /// Restores RAM and the I/O port shadow in place, so the buffers mapped in the CPU stay valid.
+        /// </summary>
+        /// <returns>False if the state was saved with another RAM configuration.</returns>
+        public bool LoadState(BinaryReader r)
+        {
+            if (r.ReadInt32() != RamSize)
+                return false;
+            r.BaseStream.ReadExactly(RAM, 0, RamSize);
+
+            if (r.ReadInt32() != Ports.Length)
+                return false;
+            r.BaseStream.ReadExactly(Ports, 0, Ports.Length);
+
+            return true;
+        }
+
+        /// <summary>
+        /// Builds Moira's native page map: RAM and ROM are serviced in native code, the I/O pages that hold a
+        /// single device get their own handlers, and missing hardware raises a bus error without leaving native
+        /// code. Anything else still reaches the generic Read/Write delegates below.
+        /// </summary>
+        /// <remarks>Page 0 stays on the delegates since it holds the ROM vector mirror at $0-$7, and writes to
+        /// ROM are passed to Write8/Write16 so the warning is still reported.</remarks>
+        /// <param name="cpu">The CPU instance that will access this memory.</param>
+        public void MapToCpu(Moira cpu)
+        {
+            const uint Page = Moira.PageSize;
+
+            _cpu = cpu;
+
+            cpu.MapRegion(Page, RAM, (int)Page, RamSize - (int)Page, Moira.MapFlags.ReadWrite);
+            cpu.MapRegion(TosBase, ROM, 0, TosSize, Moira.MapFlags.Read);
+
+            cpu.MapDevice(0xFF8600, Page, ReadFdcPage8, ReadFdcPage16, WriteFdcPage8, WriteFdcPage16);
+            cpu.MapDevice(0xFF8800, Page, ReadPsgPage8, ReadPsgPage16, WritePsgPage8, WritePsgPage16);
+            cpu.MapDevice(MFP68901.MFP_BASE, Page, ReadMfp, ReadMfpPage16, WriteMfp, WriteMfpPage16);
+            cpu.MapDevice(0xFFFC00, Page, ReadAciaPage8, ReadAciaPage16, WriteAciaPage8, WriteAciaPage16);
+
+            // Blitter and STe only registers, see comment at Read8
+            if (ConfigOptions.RunninConfig.Blitter)
+                cpu.MapBlitter(0xFF8A00, (int)CPU.EventId.BlitterDone);
+            else
+                cpu.MapBusError(0xFF8A00, Page);
+            cpu.MapBusError(0xFF8900, Page, Moira.MapFlags.Read);
+            cpu.MapBusError(0xFF9200, Page, Moira.MapFlags.Read);
+        }
+
+        /// <summary>
+        /// DMA transfer into memory. A block that lies in RAM is a single copy into the pinned buffer, marked in
+        /// the CPU write map, anything else goes byte by byte through <see cref="Write8"/>.
+        /// </summary>
+        public void DmaWrite(uint addr, ReadOnlySpan<byte> data)
+        {
+            addr &= 0xFFFFFFu;
+
+            if (addr + (uint)data.Length <= (uint)RamSize)
+            {
+                data.CopyTo(RAM.AsSpan((int)addr));
+                _cpu?.MarkWritten(addr, data.Length);
+                return;
+            }
+
+            for (int i = 0; i < data.Length; i++)
+                Write8(addr + (uint)i, data[i]);
+        }
+
+        /// <summary>
+        /// DMA transfer out of memory, a single copy when the block lies in RAM past the ROM shadow of address 0.
+        /// </summary>
+        public void DmaRead(uint addr, Span<byte> data)
+        {
+            addr &= 0xFFFFFFu;
+
+            if (addr >= 8 && addr + (uint)data.Length <= (uint)RamSize)
+            {
+                RAM.AsSpan((int)addr, data.Length).CopyTo(data);
+                return;
+            }
+
+            for (int i = 0; i < data.Length; i++)
+                data[i] = Read8(addr + (uint)i);
+        }
+
         /// <summary>
         /// Reads a byte from the specified memory address, supporting access to RAM, ROM, and various I/O ports.
         /// </summary>
@@ -162,74 +292,45 @@ namespace ASE
                     if (ConfigOptions.RunninConfig.DebugMode)
                         ColoredConsole.WriteLine("Trying to read STe not implemented registers.. ignored!");
 
-                    CPU._moira.TriggerBusError(addr, false);
+                    _machine.Cpu.TriggerBusError(addr, false);
                     return 0xFF;
                 }
 
                 // YM2149
                 if (addr == STPortAdress.ST_PSGREADSELECT)
-                    return ASEMain._ym.PSGRegisterData();
+                    return _machine.Ym.PSGRegisterData();
                 if (addr == STPortAdress.ST_PSGWRITEDATA)
                     return 0xFF;
                 
                 // FDC
                 if (addr >= 0xFF8604 && addr <= 0xFF860D)
-                    return WD1772.ReadByte(addr);
+                    return _machine.Fdc.ReadByte(addr);
 
                  // Blitter:
                  // TOS tries to detect the blitter by writing to its registers and expecting a bus error if it is not present.
+                 // With --blitter the page is serviced by the native blitter (see MapToCpu) and the CPU never gets here.
                 if (addr >= 0xFF8A00 && addr <= 0xFF8A3C)
                 {
                     if (ConfigOptions.RunninConfig.DebugMode)
                         ColoredConsole.WriteLine($"Trying to read a byte from blitter at [[red]]${addr:X8}[[/red]], but it's not emulated yet.");
 
-                    CPU._moira.TriggerBusError(addr, false);
+                    _machine.Cpu.TriggerBusError(addr, false);
                     return 0xFF;
                 }
 
                 // ACIA - Keyboard and Joystick ports
                 if (addr == STPortAdress.ST_ACIACMD)
-                    return ACIA.ReadStatus();
+                    return _machine.Acia.ReadStatus();
 
                 if (addr == STPortAdress.ST_ACIADATA)
-                    return ACIA.ReadData();
+                    return _machine.Acia.ReadData();
 
                 // Any other port below MFP registers
                 if (addr < MFP68901.MFP_BASE)
                     return Ports[addr - PortsBase];
 
                 // treatment for MFP registers
-                if (addr >= MFP68901.MFP_BASE && addr <= MFP68901.MFP_BASE + 0x26)
-                {
-                    uint offset = addr - MFP68901.MFP_BASE;
-
-                    switch (offset)
-                    {
-                        case 0x01: return ASEMain._mfp.GPIP;
-                        case 0x03: return ASEMain._mfp.AER;
-                        case 0x05: return ASEMain._mfp.DDR;
-                        case 0x07: return ASEMain._mfp.IERA;
-                        case 0x09: return ASEMain._mfp.IERB;
-                        case 0x0B: return ASEMain._mfp.IPRA;
-                        case 0x0D: return ASEMain._mfp.IPRB;
-                        case 0x0F: return ASEMain._mfp.ISRA;
-                        case 0x11: return ASEMain._mfp.ISRB;
-                        case 0x13: return ASEMain._mfp.IMRA;
-                        case 0x15: return ASEMain._mfp.IMRB;
-                        case 0x17: return ASEMain._mfp.VR;
-                        case 0x19: return ASEMain._mfp.TACR;
-                        case 0x1B: return ASEMain._mfp.TBCR;
-                        case 0x1D: return ASEMain._mfp.TCDCR;
-                        case 0x1F: return (byte)ASEMain._mfp.timerACounter;
-                        case 0x21: return (byte)ASEMain._mfp.timerBCounter;
-                        case 0x23: return (byte)ASEMain._mfp.timerCCounter;
-                        case 0x25: return (byte)ASEMain._mfp.timerDCounter;
-                        default:
-                            // this should throw a bus error
-                            return Ports[addr - PortsBase];
-                    }
-                }
-
+                return ReadMfp(addr);
             }
 
             return 0xFF;
@@ -250,18 +351,18 @@ namespace ASE
 
             // RAM
             if (addr + 1 < RamSize)
-                return BigEndian.Read16(addr);
+                return BigEndian.Read16(this, addr);
 
             // ROM
             if (addr >= TosBase && addr + 1 < TosBase + TosSize)
-                return BigEndian.Read16(addr);
+                return BigEndian.Read16(this, addr);
 
             // I/O
             if (addr >= PortsBase)
             {
                 // FDC
                 if (addr >= 0xFF8604 && addr <= 0xFF860D)
-                    return WD1772.ReadWord(addr);
+                    return _machine.Fdc.ReadWord(addr);
 
                 // See comment at Read8 about blitter emulation
                 if (addr >= 0xFF8A00 && addr <= 0xFF8A3C)
@@ -269,12 +370,12 @@ namespace ASE
                     if (ConfigOptions.RunninConfig.DebugMode)
                         ColoredConsole.WriteLine($"Trying to read a word from blitter at [[red]]${addr:X8}[[/red]], but it's not emulated yet.");
 
-                    CPU._moira.TriggerBusError(addr, false);
+                    _machine.Cpu.TriggerBusError(addr, false);
                     return 0xFFFF; // dummy return
                 }
 
                 // Any other I/O port is read without special treatment.
-                return BigEndian.Read16(addr);
+                return BigEndian.Read16(this, addr);
             }
 
             // out of the bounds of the RAM, ROM or I/O ports, returns waste
@@ -296,16 +397,16 @@ namespace ASE
 
             // RAM
             if (addr + 3 < RamSize)
-                return BigEndian.Read32(addr);
+                return BigEndian.Read32(this, addr);
 
             // ROM
             if (addr >= TosBase && addr + 3 < TosBase + TosSize)
-                return BigEndian.Read32(addr);
+                return BigEndian.Read32(this, addr);
 
             // I/O
             if (addr >= PortsBase)
             {
-                return BigEndian.Read32(addr);
+                return BigEndian.Read32(this, addr);
             }
 
             return 0xFFFFFFFF;
@@ -322,7 +423,14 @@ namespace ASE
         /// <param name="addr">The 24-bit memory address to which the value will be written. Must be within the valid range for RAM, ROM,
         /// or device-mapped addresses. 32 bit addresses will be trimmed to 24 bits addresses.</param>
         /// <param name="v">The 8-bit value to write to the specified address.</param>
-        public void Write8(uint addr, byte v)
+        public void Write8(uint addr, byte v) => Write8(addr, v, true);
+
+        /// <summary>
+        /// Byte write of <see cref="Write8(uint, byte)"/>, also used by the word and long port writes.
+        /// </summary>
+        /// <param name="syncShifter">False when the word or long write being split already brought the line on
+        /// screen up to the beam (see <see cref="BeforeShifterWrite(uint, uint)"/>).</param>
+        private void Write8(uint addr, byte v, bool syncShifter)
         {
             addr &= 0xFFFFFFu;  // 24 bits addressing
 
@@ -330,6 +438,7 @@ namespace ASE
             if (addr < RamSize)
             {
                 RAM[addr] = v;
+                _cpu?.MarkWritten(addr);
                 return;
             }
 
@@ -344,19 +453,19 @@ namespace ASE
                 // Chip de sonido YM2149
                 if (addr == STPortAdress.ST_PSGREADSELECT)
                 {
-                    ASEMain._ym.PSGRegisterSelect(v);
+                    _machine.Ym.PSGRegisterSelect(v);
                     return;
                 }
                 if (addr == STPortAdress.ST_PSGWRITEDATA)
                 {
-                    ASEMain._ym.PSGWriteRegister(v);
+                    _machine.Ym.PSGWriteRegister(v);
                     return;
                 }
 
                 // FDC
                 if (addr >= 0xFF8604 && addr <= 0xFF860D)
                 {
-                    WD1772.WriteByte(addr, v);
+                    _machine.Fdc.WriteByte(addr, v);
                     Ports[addr - PortsBase] = v;
                     return;
                 }
@@ -364,152 +473,32 @@ namespace ASE
                 // ACIA
                 if (addr == STPortAdress.ST_ACIACMD)
                 {
-                    ACIA.WriteControl(v);
+                    _machine.Acia.WriteControl(v);
                     return;
                 }
                 
                 if (addr == STPortAdress.ST_ACIADATA)
                 {
-                    ACIA.HandleCommand(v);
+                    _machine.Acia.HandleCommand(v);
                     return;
                 }
 
+                // Palette and resolution: in raster mode the line on screen is converted up to the beam first
+                if (syncShifter && addr >= STPortAdress.ST_PALLETE && addr <= STPortAdress.ST_RES)
+                    _machine.Renderer?.BeforeShifterWrite();
+
+                if (addr >= STPortAdress.ST_PALLETE && addr < STPortAdress.ST_PALLETE + 32)
+                    PaletteVersion++;
+
                 // See comment at Read8 about blitter emulation
                 if (addr >= 0xFF8A00 && addr <= 0xFF8A3C)
                 {
                     ColoredConsole.WriteLine($"Trying to write a byte to blitter at [[red]]${addr:X8}[[/red]], but it's not emulated yet.");
-                    CPU._moira.TriggerBusError(addr, true);
+                    _machine.Cpu.TriggerBusError(addr, true);
                     return;
                 }
 
-                uint offset = addr - MFP68901.MFP_BASE;
-
-                // This is a complete mess.. fixme later
-                switch (offset)
-                {
-                    case 0x03: ASEMain._mfp.AER = v; break;
-                    case 0x05: ASEMain._mfp.DDR = v; break;
-                    case 0x07: // IERA
-                        ASEMain._mfp.IERA = v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x09: // IERB
-                        ASEMain._mfp.IERB = v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x0B: // IPRA
-                        ASEMain._mfp.IPRA &= (byte)~v; // Escribir 1 limpia el bit
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x0D: // IPRB
-                        ASEMain._mfp.IPRB &= (byte)~v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x0F: // ISRA: escribir 0 limpia
-                        ASEMain._mfp.ISRA &= v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x11: // ISRB: escribir 0 limpia
-                        ASEMain._mfp.ISRB &= v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x13: // IMRA
-                        ASEMain._mfp.IMRA = v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x15: // IMRB
-                        ASEMain._mfp.IMRB = v;
-                        ASEMain._mfp.UpdateIRQ();
-                        break;
-
-                    case 0x17: // VR
-                        ASEMain._mfp.VR = (byte)(v & 0xF8);
-                        if ((ASEMain._mfp.VR & 0x08) == 0)
-                        {
-                            ASEMain._mfp.ISRA = 0;
-                            ASEMain._mfp.ISRB = 0;
-                        }
-                        break;
-
-                    case 0x19: // TACR
-                        {
-                            byte old = ASEMain._mfp.TACR;
-                            int oldMode = old & 0x0F;
-
-                            ASEMain._mfp.TACR = v;
-                            int newMode = v & 0x0F;
-
-                            // Si cambia modo/prescaler, resetea fase del prescaler
-                            if (oldMode != newMode)
-                                ASEMain._mfp.timerAPredivAcc = 0;
-
-                            // Si estaba apagado y lo encienden (delay 1..7 o event count 8)
-                            bool wasOff = (oldMode == 0);
-                            bool isOn = (newMode != 0);
-                            if (wasOff && isOn && ASEMain._mfp.timerACounter == 0)
-                                ASEMain._mfp.timerACounter = (ASEMain._mfp.TADR == 0 ? 256 : ASEMain._mfp.TADR);
-
-                            break;
-                        }
-
-                    case 0x1B:
-                        { // TBCR
-                            bool wasOff = (ASEMain._mfp.TBCR & 0x07) == 0;
-                            ASEMain._mfp.TBCR = v;
-                            if (wasOff && (v & 0x07) != 0 && ASEMain._mfp.timerBCounter == 0)
-                                ASEMain._mfp.timerBCounter = (ASEMain._mfp.TBDR == 0 ? 256 : ASEMain._mfp.TBDR);
-                            break;
-                        }
-
-                    case 0x1D: // TCDCR
-                        {
-                            byte old = ASEMain._mfp.TCDCR;
-                            ASEMain._mfp.TCDCR = v;
-
-                            // Timer C: bits 4..6
-                            bool cWasOff = (((old >> 4) & 0x07) == 0);
-                            bool cIsOn = (((v >> 4) & 0x07) != 0);
-                            if (cWasOff && cIsOn)
-                                ASEMain._mfp.timerCCounter = (ASEMain._mfp.TCDR == 0) ? 256 : ASEMain._mfp.TCDR;
-
-                            // Timer D: bits 0..2
-                            bool dWasOff = ((old & 0x07) == 0);
-                            bool dIsOn = ((v & 0x07) != 0);
-                            if (dWasOff && dIsOn)
-                                ASEMain._mfp.timerDCounter = (ASEMain._mfp.TDDR == 0) ? 256 : ASEMain._mfp.TDDR;
-
-                            break;
-                        }
-
-                    case 0x1F: // TADR
-                        ASEMain._mfp.TADR = v;
-                        ASEMain._mfp.timerACounter = (v == 0 ? 256 : v);
-                        break;
-
-                    case 0x21: // TBDR
-                        ASEMain._mfp.TBDR = v;
-                        ASEMain._mfp.timerBCounter = (v == 0 ? 256 : v);
-                        break;
-
-                    case 0x23: // TCDR
-                        ASEMain._mfp.TCDR = v;
-                        ASEMain._mfp.timerCCounter = (v == 0 ? 256 : v);
-                        break;
-
-                    case 0x25: // TDDR
-                        ASEMain._mfp.TDDR = v;
-                        ASEMain._mfp.timerDCounter = (v == 0 ? 256 : v);
-                        break;
-                }
-
-                Ports[addr - PortsBase] = v;
+                WriteMfp(addr, v);
             }
         }
 
@@ -527,7 +516,7 @@ namespace ASE
 
             if (addr + 1 < RamSize)
             {
-                BigEndian.Write16(addr, v);
+                BigEndian.Write16(this, addr, v);
                 return;
             }
 
@@ -542,11 +531,13 @@ namespace ASE
                 // FDC
                 if (addr >= 0xFF8604 && addr <= 0xFF860D)
                 {
-                    WD1772.WriteWord(addr, v);
+                    _machine.Fdc.WriteWord(addr, v);
                     return;
                 }
 
-                BigEndian.Write16(addr, v);
+                BeforeShifterWrite(addr, 2);
+                Write8(addr, (byte)(v >> 8), false);
+                Write8(addr + 1, (byte)v, false);
                 return;
             }
         }
@@ -564,7 +555,7 @@ namespace ASE
 
             if (addr + 3 < RamSize)
             {
-                BigEndian.Write32(addr, v);
+                BigEndian.Write32(this, addr, v);
                 return;
             }
 
@@ -576,9 +567,274 @@ namespace ASE
 
             if (addr >= PortsBase)
             {
-                BigEndian.Write32(addr, v);
+                BeforeShifterWrite(addr, 4);
+                Write8(addr, (byte)(v >> 24), false);
+                Write8(addr + 1, (byte)(v >> 16), false);
+                Write8(addr + 2, (byte)(v >> 8), false);
+                Write8(addr + 3, (byte)v, false);
+                return;
+            }
+        }
+
+        /// <summary>
+        /// Brings the line on screen up to the beam once for a port write of <paramref name="size"/> bytes that
+        /// touches the palette or the resolution, before it is split in byte writes.
+        /// </summary>
+        private void BeforeShifterWrite(uint addr, uint size)
+        {
+            if (addr <= STPortAdress.ST_RES && addr + size - 1 >= STPortAdress.ST_PALLETE)
+                _machine.Renderer?.BeforeShifterWrite();
+        }
+
+        /// <summary>
+        /// Reads a byte from the MFP 68901 registers at $FFFA00-$FFFA26.
+        /// </summary>
+        /// <param name="addr">24 bit address inside the MFP page.</param>
+        /// <returns>The register value, 0xFF above the last MFP register.</returns>
+        private byte ReadMfp(uint addr)
+        {
+            if (addr >= MFP68901.MFP_BASE && addr <= MFP68901.MFP_BASE + 0x26)
+            {
+                uint offset = addr - MFP68901.MFP_BASE;
+
+                switch (offset)
+                {
+                    case 0x01: return _machine.Mfp.GPIP;
+                    case 0x03: return _machine.Mfp.AER;
+                    case 0x05: return _machine.Mfp.DDR;
+                    case 0x07: return _machine.Mfp.IERA;
+                    case 0x09: return _machine.Mfp.IERB;
+                    case 0x0B: return _machine.Mfp.IPRA;
+                    case 0x0D: return _machine.Mfp.IPRB;
+                    case 0x0F: return _machine.Mfp.ISRA;
+                    case 0x11: return _machine.Mfp.ISRB;
+                    case 0x13: return _machine.Mfp.IMRA;
+                    case 0x15: return _machine.Mfp.IMRB;
+                    case 0x17: return _machine.Mfp.VR;
+                    case 0x19: return _machine.Mfp.TACR;
+                    case 0x1B: return _machine.Mfp.TBCR;
+                    case 0x1D: return _machine.Mfp.TCDCR;
+                    case 0x1F: return _machine.Mfp.ReadTimerData(MFP68901.TimerA);
+                    case 0x21: return _machine.Mfp.ReadTimerData(MFP68901.TimerB);
+                    case 0x23: return _machine.Mfp.ReadTimerData(MFP68901.TimerC);
+                    case 0x25: return _machine.Mfp.ReadTimerData(MFP68901.TimerD);
+                    default:
+                        // this should throw a bus error
+                        return Ports[addr - PortsBase];
+                }
+            }
+
+            return 0xFF;
+        }
+
+        /// <summary>
+        /// Writes a byte to the MFP 68901 registers. The value is also stored in Ports, which is where any
+        /// other I/O address without special treatment ends up too.
+        /// </summary>
+        /// <param name="addr">24 bit I/O address.</param>
+        /// <param name="v">The 8-bit value to write.</param>
+        private void WriteMfp(uint addr, byte v)
+        {
+            uint offset = addr - MFP68901.MFP_BASE;
+
+            // This is a complete mess.. fixme later
+            switch (offset)
+            {
+                case 0x03: _machine.Mfp.AER = v; break;
+                case 0x05: _machine.Mfp.DDR = v; break;
+                case 0x07: // IERA
+                    _machine.Mfp.SyncTimers();
+                    _machine.Mfp.IERA = v;
+                    _machine.Mfp.UpdateIRQ();
+                    _machine.Mfp.ScheduleTimers();
+                    break;
+
+                case 0x09: // IERB
+                    _machine.Mfp.SyncTimers();
+                    _machine.Mfp.IERB = v;
+                    _machine.Mfp.UpdateIRQ();
+                    _machine.Mfp.ScheduleTimers();
+                    break;
+
+                case 0x0B: // IPRA
+                    _machine.Mfp.IPRA &= (byte)~v; // Escribir 1 limpia el bit
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x0D: // IPRB
+                    _machine.Mfp.IPRB &= (byte)~v;
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x0F: // ISRA: escribir 0 limpia
+                    _machine.Mfp.ISRA &= v;
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x11: // ISRB: escribir 0 limpia
+                    _machine.Mfp.ISRB &= v;
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x13: // IMRA
+                    _machine.Mfp.IMRA = v;
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x15: // IMRB
+                    _machine.Mfp.IMRB = v;
+                    _machine.Mfp.UpdateIRQ();
+                    break;
+
+                case 0x17: // VR
+                    _machine.Mfp.VR = (byte)(v & 0xF8);
+                    if ((_machine.Mfp.VR & 0x08) == 0)
+                    {
+                        _machine.Mfp.ISRA = 0;
+                        _machine.Mfp.ISRB = 0;
+                    }
+                    break;
+
+                case 0x19: // TACR
+                case 0x1B: // TBCR
+                case 0x1D: // TCDCR
+                    _machine.Mfp.WriteTimerControl(offset, v);
+                    break;
+
+                case 0x1F: // TADR
+                    _machine.Mfp.WriteTimerData(MFP68901.TimerA, v);
+                    break;
+
+                case 0x21: // TBDR
+                    _machine.Mfp.WriteTimerData(MFP68901.TimerB, v);
+                    break;
+
+                case 0x23: // TCDR
+                    _machine.Mfp.WriteTimerData(MFP68901.TimerC, v);
+                    break;
+
+                case 0x25: // TDDR
+                    _machine.Mfp.WriteTimerData(MFP68901.TimerD, v);
+                    break;
+            }
+
+            Ports[addr - PortsBase] = v;
+        }
+
+        // Per-device page handlers for the native page map (see MapToCpu). They do the same as the generic
+        // Read/Write methods for their page, without going through the whole chain of address checks.
+
+        // $FF8600: FDC / DMA
+        private byte ReadFdcPage8(uint addr)
+        {
+            if (addr >= 0xFF8604 && addr <= 0xFF860D)
+                return _machine.Fdc.ReadByte(addr);
+
+            return Ports[addr - PortsBase];
+        }
+
+        private ushort ReadFdcPage16(uint addr)
+        {
+            if (addr >= 0xFF8604 && addr <= 0xFF860D)
+                return _machine.Fdc.ReadWord(addr);
+
+            return (ushort)((ReadFdcPage8(addr) << 8) | ReadFdcPage8(addr + 1));
+        }
+
+        private void WriteFdcPage8(uint addr, byte v)
+        {
+            if (addr >= 0xFF8604 && addr <= 0xFF860D)
+                _machine.Fdc.WriteByte(addr, v);
+
+            Ports[addr - PortsBase] = v;
+        }
+
+        private void WriteFdcPage16(uint addr, ushort v)
+        {
+            if (addr >= 0xFF8604 && addr <= 0xFF860D)
+            {
+                _machine.Fdc.WriteWord(addr, v);
                 return;
             }
+
+            WriteFdcPage8(addr, (byte)(v >> 8));
+            WriteFdcPage8(addr + 1, (byte)v);
+        }
+
+        // $FF8800: YM2149
+        private byte ReadPsgPage8(uint addr)
+        {
+            if (addr == STPortAdress.ST_PSGREADSELECT)
+                return _machine.Ym.PSGRegisterData();
+            if (addr == STPortAdress.ST_PSGWRITEDATA)
+                return 0xFF;
+
+            return Ports[addr - PortsBase];
+        }
+
+        private ushort ReadPsgPage16(uint addr)
+        {
+            return (ushort)((ReadPsgPage8(addr) << 8) | ReadPsgPage8(addr + 1));
+        }
+
+        private void WritePsgPage8(uint addr, byte v)
+        {
+            if (addr == STPortAdress.ST_PSGREADSELECT)
+                _machine.Ym.PSGRegisterSelect(v);
+            else if (addr == STPortAdress.ST_PSGWRITEDATA)
+                _machine.Ym.PSGWriteRegister(v);
+            else
+                Ports[addr - PortsBase] = v;
+        }
+
+        private void WritePsgPage16(uint addr, ushort v)
+        {
+            WritePsgPage8(addr, (byte)(v >> 8));
+            WritePsgPage8(addr + 1, (byte)v);
+        }
+
+        // $FFFA00: MFP 68901 (byte accesses go straight to ReadMfp/WriteMfp)
+        private ushort ReadMfpPage16(uint addr)
+        {
+            return (ushort)((ReadMfp(addr) << 8) | ReadMfp(addr + 1));
+        }
+
+        private void WriteMfpPage16(uint addr, ushort v)
+        {
+            WriteMfp(addr, (byte)(v >> 8));
+            WriteMfp(addr + 1, (byte)v);
+        }
+
+        // $FFFC00: Keyboard ACIA
+        private byte ReadAciaPage8(uint addr)
+        {
+            if (addr == STPortAdress.ST_ACIACMD)
+                return _machine.Acia.ReadStatus();
+            if (addr == STPortAdress.ST_ACIADATA)
+                return _machine.Acia.ReadData();
+
+            return 0xFF;
+        }
+
+        private ushort ReadAciaPage16(uint addr)
+        {
+            return (ushort)((ReadAciaPage8(addr) << 8) | ReadAciaPage8(addr + 1));
+        }
+
+        private void WriteAciaPage8(uint addr, byte v)
+        {
+            if (addr == STPortAdress.ST_ACIACMD)
+                _machine.Acia.WriteControl(v);
+            else if (addr == STPortAdress.ST_ACIADATA)
+                _machine.Acia.HandleCommand(v);
+            else
+                Ports[addr - PortsBase] = v;
+        }
+
+        private void WriteAciaPage16(uint addr, ushort v)
+        {
+            WriteAciaPage8(addr, (byte)(v >> 8));
+            WriteAciaPage8(addr + 1, (byte)v);
         }
     }
 }
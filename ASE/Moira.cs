@@ -7,6 +7,7 @@
  * 
  */
 
+using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
 using System.Text;
 using static ASE.CPU;
@@ -21,8 +22,8 @@ namespace ASE
     /// supply delegates for memory access, synchronization, and interrupt handling. The class exposes methods for
     /// instruction execution, register manipulation, and disassembly, and supports both single-step and cycle-based
     /// execution. Thread safety is not guaranteed; callers should ensure appropriate synchronization if accessing
-    /// instances from multiple threads. The class implements IDisposable and must be disposed to release native
-    /// resources.</remarks>
+    /// an instance from multiple threads. Separate instances share no state and can run on separate threads at
+    /// the same time. The class implements IDisposable and must be disposed to release native resources.</remarks>
     public sealed class Moira : IDisposable
     {
         // -------------------- Public delegates --------------------
@@ -34,6 +35,175 @@ namespace ASE
         public delegate void Sync(int cycles);
         public delegate ushort ReadIrqUserVector(byte level);
 
+        /// <summary>Point of a scanline reached by <see cref="RunScanlines"/>.</summary>
+        public enum LinePhase
+        {
+            HBlank = 0,
+            End = 1
+        }
+
+        /// <summary>Called by <see cref="RunScanlines"/>. Return false to stop running lines.</summary>
+        public delegate bool Scanline(int line, LinePhase phase);
+
+        /// <summary>Called when a device event reaches its deadline (see <see cref="ScheduleEvent"/>).</summary>
+        public delegate void DeviceEvent(long cycle);
+
+        /// <summary>Number of device event ids (MOIRA_MAX_EVENTS).</summary>
+        public const int MaxEvents = 32;
+
+        /// <summary>Access flags for natively mapped memory regions (see <see cref="MapRegion"/>).</summary>
+        [Flags]
+        public enum MapFlags : uint
+        {
+            Read = 0x01,
+            Write = 0x02,
+            ReadWrite = Read | Write
+        }
+
+        /// <summary>Settings a native Moira library was compiled with (see <see cref="GetBuildInfo"/>).</summary>
+        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+        public struct BuildInfo
+        {
+            public uint AbiVersion;
+            [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 16)]
+            public string Profile;
+            [MarshalAs(UnmanagedType.U1)] public bool VirtualApi;
+            [MarshalAs(UnmanagedType.U1)] public bool PreciseTiming;
+            [MarshalAs(UnmanagedType.U1)] public bool EmulateAddressError;
+            [MarshalAs(UnmanagedType.U1)] public bool EmulateFC;
+            [MarshalAs(UnmanagedType.U1)] public bool Dasm;
+            [MarshalAs(UnmanagedType.U1)] public bool InstrInfoTable;
+        }
+
+        /// <summary>Eight 32-bit registers, laid out inline for <see cref="CpuState"/>.</summary>
+        [InlineArray(8)]
+        public struct RegisterArray
+        {
+            private uint _element0;
+        }
+
+        /// <summary>
+        /// Snapshot of the CPU registers, copied in a single call by <see cref="GetState"/> and <see cref="SetState"/>.
+        /// </summary>
+        /// <remarks>Matches moira_cpu_state. A[7] is the active stack pointer, USP and SSP the user and
+        /// supervisor ones.</remarks>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct CpuState
+        {
+            public RegisterArray D;
+            public RegisterArray A;
+            public uint USP;
+            public uint SSP;
+            public uint PC;
+            public uint PC0;
+            public ushort IRC;
+            public ushort IRD;
+            public ushort SR;
+            public byte IPL;
+            private byte _reserved;
+            public long Clock;
+        }
+
+        /// <summary>One traced instruction (moira_trace_entry), recorded before it executes.</summary>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct TraceEntry
+        {
+            public uint PC;
+            public ushort Opcode;
+            public ushort SR;
+            public long Clock;
+        }
+
+        /// <summary>Histogram returned by <see cref="FetchProfile"/>.</summary>
+        public enum ProfileKind
+        {
+            PC = 0,
+            Opcode = 1
+        }
+
+        /// <summary>
+        /// One instruction address or opcode of the hot spot profile (moira_profile_entry).
+        /// </summary>
+        /// <remarks>Key is the address, or the opcode for <see cref="ProfileKind.Opcode"/>. Count is instructions
+        /// run, or samples taken when sampled, and Cycles the time spent in them.</remarks>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct ProfileEntry
+        {
+            public uint Key;
+            public ushort Opcode;               // Last opcode seen at the address
+            private ushort _reserved;
+            public ulong Count;
+            public ulong Cycles;
+        }
+
+        /// <summary>
+        /// Bus and host call counts of the native wrapper (moira_counters), see <see cref="EnableCounters"/>.
+        /// </summary>
+        /// <remarks>RAM and ROM are the accesses to buffers mapped with <see cref="MapRegion"/> writable and read
+        /// only, IO the ones serviced by a handler. Callbacks counts every call from the core into managed code
+        /// (memory and device handlers, IRQ acknowledges, events and scanline callbacks).</remarks>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Counters
+        {
+            public ulong Reads8;
+            public ulong Reads16;
+            public ulong Writes8;
+            public ulong Writes16;
+            public ulong Ram;
+            public ulong Rom;
+            public ulong Io;
+            public ulong Callbacks;
+            public ulong BusErrors;
+            public ulong IrqAcks;
+            public long Cycles;
+
+            public readonly ulong Accesses => Reads8 + Reads16 + Writes8 + Writes16;
+
+            public static Counters operator -(in Counters a, in Counters b) => new Counters
+            {
+                Reads8 = a.Reads8 - b.Reads8,
+                Reads16 = a.Reads16 - b.Reads16,
+                Writes8 = a.Writes8 - b.Writes8,
+                Writes16 = a.Writes16 - b.Writes16,
+                Ram = a.Ram - b.Ram,
+                Rom = a.Rom - b.Rom,
+                Io = a.Io - b.Io,
+                Callbacks = a.Callbacks - b.Callbacks,
+                BusErrors = a.BusErrors - b.BusErrors,
+                IrqAcks = a.IrqAcks - b.IrqAcks,
+                Cycles = a.Cycles - b.Cycles,
+            };
+        }
+
+        /// <summary>Version of the C API this wrapper was written against (MOIRA_C_ABI_VERSION).</summary>
+        public const uint AbiVersion = 13;
+
+        /// <summary>
+        /// Name of the native library to load, for example "moira_fast" or "moira_accurate".
+        /// </summary>
+        /// <remarks>Must be set before the first Moira call, the library is bound once per process.</remarks>
+        public static string LibraryName { get; set; } = Lib;
+
+        static Moira()
+        {
+            NativeLibrary.SetDllImportResolver(typeof(Moira).Assembly, (name, assembly, searchPath) =>
+            {
+                if (name != Lib || LibraryName == Lib)
+                    return IntPtr.Zero;
+
+                return NativeLibrary.Load(LibraryName, assembly, searchPath);
+            });
+        }
+
+        /// <summary>
+        /// Returns the profile and the compile time settings of the loaded native library.
+        /// </summary>
+        public static BuildInfo GetBuildInfo()
+        {
+            Native.moira_get_build_info(out BuildInfo info);
+            return info;
+        }
+
         // -------------------- Construction --------------------
 
         public Moira(
@@ -57,28 +227,28 @@ namespace ASE
             _sync = sync;
             _readIrq = readIrqUserVector;
 
-            // Create unmanaged delegates that match the native signature
-            _r8 = (_, addr) => _read8(addr);
-            _r16 = (_, addr) => _read16(addr);
-            _w8 = (_, addr, v) => _write8(addr, v);
-            _w16 = (_, addr, v) => _write16(addr, v);
-            _syncNative = _sync is null ? null : new SyncFn((_, cycles) => _sync(cycles));
-            _irqNative = _readIrq is null ? null : new ReadIrqUserVectorFn((_, level) => _readIrq(level));
+            // The native entry points are shared by every instance, this one is found through the user pointer
+            _self = GCHandle.Alloc(this, GCHandleType.Weak);
+            _user = GCHandle.ToIntPtr(_self);
 
             var cb = new Callbacks
             {
-                user = IntPtr.Zero,
+                user = _user,
                 read8 = _r8,
                 read16 = _r16,
                 write8 = _w8,
                 write16 = _w16,
-                sync = _syncNative,
-                readIrqUserVector = _irqNative
+                sync = _sync is null ? null : _syncNative,
+                readIrqUserVector = _readIrq is null ? null : _irqNative
             };
 
             _h = Native.moira_create(ref cb);
             if (_h == IntPtr.Zero)
                 throw new InvalidOperationException("moira_create returned null.");
+
+            Native.moira_set_event_handler(_h, _eventNative, _user);
+
+            unsafe { _writeMap = (byte*)Native.moira_get_write_map(_h); }
         }
 
         // -------------------- Lifetime --------------------
@@ -90,11 +260,249 @@ namespace ASE
                 Native.moira_destroy(_h);
                 _h = IntPtr.Zero;
             }
+
+            // No callback can come after the native side is gone
+            FreeDeviceHandles();
+            if (_self.IsAllocated)
+                _self.Free();
+
             GC.SuppressFinalize(this);
         }
 
         ~Moira() => Dispose();
 
+        // -------------------- Native memory map --------------------
+
+        /// <summary>Granularity of the native memory map.</summary>
+        public const uint PageSize = 256;
+
+        /// <summary>
+        /// Maps part of a managed buffer into the 68k address space so the native wrapper can service
+        /// accesses to it directly, without calling back into the memory delegates.
+        /// </summary>
+        /// <remarks>The buffer must be allocated on the pinned object heap (<see cref="GC.AllocateArray{T}(int, bool)"/>),
+        /// since the native side keeps a raw pointer to it. The native map works on 256 byte pages, so base and size
+        /// must be multiples of <see cref="PageSize"/>. Later mappings override earlier ones.</remarks>
+        /// <param name="baseAddr">24 bit address where the region starts.</param>
+        /// <param name="buffer">Pinned buffer holding the region data in 68k (big-endian) byte order.</param>
+        /// <param name="offset">Offset of the first mapped byte inside the buffer.</param>
+        /// <param name="size">Size of the region in bytes.</param>
+        /// <param name="flags">Accesses serviced natively, read-only regions pass writes to the delegates.</param>
+        public void MapRegion(uint baseAddr, byte[] buffer, int offset, int size, MapFlags flags)
+        {
+            ArgumentNullException.ThrowIfNull(buffer);
+            if (offset < 0 || size <= 0 || offset + size > buffer.Length)
+                throw new ArgumentOutOfRangeException(nameof(size), "Region exceeds buffer bounds.");
+
+            IntPtr ptr = Marshal.UnsafeAddrOfPinnedArrayElement(buffer, offset);
+            if (Native.moira_map_region(_h, baseAddr, (uint)size, ptr, (uint)flags) != 0)
+                throw new InvalidOperationException($"moira_map_region failed at ${baseAddr:X6}.");
+
+            // The native side only keeps a pointer, keep the buffer reachable while it is mapped
+            _mappedBuffers.Add(buffer);
+        }
+
+        /// <summary>
+        /// Routes a range of pages to its own set of handlers, so accesses to a device are dispatched by a single
+        /// page lookup in native code instead of the address checks in the generic delegates.
+        /// </summary>
+        /// <param name="baseAddr">24 bit address where the range starts, page aligned.</param>
+        /// <param name="size">Size of the range in bytes, multiple of <see cref="PageSize"/>.</param>
+        public void MapDevice(uint baseAddr, uint size, Read8 read8, Read16 read16, Write8 write8, Write16 write16)
+        {
+            ArgumentNullException.ThrowIfNull(read8);
+            ArgumentNullException.ThrowIfNull(read16);
+            ArgumentNullException.ThrowIfNull(write8);
+            ArgumentNullException.ThrowIfNull(write16);
+
+            var device = new Device(read8, read16, write8, write16);
+            GCHandle handle = GCHandle.Alloc(device, GCHandleType.Weak);
+
+            var dev = new DeviceCallbacks
+            {
+                user = GCHandle.ToIntPtr(handle),
+                read8 = _dr8,
+                read16 = _dr16,
+                write8 = _dw8,
+                write16 = _dw16
+            };
+
+            if (Native.moira_map_device(_h, baseAddr, size, ref dev) != 0)
+            {
+                handle.Free();
+                throw new InvalidOperationException($"moira_map_device failed at ${baseAddr:X6}.");
+            }
+
+            // The handle is weak, the list keeps the handlers alive while they are mapped
+            _devices.Add(device);
+            _deviceHandles.Add(handle);
+        }
+
+        /// <summary>
+        /// Makes a range of pages raise a bus error natively, for hardware that is not present.
+        /// </summary>
+        /// <param name="baseAddr">24 bit address where the range starts, page aligned.</param>
+        /// <param name="size">Size of the range in bytes, multiple of <see cref="PageSize"/>.</param>
+        /// <param name="flags">Access directions that fault, the others keep their current mapping.</param>
+        public void MapBusError(uint baseAddr, uint size, MapFlags flags = MapFlags.ReadWrite)
+        {
+            if (Native.moira_map_bus_error(_h, baseAddr, size, (uint)flags) != 0)
+                throw new InvalidOperationException($"moira_map_bus_error failed at ${baseAddr:X6}.");
+        }
+
+        /// <summary>
+        /// Maps the BLiTTER registers on the page at <paramref name="baseAddr"/> to the native blitter of the wrapper.
+        /// </summary>
+        /// <remarks>Blits run in native code on the mapped buffers and take their bus time from the CPU through
+        /// the event queue, with no call into managed code until the blit is done.</remarks>
+        /// <param name="baseAddr">24 bit address of the registers, page aligned.</param>
+        /// <param name="doneEvent">Event scheduled when a blit ends (see <see cref="OnEvent"/>), -1 for none.</param>
+        public void MapBlitter(uint baseAddr, int doneEvent = -1)
+        {
+            if (Native.moira_map_blitter(_h, baseAddr, doneEvent) != 0)
+                throw new InvalidOperationException($"moira_map_blitter failed at ${baseAddr:X6}.");
+        }
+
+        /// <summary>Removes all native mappings, every access goes through the delegates again.</summary>
+        public void UnmapAll()
+        {
+            Native.moira_unmap_all(_h);
+            _mappedBuffers.Clear();
+            FreeDeviceHandles();
+        }
+
+        private void FreeDeviceHandles()
+        {
+            foreach (GCHandle handle in _deviceHandles)
+                handle.Free();
+
+            _deviceHandles.Clear();
+            _devices.Clear();
+        }
+
+        // -------------------- Write map --------------------
+
+        /// <summary>Size of the blocks tracked by the write map.</summary>
+        public const int WriteBlockSize = 32;
+
+        /// <summary>
+        /// Tells whether the CPU wrote to [<paramref name="addr"/>, <paramref name="addr"/> + <paramref name="size"/>)
+        /// since the last call for that range, and clears it.
+        /// </summary>
+        /// <remarks>Only writes to native buffers (<see cref="MapRegion"/>) are tracked by the core, writes done
+        /// from the host are added with <see cref="MarkWritten"/>. Granularity is <see cref="WriteBlockSize"/>
+        /// bytes, the map is read and cleared in place without a native call.</remarks>
+        public unsafe bool TakeWritten(uint addr, int size)
+        {
+            bool written = false;
+            uint last = (addr + (uint)size - 1) & 0xFFFFFF;
+
+            for (uint block = (addr & 0xFFFFFF) / WriteBlockSize; block <= last / WriteBlockSize; block++)
+            {
+                byte* map = _writeMap + (block >> 3);
+                byte bit = (byte)(1 << (int)(block & 7));
+
+                if ((*map & bit) != 0)
+                {
+                    *map &= (byte)~bit;
+                    written = true;
+                }
+            }
+
+            return written;
+        }
+
+        /// <summary>Marks a write done outside the core (DMA, page 0 delegates, ...) in the write map.</summary>
+        public unsafe void MarkWritten(uint addr)
+        {
+            uint block = (addr & 0xFFFFFF) / WriteBlockSize;
+            _writeMap[block >> 3] |= (byte)(1 << (int)(block & 7));
+        }
+
+        /// <summary>Marks every block of [<paramref name="addr"/>, <paramref name="addr"/> + <paramref name="size"/>) as written.</summary>
+        public unsafe void MarkWritten(uint addr, int size)
+        {
+            if (size <= 0)
+                return;
+
+            uint last = (addr + (uint)size - 1) & 0xFFFFFF;
+            for (uint block = (addr & 0xFFFFFF) / WriteBlockSize; block <= last / WriteBlockSize; block++)
+                _writeMap[block >> 3] |= (byte)(1 << (int)(block & 7));
+        }
+
+        // -------------------- Instruction trace --------------------
+
+        /// <summary>
+        /// Starts recording every instruction executed in a native ring of at least <paramref name="capacity"/>
+        /// entries, 0 stops and frees it. Costs nothing while off.
+        /// </summary>
+        public void EnableTrace(int capacity)
+        {
+            if (Native.moira_trace_enable(_h, (uint)Math.Max(capacity, 0)) != 0)
+                throw new OutOfMemoryException($"No memory for a trace of {capacity} instructions.");
+        }
+
+        /// <summary>Instructions recorded and not fetched yet, at most the ring capacity.</summary>
+        public int TraceCount => (int)Native.moira_trace_fetch(_h, ref Unsafe.NullRef<TraceEntry>(), 0);
+
+        /// <summary>
+        /// Moves the oldest entries not fetched yet to <paramref name="entries"/>.
+        /// </summary>
+        /// <returns>The entries copied.</returns>
+        public int FetchTrace(Span<TraceEntry> entries)
+        {
+            if (entries.IsEmpty)
+                return 0;
+
+            return (int)Native.moira_trace_fetch(_h, ref MemoryMarshal.GetReference(entries), (nuint)entries.Length);
+        }
+
+        // -------------------- Hot spot profiler --------------------
+
+        /// <summary>
+        /// Starts a new profile of the instructions executed, per address and per opcode.
+        /// </summary>
+        /// <param name="sampleCycles">0 counts every instruction, otherwise only the one running at the end of
+        /// every period of this many cycles.</param>
+        public void StartProfile(int sampleCycles)
+        {
+            if (Native.moira_profile_start(_h, (uint)Math.Max(sampleCycles, 0)) != 0)
+                throw new OutOfMemoryException("No memory for the profiler histograms.");
+        }
+
+        /// <summary>Stops the profiler and frees its histograms, fetch them first.</summary>
+        public void StopProfile() => Native.moira_profile_stop(_h);
+
+        /// <summary>
+        /// Every address or opcode with a non zero count, by ascending key. Empty if the profiler is not running.
+        /// </summary>
+        public ProfileEntry[] FetchProfile(ProfileKind kind)
+        {
+            int count = (int)Native.moira_profile_fetch(_h, (int)kind, ref Unsafe.NullRef<ProfileEntry>(), 0);
+            var entries = new ProfileEntry[count];
+            if (count > 0)
+                count = (int)Native.moira_profile_fetch(_h, (int)kind, ref entries[0], (nuint)count);
+
+            return count == entries.Length ? entries : entries[..count];
+        }
+
+        // -------------------- Performance counters --------------------
+
+        /// <summary>
+        /// Starts or stops counting bus accesses and host calls in the native wrapper. Off by default, it costs a
+        /// branch per access while off. Stopping keeps the counts.
+        /// </summary>
+        public void EnableCounters(bool enable) => Native.moira_counters_enable(_h, enable ? 1 : 0);
+
+        /// <summary>Counts since creation or the last <see cref="ResetCounters"/>.</summary>
+        public Counters GetCounters()
+        {
+            Native.moira_get_counters(_h, out Counters counters);
+            return counters;
+        }
+
+        public void ResetCounters() => Native.moira_reset_counters(_h);
+
         // -------------------- Execution --------------------
 
         public void Reset() => Native.moira_reset(_h);
@@ -105,19 +513,54 @@ namespace ASE
         /// <summary>
         /// Execute until at least the given number of cycles has elapsed.
         /// </summary>
-        /// <remarks>This method catches all exceptions thrown by the emulator loop since it executes in a different thread.</remarks>
-        public void RunForCycles(long cycles) 
+        public void RunForCycles(long cycles) => Native.moira_execute_cycles(_h, cycles);
+
+        /// <summary>
+        /// Runs a block of scanlines in a single native call.
+        /// </summary>
+        /// <remarks>The callback is invoked when the CPU reaches <paramref name="hblSplit"/> cycles into each line
+        /// and at the end of the line, line boundaries are kept on absolute clock values.</remarks>
+        /// <param name="count">Number of scanlines to run.</param>
+        /// <param name="cyclesPerLine">CPU cycles per scanline.</param>
+        /// <param name="hblSplit">Cycle of the line where H-Blank starts, 0 to only call back at the end of the line.</param>
+        /// <param name="scanline">Line callback, receives the line number inside the block.</param>
+        /// <returns>The number of lines completed.</returns>
+        public int RunScanlines(int count, int cyclesPerLine, int hblSplit, Scanline scanline)
         {
-            try
-            {
-                Native.moira_execute_cycles(_h, cycles);
-            }
-            catch
-            {
-                Console.WriteLine("Not controlled exception in Moira");
-            }
+            ArgumentNullException.ThrowIfNull(scanline);
+
+            _scanline = scanline;
+
+            return Native.moira_run_scanlines(_h, count, cyclesPerLine, hblSplit, _lineNative, _user);
+        }
+
+        // -------------------- Device events --------------------
+
+        /// <summary>
+        /// Sets the handler called when the event <paramref name="id"/> reaches its deadline.
+        /// </summary>
+        public void OnEvent(int id, DeviceEvent handler)
+        {
+            ArgumentOutOfRangeException.ThrowIfNegative(id);
+            ArgumentOutOfRangeException.ThrowIfGreaterThanOrEqual(id, MaxEvents);
+
+            _eventHandlers[id] = handler;
         }
 
+        /// <summary>
+        /// Schedules the event <paramref name="id"/> at an absolute CPU cycle, replacing its previous deadline.
+        /// </summary>
+        /// <remarks>Execution stops at the first instruction boundary at or past the deadline to call the
+        /// handler, which receives the scheduled cycle. Must be called from the emulation thread.</remarks>
+        public void ScheduleEvent(long cycle, int id)
+        {
+            if (Native.moira_schedule_event(_h, cycle, id) != 0)
+                throw new ArgumentOutOfRangeException(nameof(id));
+        }
+
+        /// <summary>Removes the pending deadline of the event <paramref name="id"/>, if any.</summary>
+        public void CancelEvent(int id) => Native.moira_cancel_event(_h, id);
+
         /// <summary>Execute until the internal clock reaches the target cycle.</summary>
         public void RunUntil(long cycle) => Native.moira_execute_until(_h, cycle);
 
@@ -127,6 +570,12 @@ namespace ASE
         /// <remarks>Supervisor mode may grant elevated access to protected memory.</param>
         public void SetSupervisorMode(bool s) => Native.moira_setSupervisorMode(_h, s);
 
+        /// <summary>
+        /// Ends the memory access in progress with a bus error.
+        /// </summary>
+        /// <remarks>Only valid from a memory or device delegate, the native wrapper reports it as the status of
+        /// that access and raises the exception inside Moira's execution loop. Fixed regions are cheaper mapped
+        /// with <see cref="MapBusError"/>.</remarks>
         public void TriggerBusError(uint ErrorAdress, bool IsWrite)
         {
             if (Config.ConfigOptions.RunninConfig.DebugMode)
@@ -141,6 +590,37 @@ namespace ASE
             set => Native.moira_setClock(_h, value);
         }
 
+        /// <summary>Copies all the CPU registers and the clock in one native call.</summary>
+        public CpuState GetState()
+        {
+            Native.moira_get_state(_h, out CpuState state);
+            return state;
+        }
+
+        /// <summary>Restores a snapshot taken with <see cref="GetState"/>, SR is applied first.</summary>
+        public void SetState(in CpuState state) => Native.moira_set_state(_h, in state);
+
+        /// <summary>Size in bytes of the core snapshot written by <see cref="Serialize"/>.</summary>
+        public int SnapshotSize => (int)Native.moira_serialize(_h, ref Unsafe.NullRef<byte>(), 0);
+
+        /// <summary>
+        /// Writes the CPU state and the pending device events to <paramref name="buffer"/>.
+        /// </summary>
+        /// <returns>The bytes written, or <see cref="SnapshotSize"/> if the buffer is too small.</returns>
+        public int Serialize(Span<byte> buffer)
+        {
+            return (int)Native.moira_serialize(_h, ref MemoryMarshal.GetReference(buffer), (nuint)buffer.Length);
+        }
+
+        /// <summary>
+        /// Restores a core snapshot written by <see cref="Serialize"/>.
+        /// </summary>
+        /// <returns>False if the data is not a snapshot of this library version.</returns>
+        public bool Deserialize(ReadOnlySpan<byte> buffer)
+        {
+            return Native.moira_deserialize(_h, in MemoryMarshal.GetReference(buffer), (nuint)buffer.Length) == 0;
+        }
+
         // Registers (idiomatic)
 
         public uint PC
@@ -274,6 +754,16 @@ namespace ASE
         // Private state
 
         private IntPtr _h;
+        private unsafe byte* _writeMap;
+
+        // Weak handle to this instance, passed as the user pointer of every callback
+        private GCHandle _self;
+        private readonly IntPtr _user;
+
+        // Buffers and device handlers mapped through MapRegion/MapDevice
+        private readonly List<byte[]> _mappedBuffers = new List<byte[]>();
+        private readonly List<Device> _devices = new List<Device>();
+        private readonly List<GCHandle> _deviceHandles = new List<GCHandle>();
 
         // Keep original managed delegates (user passed) alive
         private readonly Read8 _read8;
@@ -283,13 +773,31 @@ namespace ASE
         private readonly Sync? _sync;
         private readonly ReadIrqUserVector? _readIrq;
 
-        // Keep unmanaged delegates alive
-        private readonly Read8Fn _r8;
-        private readonly Read16Fn _r16;
-        private readonly Write8Fn _w8;
-        private readonly Write16Fn _w16;
-        private readonly SyncFn? _syncNative;
-        private readonly ReadIrqUserVectorFn? _irqNative;
+        private readonly DeviceEvent[] _eventHandlers = new DeviceEvent[MaxEvents];
+        private Scanline _scanline;
+
+        // Native entry points, one set for the whole process. They live as long as the class, so they are never
+        // collected while a core can call them, and every machine of a parallel run goes through the same thunks.
+        private static Moira From(IntPtr user) => (Moira)GCHandle.FromIntPtr(user).Target!;
+
+        private static readonly Read8Fn _r8 = (user, addr) => From(user)._read8(addr);
+        private static readonly Read16Fn _r16 = (user, addr) => From(user)._read16(addr);
+        private static readonly Write8Fn _w8 = (user, addr, v) => From(user)._write8(addr, v);
+        private static readonly Write16Fn _w16 = (user, addr, v) => From(user)._write16(addr, v);
+        private static readonly SyncFn _syncNative = (user, cycles) => From(user)._sync!(cycles);
+        private static readonly ReadIrqUserVectorFn _irqNative = (user, level) => From(user)._readIrq!(level);
+        private static readonly LineFn _lineNative = (user, line, phase) => From(user)._scanline(line, (LinePhase)phase) ? 0 : 1;
+        private static readonly EventFn _eventNative = (user, id, cycle) => From(user)._eventHandlers[id]?.Invoke(cycle);
+
+        // Handlers of a page range mapped with MapDevice, the user pointer of its callbacks
+        private sealed record Device(Read8 Read8, Read16 Read16, Write8 Write8, Write16 Write16);
+
+        private static Device DeviceFrom(IntPtr user) => (Device)GCHandle.FromIntPtr(user).Target!;
+
+        private static readonly Read8Fn _dr8 = (user, addr) => DeviceFrom(user).Read8(addr);
+        private static readonly Read16Fn _dr16 = (user, addr) => DeviceFrom(user).Read16(addr);
+        private static readonly Write8Fn _dw8 = (user, addr, v) => DeviceFrom(user).Write8(addr, v);
+        private static readonly Write16Fn _dw16 = (user, addr, v) => DeviceFrom(user).Write16(addr, v);
 
         // Native interop (internal/private)
 
@@ -307,6 +815,16 @@ namespace ASE
             public ReadIrqUserVectorFn? readIrqUserVector;
         }
 
+        [StructLayout(LayoutKind.Sequential)]
+        private struct DeviceCallbacks
+        {
+            public IntPtr user;
+            public Read8Fn read8;
+            public Read16Fn read16;
+            public Write8Fn write8;
+            public Write16Fn write16;
+        }
+
         // Native callback signatures (match your current DLL)
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         private delegate byte Read8Fn(IntPtr user, uint addr);
@@ -326,17 +844,68 @@ namespace ASE
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         private delegate ushort ReadIrqUserVectorFn(IntPtr user, byte level);
 
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate int LineFn(IntPtr user, int line, int phase);
+
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        private delegate void EventFn(IntPtr user, int id, long cycle);
+
         private static class Native
         {
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_get_build_info(out BuildInfo info);
+
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern IntPtr moira_create(ref Callbacks cb);
 
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern void moira_destroy(IntPtr h);
 
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_map_region(IntPtr h, uint baseAddr, uint size, IntPtr ptr, uint flags);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_map_device(IntPtr h, uint baseAddr, uint size, ref DeviceCallbacks dev);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_map_bus_error(IntPtr h, uint baseAddr, uint size, uint flags);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_map_blitter(IntPtr h, uint baseAddr, int doneEvent);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_unmap_all(IntPtr h);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern IntPtr moira_get_write_map(IntPtr h);
+
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern void moira_reset(IntPtr h);
 
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_trace_enable(IntPtr h, uint capacity);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern nuint moira_trace_fetch(IntPtr h, ref TraceEntry buf, nuint n);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_profile_start(IntPtr h, uint sampleCycles);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_profile_stop(IntPtr h);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern nuint moira_profile_fetch(IntPtr h, int kind, ref ProfileEntry buf, nuint n);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_counters_enable(IntPtr h, int enable);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_get_counters(IntPtr h, out Counters counters);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_reset_counters(IntPtr h);
+
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern void moira_execute(IntPtr h);
 
@@ -346,6 +915,30 @@ namespace ASE
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern void moira_execute_until(IntPtr h, long cycle);
 
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_set_event_handler(IntPtr h, EventFn fn, IntPtr user);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_schedule_event(IntPtr h, long cycle, int id);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern void moira_cancel_event(IntPtr h, int id);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_run_scanlines(IntPtr h, int count, int cyclesPerLine, int hblSplit, LineFn callback, IntPtr user);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_get_state(IntPtr h, out CpuState state);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_set_state(IntPtr h, in CpuState state);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern nuint moira_serialize(IntPtr h, ref byte buf, nuint size);
+
+            [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
+            internal static extern int moira_deserialize(IntPtr h, in byte buf, nuint size);
+
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
             internal static extern void moira_setSupervisorMode(IntPtr h, bool s);
             [DllImport(Lib, CallingConvention = CallingConvention.Cdecl)]
@@ -0,0 +1,89 @@
+﻿/*
+ *
+ * Per frame rates of the native CPU bus counters
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Text.Json;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// Logs the counters of the native wrapper (<see cref="Moira.Counters"/>) as averages per frame, every
+    /// <c>--counters=N</c> frames, so it is clear where the time of a frame goes: how many accesses hit RAM, ROM
+    /// or I/O and how many of them cross into managed code.
+    /// </summary>
+    /// <remarks>One per machine, runs on its thread at the end of each frame (see <see cref="Machine.RunFrame"/>).
+    /// The native counters are never reset here, each log is the difference with the previous snapshot.</remarks>
+    public sealed class PerfCounters
+    {
+        readonly Moira _cpu;
+        Moira.Counters _last;
+        int _frames;
+
+        public static bool Enabled => ConfigOptions.RunninConfig.CounterFrames > 0;
+
+        /// <summary>
+        /// Turns the counting on for a new core, called when the <see cref="Machine"/> is built.
+        /// </summary>
+        public PerfCounters(Moira cpu)
+        {
+            _cpu = cpu;
+            cpu.ResetCounters();
+            cpu.EnableCounters(true);
+        }
+
+        public void OnFrame()
+        {
+            if (++_frames < ConfigOptions.RunninConfig.CounterFrames)
+                return;
+
+            Moira.Counters now = _cpu.GetCounters();
+            Moira.Counters c = now - _last;
+            double n = _frames;
+
+            _last = now;
+            _frames = 0;
+
+            ColoredConsole.WriteLine($"Per frame: [[cyan]]{c.Cycles / n:F0}[[/cyan]] cycles, " +
+                $"[[cyan]]{c.Accesses / n:F0}[[/cyan]] accesses (R8 {c.Reads8 / n:F0} R16 {c.Reads16 / n:F0} W8 {c.Writes8 / n:F0} W16 {c.Writes16 / n:F0}), " +
+                $"RAM {c.Ram / n:F0} ROM {c.Rom / n:F0} IO {c.Io / n:F0}, " +
+                $"[[yellow]]{c.Callbacks / n:F0}[[/yellow]] callbacks, {c.IrqAcks / n:F1} IRQ acks, {c.BusErrors / n:F1} bus errors");
+        }
+
+        /// <summary>
+        /// Writes <paramref name="c"/> as a "counters" object with totals and averages per frame, for the
+        /// <see cref="Headless"/> report.
+        /// </summary>
+        public static void WriteJson(Utf8JsonWriter json, in Moira.Counters c, int frames)
+        {
+            double n = Math.Max(frames, 1);
+
+            json.WriteStartObject("counters");
+            json.WriteNumber("cycles", c.Cycles);
+            json.WriteNumber("reads8", c.Reads8);
+            json.WriteNumber("reads16", c.Reads16);
+            json.WriteNumber("writes8", c.Writes8);
+            json.WriteNumber("writes16", c.Writes16);
+            json.WriteNumber("ram", c.Ram);
+            json.WriteNumber("rom", c.Rom);
+            json.WriteNumber("io", c.Io);
+            json.WriteNumber("callbacks", c.Callbacks);
+            json.WriteNumber("irq_acks", c.IrqAcks);
+            json.WriteNumber("bus_errors", c.BusErrors);
+
+            json.WriteStartObject("per_frame");
+            json.WriteNumber("accesses", c.Accesses / n);
+            json.WriteNumber("io", c.Io / n);
+            json.WriteNumber("callbacks", c.Callbacks / n);
+            json.WriteNumber("irq_acks", c.IrqAcks / n);
+            json.WriteNumber("bus_errors", c.BusErrors / n);
+            json.WriteEndObject();
+
+            json.WriteEndObject();
+        }
+    }
+}
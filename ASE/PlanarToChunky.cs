@@ -0,0 +1,203 @@
+﻿/*
+ *
+ * Planar to chunky conversion of ST video lines
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Runtime.Intrinsics;
+using System.Runtime.Intrinsics.Arm;
+using System.Runtime.Intrinsics.X86;
+
+namespace ASE
+{
+    /// <summary>
+    /// Converts one line of ST video memory, interleaved bitplanes in big-endian words, to 32-bit pixels.
+    /// </summary>
+    /// <remarks>Every group of 16 pixels is decoded at once: each plane word is spread over 16 byte lanes with a
+    /// byte shuffle, the bit of each pixel is isolated with a mask and the planes are merged into 16 colour
+    /// indices. The indices then pick the palette bytes with a table lookup (PSHUFB on x86, TBL on ARM64) and are
+    /// widened to pixels. Hardware without 128-bit SIMD takes the scalar loop.</remarks>
+    public static class PlanarToChunky
+    {
+        // Leftmost pixel is the most significant bit
+        static readonly Vector128<byte> PixelBit = Vector128.Create(
+            (byte)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+            0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+        // Big-endian word of each plane in the group: pixels 0-7 are in its first byte, 8-15 in the second
+        static readonly Vector128<byte>[] PlaneBytes =
+        {
+            Vector128.Create((byte)0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1),
+            Vector128.Create((byte)2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3),
+            Vector128.Create((byte)4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5),
+            Vector128.Create((byte)6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7),
+        };
+
+        /// <summary>
+        /// Low resolution: 20 groups of 4 planes, every pixel is written twice to fill 640 pixels.
+        /// </summary>
+        /// <remarks>Fewer <paramref name="groups"/> convert part of a line, as the raster mode does, every
+        /// conversion takes the groups from the start of the spans.</remarks>
+        public static void ConvertLow(ReadOnlySpan<byte> line, ReadOnlySpan<uint> palette, Span<uint> dst, int groups = 20)
+        {
+            Convert(line, palette, dst, planes: 4, groups, doubled: true);
+        }
+
+        /// <summary>
+        /// Medium resolution: 40 groups of 2 planes, 640 pixels.
+        /// </summary>
+        public static void ConvertMedium(ReadOnlySpan<byte> line, ReadOnlySpan<uint> palette, Span<uint> dst, int groups = 40)
+        {
+            Convert(line, palette, dst, planes: 2, groups, doubled: false);
+        }
+
+        /// <summary>
+        /// High resolution: 40 words of a single plane, 640 pixels.
+        /// </summary>
+        public static void ConvertHigh(ReadOnlySpan<byte> line, ReadOnlySpan<uint> palette, Span<uint> dst, int groups = 40)
+        {
+            Convert(line, palette, dst, planes: 1, groups, doubled: false);
+        }
+
+        static void Convert(ReadOnlySpan<byte> line, ReadOnlySpan<uint> palette, Span<uint> dst, int planes, int groups, bool doubled)
+        {
+            int bytesPerGroup = planes * 2;
+
+            if (line.Length < groups * bytesPerGroup || dst.Length < groups * (doubled ? 32 : 16) || palette.Length < (1 << planes))
+                throw new ArgumentException("Line, palette or destination too small for the video mode");
+
+            if (!Vector128.IsHardwareAccelerated)
+            {
+                ConvertScalar(line, palette, dst, planes, groups, doubled);
+                return;
+            }
+
+            // Palette split in one 16 entry byte table per channel
+            Span<uint> pal = stackalloc uint[16];
+            palette.Slice(0, 1 << planes).CopyTo(pal);
+            Vector128<uint> p0 = Vector128.Create(pal[0], pal[1], pal[2], pal[3]);
+            Vector128<uint> p1 = Vector128.Create(pal[4], pal[5], pal[6], pal[7]);
+            Vector128<uint> p2 = Vector128.Create(pal[8], pal[9], pal[10], pal[11]);
+            Vector128<uint> p3 = Vector128.Create(pal[12], pal[13], pal[14], pal[15]);
+            Vector128<byte> tab0 = Channel(p0, p1, p2, p3, 0);
+            Vector128<byte> tab1 = Channel(p0, p1, p2, p3, 8);
+            Vector128<byte> tab2 = Channel(p0, p1, p2, p3, 16);
+            Vector128<byte> tab3 = Channel(p0, p1, p2, p3, 24);
+
+            ref uint output = ref MemoryMarshal.GetReference(dst);
+            nuint pos = 0;
+
+            for (int group = 0; group < groups; group++)
+            {
+                Vector128<byte> words = LoadGroup(line.Slice(group * bytesPerGroup), planes);
+
+                Vector128<byte> index = Vector128<byte>.Zero;
+                for (int plane = 0; plane < planes; plane++)
+                {
+                    Vector128<byte> bits = Lookup(words, PlaneBytes[plane]) & PixelBit;
+                    index |= ~Vector128.Equals(bits, Vector128<byte>.Zero) & Vector128.Create((byte)(1 << plane));
+                }
+
+                // Pixels are the 4 channel bytes, the first one in the low byte
+                (Vector128<ushort> c0Lo, Vector128<ushort> c0Hi) = Vector128.Widen(Lookup(tab0, index));
+                (Vector128<ushort> c1Lo, Vector128<ushort> c1Hi) = Vector128.Widen(Lookup(tab1, index));
+                (Vector128<ushort> c2Lo, Vector128<ushort> c2Hi) = Vector128.Widen(Lookup(tab2, index));
+                (Vector128<ushort> c3Lo, Vector128<ushort> c3Hi) = Vector128.Widen(Lookup(tab3, index));
+
+                (Vector128<uint> lowLo, Vector128<uint> lowHi) = Vector128.Widen(c0Lo | (c1Lo << 8));
+                (Vector128<uint> highLo, Vector128<uint> highHi) = Vector128.Widen(c2Lo | (c3Lo << 8));
+                Vector128<uint> px0 = lowLo | (highLo << 16);
+                Vector128<uint> px1 = lowHi | (highHi << 16);
+
+                (lowLo, lowHi) = Vector128.Widen(c0Hi | (c1Hi << 8));
+                (highLo, highHi) = Vector128.Widen(c2Hi | (c3Hi << 8));
+                Vector128<uint> px2 = lowLo | (highLo << 16);
+                Vector128<uint> px3 = lowHi | (highHi << 16);
+
+                if (doubled)
+                {
+                    Store2x(px0, ref output, pos);
+                    Store2x(px1, ref output, pos + 8);
+                    Store2x(px2, ref output, pos + 16);
+                    Store2x(px3, ref output, pos + 24);
+                    pos += 32;
+                }
+                else
+                {
+                    px0.StoreUnsafe(ref output, pos);
+                    px1.StoreUnsafe(ref output, pos + 4);
+                    px2.StoreUnsafe(ref output, pos + 8);
+                    px3.StoreUnsafe(ref output, pos + 12);
+                    pos += 16;
+                }
+            }
+        }
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        static Vector128<byte> LoadGroup(ReadOnlySpan<byte> group, int planes)
+        {
+            return planes switch
+            {
+                4 => Vector128.CreateScalar(MemoryMarshal.Read<ulong>(group)).AsByte(),
+                2 => Vector128.CreateScalar(MemoryMarshal.Read<uint>(group)).AsByte(),
+                _ => Vector128.CreateScalar(MemoryMarshal.Read<ushort>(group)).AsByte(),
+            };
+        }
+
+        // Byte 'shift' of every palette entry, as a 16 byte table
+        static Vector128<byte> Channel(Vector128<uint> p0, Vector128<uint> p1, Vector128<uint> p2, Vector128<uint> p3, int shift)
+        {
+            Vector128<uint> mask = Vector128.Create(0xFFu);
+            Vector128<ushort> lo = Vector128.Narrow((p0 >> shift) & mask, (p1 >> shift) & mask);
+            Vector128<ushort> hi = Vector128.Narrow((p2 >> shift) & mask, (p3 >> shift) & mask);
+            return Vector128.Narrow(lo, hi);
+        }
+
+        // Byte shuffle, indices are always below 16 so the native instructions need no fix up
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        static Vector128<byte> Lookup(Vector128<byte> table, Vector128<byte> index)
+        {
+            if (Ssse3.IsSupported)
+                return Ssse3.Shuffle(table, index);
+            if (AdvSimd.Arm64.IsSupported)
+                return AdvSimd.Arm64.VectorTableLookup(table, index);
+            return Vector128.Shuffle(table, index);
+        }
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        static void Store2x(Vector128<uint> px, ref uint output, nuint pos)
+        {
+            Vector128.Shuffle(px, Vector128.Create(0u, 0, 1, 1)).StoreUnsafe(ref output, pos);
+            Vector128.Shuffle(px, Vector128.Create(2u, 2, 3, 3)).StoreUnsafe(ref output, pos + 4);
+        }
+
+        static void ConvertScalar(ReadOnlySpan<byte> line, ReadOnlySpan<uint> palette, Span<uint> dst, int planes, int groups, bool doubled)
+        {
+            int dstPixel = 0;
+
+            for (int group = 0; group < groups; group++)
+            {
+                ReadOnlySpan<byte> words = line.Slice(group * planes * 2);
+
+                for (int bit = 15; bit >= 0; bit--)
+                {
+                    int idx = 0;
+                    for (int plane = 0; plane < planes; plane++)
+                    {
+                        int word = (words[plane * 2] << 8) | words[plane * 2 + 1];
+                        idx |= ((word >> bit) & 1) << plane;
+                    }
+
+                    dst[dstPixel++] = palette[idx];
+
+                    if (doubled)
+                        dst[dstPixel++] = palette[idx];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,121 @@
+﻿/*
+ *
+ * Hot spot profile of the guest code
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Text;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// Writes the native profiler histograms (<see cref="Moira.StartProfile"/>) when the emulation stops, to find the
+    /// guest loops worth optimising or special casing.
+    /// </summary>
+    /// <remarks>The profile file holds folded stacks, one line per instruction weighted by its cycles, read by
+    /// flamegraph.pl, speedscope and most flamegraph viewers. There are no call stacks, each instruction sits under
+    /// its memory region and its 256 byte block, so tight loops show up as one wide block. A text report with the
+    /// hottest blocks, instructions and opcodes, disassembled, goes next to it with a .txt extension.</remarks>
+    public static class Profiler
+    {
+        const int TopBlocks = 24;
+        const int TopInstructions = 64;
+        const int TopOpcodes = 32;
+
+        public static void WriteIfEnabled(Machine? machine)
+        {
+            string path = ConfigOptions.RunninConfig.ProfilePath;
+            if (string.IsNullOrEmpty(path) || machine == null)
+                return;
+
+            Moira.ProfileEntry[] pcs = machine.Cpu.FetchProfile(Moira.ProfileKind.PC);
+            Moira.ProfileEntry[] opcodes = machine.Cpu.FetchProfile(Moira.ProfileKind.Opcode);
+
+            try
+            {
+                WriteFolded(machine, path, pcs);
+                WriteReport(machine, path + ".txt", pcs, opcodes);
+                ColoredConsole.WriteLine($"Profile of [[cyan]]{pcs.Length}[[/cyan]] addresses written to [[green]]{path}[[/green]].");
+            }
+            catch (Exception ex)
+            {
+                ColoredConsole.WriteLine($"Cannot write the profile: [[red]]{ex.Message}[[/red]]");
+            }
+        }
+
+        static void WriteFolded(Machine machine, string path, Moira.ProfileEntry[] pcs)
+        {
+            using var file = new StreamWriter(path, false, new UTF8Encoding(false));
+
+            foreach (var e in pcs)
+                file.WriteLine($"{Region(machine, e.Key)};${e.Key & ~0xFFu:X6};${e.Key:X6} {Disassemble(machine, e.Key, e.Opcode).Replace(';', ',')} {e.Cycles}");
+        }
+
+        static void WriteReport(Machine machine, string path, Moira.ProfileEntry[] pcs, Moira.ProfileEntry[] opcodes)
+        {
+            ulong totalCycles = 0, totalCount = 0;
+            foreach (var e in pcs)
+            {
+                totalCycles += e.Cycles;
+                totalCount += e.Count;
+            }
+
+            using var file = new StreamWriter(path, false, new UTF8Encoding(false));
+
+            int sample = ConfigOptions.RunninConfig.ProfileSample;
+            file.WriteLine(sample > 0 ? $"Sampled every {sample} cycles, {totalCount} samples" : $"Exact, {totalCount} instructions");
+            file.WriteLine($"{totalCycles} cycles in {pcs.Length} addresses");
+
+            // Blocks, with the hottest instruction of each as a hint of what the loop does
+            var blocks = pcs.GroupBy(e => e.Key & ~0xFFu)
+                .Select(g => (Block: g.Key, Cycles: g.Aggregate(0ul, (sum, e) => sum + e.Cycles), Hottest: g.MaxBy(e => e.Cycles)))
+                .OrderByDescending(b => b.Cycles)
+                .Take(TopBlocks);
+
+            file.WriteLine();
+            file.WriteLine("Blocks of 256 bytes by cycles:");
+            foreach (var b in blocks)
+                file.WriteLine($"{Percent(b.Cycles, totalCycles),7} {b.Cycles,14}  ${b.Block:X6} {Region(machine, b.Block),-9} hottest ${b.Hottest.Key:X6} {Disassemble(machine, b.Hottest.Key, b.Hottest.Opcode)}");
+
+            file.WriteLine();
+            file.WriteLine("Instructions by cycles:");
+            foreach (var e in pcs.OrderByDescending(e => e.Cycles).Take(TopInstructions))
+                file.WriteLine($"{Percent(e.Cycles, totalCycles),7} {e.Cycles,14} {e.Count,12}  ${e.Key:X6} {e.Opcode:X4}  {Disassemble(machine, e.Key, e.Opcode)}");
+
+            // An opcode has no address, disassemble it where it took the most time
+            var hottestAt = new Dictionary<ushort, uint>();
+            foreach (var e in pcs.OrderByDescending(e => e.Cycles))
+                hottestAt.TryAdd(e.Opcode, e.Key);
+
+            file.WriteLine();
+            file.WriteLine("Opcodes by cycles:");
+            foreach (var e in opcodes.OrderByDescending(e => e.Cycles).Take(TopOpcodes))
+            {
+                string example = hottestAt.TryGetValue((ushort)e.Key, out uint pc) ? $"{Disassemble(machine, pc, (ushort)e.Key)} (at ${pc:X6})" : "";
+                file.WriteLine($"{Percent(e.Cycles, totalCycles),7} {e.Cycles,14} {e.Count,12}  {e.Key:X4}  {example}");
+            }
+        }
+
+        static string Percent(ulong value, ulong total) => total > 0 ? $"{100.0 * value / total:F2}%" : "-";
+
+        static string Region(Machine machine, uint addr)
+        {
+            var mem = machine.Mem;
+
+            if (addr < mem.RamSize) return "RAM";
+            if (addr >= mem.TosBase && addr < mem.TosBase + mem.TosSize) return "TOS";
+            if (addr >= 0xFA0000 && addr < 0xFC0000) return "Cartridge";
+            return "Other";
+        }
+
+        // Memory now, the code may have changed since it ran. Builds without a disassembler give the opcode.
+        static string Disassemble(Machine machine, uint addr, ushort opcode)
+        {
+            var (text, _) = machine.Cpu.Disassemble(addr, 250);
+            return string.IsNullOrEmpty(text) ? $"dc.w ${opcode:X4}" : text;
+        }
+    }
+}
@@ -50,6 +50,21 @@ namespace ASE
             Config = new Config();
             Config.LoadConfig(args);
 
+            if (ConfigOptions.RunninConfig.Headless)
+            {
+                // No SDL or Avalonia at all. Stdout only carries the JSON report (see Headless.WriteReport), every
+                // console line goes to stderr
+                Console.SetOut(Console.Error);
+
+                if (!string.IsNullOrEmpty(ConfigOptions.RunninConfig.FloppyImagePath))
+                {
+                    ASEMain.driveA.Insert(ConfigOptions.RunninConfig.FloppyImagePath, out string message);
+                    ColoredConsole.WriteLine(message);
+                }
+
+                Environment.Exit(Headless.Run());
+            }
+
             SDL.SDL_SetHint(SDL.SDL_HINT_MOUSE_FOCUS_CLICKTHROUGH, "1");
             SDL.SDL_SetHint(SDL.SDL_HINT_MAC_BACKGROUND_APP, "1");
             
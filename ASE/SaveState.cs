@@ -0,0 +1,216 @@
+﻿/*
+ *
+ * Machine save states
+ *
+ * Official repository 👉 https://github.com/thebitculture/ase
+ *
+ */
+
+using System.Security.Cryptography;
+using static ASE.Config;
+
+namespace ASE
+{
+    /// <summary>
+    /// Saves and restores the whole machine: CPU core and pending device events, RAM and I/O ports, MFP, YM2149,
+    /// WD1772, ACIA/IKBD and the video counter, in a single versioned blob.
+    /// </summary>
+    /// <remarks>Must be called from the thread of the machine between frames, see <see cref="Machine.RunAtFrameEnd"/>.
+    /// Loading writes over the buffers already allocated, so the memory mapped in the CPU stays valid. The
+    /// contents of the floppy images are not part of the state, the disks inserted must match. Every device section
+    /// carries its length and the blob ends with a SHA-1 of the rest, so a damaged file is turned down before
+    /// anything is restored.</remarks>
+    public static class SaveState
+    {
+        const uint Magic = 0x53455341;      // "ASES"
+        const int Version = 4;
+        const int HashSize = 20;
+        const int Sections = 6;             // Memory, MFP, YM2149, WD1772, ACIA, video counter
+
+        public static string QuickSavePath => Path.Combine(Config.GetAppDefaultConfigsFilePath(), "quicksave.ases");
+
+        /// <summary>
+        /// Captures the current state of <paramref name="machine"/>.
+        /// </summary>
+        public static byte[] Save(Machine machine)
+        {
+            int coreSize = machine.Cpu.SnapshotSize;
+            byte[] core = new byte[coreSize];
+            machine.Cpu.Serialize(core);
+
+            // Buffers are per call, machines on other threads can be saving at the same time
+            var stream = new MemoryStream();
+            using (var w = new BinaryWriter(stream, System.Text.Encoding.UTF8, leaveOpen: true))
+            {
+                w.Write(Magic);
+                w.Write(Version);
+                w.Write(machine.Mem.RamSize);
+                w.Write(SHA1.HashData(machine.Mem.ROM));
+
+                w.Write(coreSize);
+                w.Write(core, 0, coreSize);
+
+                WriteSection(w, machine.Mem.SaveState);
+                WriteSection(w, machine.Mfp.SaveState);
+                WriteSection(w, machine.Ym.SaveState);
+                WriteSection(w, machine.Fdc.SaveState);
+                WriteSection(w, machine.Acia.SaveState);
+                WriteSection(w, w => w.Write(machine.VideoCounter));
+
+                w.Write(SHA1.HashData(stream.GetBuffer().AsSpan(0, (int)stream.Length)));
+            }
+
+            return stream.ToArray();
+        }
+
+        // Length of the section, then the section
+        static void WriteSection(BinaryWriter w, Action<BinaryWriter> save)
+        {
+            long start = w.BaseStream.Position;
+            w.Write(0);
+            save(w);
+
+            long end = w.BaseStream.Position;
+            w.Seek((int)start, SeekOrigin.Begin);
+            w.Write((int)(end - start - 4));
+            w.Seek((int)end, SeekOrigin.Begin);
+        }
+
+        /// <summary>
+        /// Restores a state captured by <see cref="Save"/>.
+        /// </summary>
+        /// <returns>False if the state does not belong to this machine, with the reason in <paramref name="message"/>.
+        /// The running machine is left untouched in that case.</returns>
+        public static bool Load(Machine machine, byte[] state, out string message)
+        {
+            // Everything is checked before the first byte is restored
+            if (state.Length < HashSize ||
+                !SHA1.HashData(state.AsSpan(0, state.Length - HashSize)).AsSpan().SequenceEqual(state.AsSpan(state.Length - HashSize)))
+            {
+                message = "Save state is damaged or truncated";
+                return false;
+            }
+
+            int end = state.Length - HashSize;
+            var sections = new (int Offset, int Length)[Sections];
+            int coreOffset, coreSize;
+
+            try
+            {
+                using var r = new BinaryReader(new MemoryStream(state, 0, end, writable: false));
+
+                if (r.ReadUInt32() != Magic || r.ReadInt32() != Version)
+                {
+                    message = "Not a save state of this ASE version";
+                    return false;
+                }
+
+                if (r.ReadInt32() != machine.Mem.RamSize)
+                {
+                    message = "Save state taken with another RAM configuration";
+                    return false;
+                }
+
+                if (!r.ReadBytes(20).AsSpan().SequenceEqual(SHA1.HashData(machine.Mem.ROM)))
+                {
+                    message = "Save state taken with another TOS";
+                    return false;
+                }
+
+                coreSize = r.ReadInt32();
+                coreOffset = (int)r.BaseStream.Position;
+                if (coreSize <= 0 || coreSize > end - coreOffset)
+                {
+                    message = "Save state is truncated";
+                    return false;
+                }
+                r.BaseStream.Seek(coreSize, SeekOrigin.Current);
+
+                for (int i = 0; i < Sections; i++)
+                {
+                    int length = r.ReadInt32();
+                    int offset = (int)r.BaseStream.Position;
+                    if (length < 0 || length > end - offset)
+                    {
+                        message = "Save state is truncated";
+                        return false;
+                    }
+
+                    sections[i] = (offset, length);
+                    r.BaseStream.Seek(length, SeekOrigin.Current);
+                }
+
+                if (r.BaseStream.Position != end)
+                {
+                    message = "Save state is damaged or truncated";
+                    return false;
+                }
+
+                // Memory.LoadState takes the RAM and the I/O ports as they are, with their sizes in front
+                if (sections[0].Length != 8 + machine.Mem.RamSize + machine.Mem.Ports.Length)
+                {
+                    message = "Save state taken with another RAM configuration";
+                    return false;
+                }
+            }
+            catch (EndOfStreamException)
+            {
+                message = "Save state is truncated";
+                return false;
+            }
+
+            // The core checks its snapshot before it takes any of it
+            if (!machine.Cpu.Deserialize(state.AsSpan(coreOffset, coreSize)))
+            {
+                message = "Save state taken with another CPU core";
+                return false;
+            }
+
+            if (!machine.Mem.LoadState(Section(state, sections[0])))
+            {
+                // Not reached with the sizes checked above
+                message = "Save state taken with another RAM configuration";
+                return false;
+            }
+            machine.Mfp.LoadState(Section(state, sections[1]));
+            machine.Ym.LoadState(Section(state, sections[2]));
+            machine.Fdc.LoadState(Section(state, sections[3]));
+            machine.Acia.LoadState(Section(state, sections[4]));
+            machine.VideoCounter = Section(state, sections[5]).ReadUInt32();
+
+            // RAM and palette were replaced behind the write map
+            machine.Mem.PaletteVersion++;
+            machine.Renderer.InvalidateAll();
+
+            message = "State loaded";
+            return true;
+        }
+
+        static BinaryReader Section(byte[] state, (int Offset, int Length) section) =>
+            new BinaryReader(new MemoryStream(state, section.Offset, section.Length, writable: false));
+
+        public static void SaveToFile(Machine machine, string path)
+        {
+            File.WriteAllBytes(path, Save(machine));
+            ColoredConsole.WriteLine($"State saved to [[green]]{path}[[/green]]");
+        }
+
+        public static bool LoadFromFile(Machine machine, string path)
+        {
+            if (!File.Exists(path))
+            {
+                ColoredConsole.WriteLine($"[[red]]State file {path} not found[[/red]]");
+                return false;
+            }
+
+            if (!Load(machine, File.ReadAllBytes(path), out string message))
+            {
+                ColoredConsole.WriteLine($"[[red]]{message}: {path}[[/red]]");
+                return false;
+            }
+
+            ColoredConsole.WriteLine($"State loaded from [[green]]{path}[[/green]]");
+            return true;
+        }
+    }
+}
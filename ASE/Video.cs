@@ -19,7 +19,11 @@ namespace ASE
             row[x] = argb;
         }
 
-        public static class AtariStRenderer
+        /// <summary>
+        /// Converts the video RAM of one machine into frame buffers, keeping what it needs to skip the lines that
+        /// did not change.
+        /// </summary>
+        public sealed class AtariStRenderer
         {
             public enum StVideoMode
             {
@@ -50,19 +54,264 @@ namespace ASE
                 return argb;
             }
 
-            private static uint[] StPalTo8888()
+            readonly Machine _machine;
+
+            public AtariStRenderer(Machine machine)
             {
-                uint[] pal = new uint[16];
+                _machine = machine;
+                InvalidateAll();
+            }
+
+            readonly uint[] _pal = new uint[16];
+            uint _palVersion = uint.MaxValue;
+
+            private uint[] StPalTo8888()
+            {
+                // Only converted again after a write to the palette registers
+                if (_palVersion == _machine.Mem.PaletteVersion)
+                    return _pal;
+
                 int palCount = 16;
 
                 for (int i = 0; i < palCount; i++)
-                    pal[i] = StColorToArgb8888(ASEMain._mem.Read16((uint)(Memory.STPortAdress.ST_PALLETE + (i * 2))));
+                    _pal[i] = StColorToArgb8888(_machine.Mem.Read16((uint)(Memory.STPortAdress.ST_PALLETE + (i * 2))));
 
-                return pal;
+                _palVersion = _machine.Mem.PaletteVersion;
+                return _pal;
             }
 
+            const int VisibleLines = FrameRing.Lines;
+
+            // What a line of a frame buffer was converted from. Version is unique to every conversion.
+            struct LineKey
+            {
+                public uint Source;
+                public uint Palette;
+                public StVideoMode Mode;
+                public bool Valid;
+                public long Version;
+
+                public bool SameSource(in LineKey other) =>
+                    Valid && other.Valid && Source == other.Source && Palette == other.Palette && Mode == other.Mode;
+            }
+
+            // One set of line keys per buffer of the frame ring, plus the line shown in the previous frame
+            readonly LineKey[][] _lineKeys = { new LineKey[VisibleLines], new LineKey[VisibleLines], new LineKey[VisibleLines] };
+            readonly LineKey[] _lastKey = new LineKey[VisibleLines];
+
+            // Version at which a write to each 32 byte block of RAM was last seen in the CPU write map
+            long[] _blockWritten = Array.Empty<long>();
+            long _version;
+
+            // Lines of the frame in progress that differ from the previous frame, see TakeChangedRows
+            readonly ulong[] _changedRows = new ulong[FrameRing.RowWords];
+
+            /// <summary>
+            /// Forces every line to be converted again, after anything that changes RAM behind the write map
+            /// (power on, save state load, ...).
+            /// </summary>
+            public void InvalidateAll()
+            {
+                foreach (LineKey[] keys in _lineKeys)
+                    Array.Clear(keys);
+                Array.Clear(_lastKey);
+
+                _blockWritten = new long[_machine.Mem.RamSize / Moira.WriteBlockSize];
+            }
+
+            /// <summary>
+            /// Converts a visible line into the buffer of frame ring slot <paramref name="slot"/>, unless that buffer
+            /// already holds it: same video address, palette and mode, and no write to its video RAM since.
+            /// </summary>
+            /// <remarks>Writes are tracked per block rather than per line, so lines that move on screen (hardware
+            /// scrolling, page flipping) are still caught in the three buffers.</remarks>
+            public void RenderLine(int slot, uint[] buffer, uint StAddr, int line)
+            {
+                if (line == _rasterLine)
+                {
+                    FinishRasterLine(slot, buffer, StAddr, line);
+                    return;
+                }
+
+                StVideoMode mode = GetModeInfo(StVideoMode.Auto, out _, out _, out int planes, out int wordsPerLine);
+                int bytesPerLine = wordsPerLine * planes * 2;
+
+                long newest = LatestWrite(StAddr, bytesPerLine);
+
+                StPalTo8888();
+
+                var key = new LineKey { Source = StAddr, Palette = _palVersion, Mode = mode, Valid = true };
+                ref LineKey held = ref _lineKeys[slot][line];
+
+                if (!key.SameSource(held) || newest > held.Version)
+                {
+                    BlitStLineToBuffer(buffer, StAddr, 0, line, mode);
+                    key.Version = ++_version;
+                    held = key;
+                }
+
+                // Same contents as the previous frame only if nothing was written since the older conversion
+                ref LineKey last = ref _lastKey[line];
+                if (!held.SameSource(last) || newest > Math.Min(held.Version, last.Version))
+                    _changedRows[line >> 6] |= 1ul << (line & 63);
+
+                last = held;
+            }
+
+            // Newest write version of the blocks of a line, taking the pending bits from the CPU write map
+            long LatestWrite(uint addr, int size)
+            {
+                uint first = addr / Moira.WriteBlockSize;
+                uint last = (addr + (uint)size - 1) / Moira.WriteBlockSize;
+
+                // Outside RAM, always converted again
+                if (last >= _blockWritten.Length)
+                    return long.MaxValue;
+
+                long newest = 0;
+                for (uint block = first; block <= last; block++)
+                {
+                    if (_machine.Cpu.TakeWritten(block * Moira.WriteBlockSize, 1))
+                        _blockWritten[block] = ++_version;
+
+                    newest = Math.Max(newest, _blockWritten[block]);
+                }
+
+                return newest;
+            }
+
+            // -------------------- Raster --------------------
+
+            /*
+             * In raster mode a write to the palette or the resolution register splits the line on screen: the part
+             * the beam has already displayed is converted with the old values before the write lands. The beam is
+             * worked out from the CPU clock, so there is no work at all on the lines nobody writes to.
+             *
+             * Each scanline of the frame loop starts at a multiple of 512 cycles from the frame start (see
+             * Machine.RunFrame). The Shifter shows 16 low resolution pixels (8 bytes of video RAM, 32 pixels of the
+             * frame buffer) every 16 cycles, from cycle 56 to 376 of the line. The core reports the clock of a
+             * write at the bus access with precise timing (--cpucore=moira_accurate), otherwise at the start of the
+             * instruction, a chunk or two early.
+             */
+            const int FirstVisibleScanline = 63;
+            const int DisplayStart = 56;
+            const int CyclesPerChunk = 16;
+            const int ChunksPerLine = 20;
+            const int ChunkBytes = 8;
+            const int ChunkPixels = 32;
+
+            /// <summary>Splits lines at the palette and resolution writes made while they are displayed.</summary>
+            public bool Raster;
+
+            long _frameClock;
+
+            // Visible line converted up to _rasterChunk by the writes made during it, -1 if none
+            int _rasterLine = -1;
+            int _rasterChunk;
+
+            /// <summary>
+            /// Starts a frame whose first scanline begins at <paramref name="clock"/>.
+            /// </summary>
+            public void BeginFrame(long clock)
+            {
+                _frameClock = clock;
+                _rasterLine = -1;
+            }
 
-            public static void BlitStLineToBuffer(uint[] buffer, uint StAddr = 0, int scanlineSrc = 0, int scanlineDst = 0, StVideoMode mode = StVideoMode.Auto)
+            /// <summary>
+            /// Called by <see cref="Memory.Write8"/> before a write to the palette or the resolution: converts the
+            /// part of the current line the beam has gone past with the values still in place.
+            /// </summary>
+            public void BeforeShifterWrite()
+            {
+                if (!Raster || !_machine.RenderFrame)
+                    return;
+
+                long cycle = _machine.Cpu.Clock - _frameClock;
+                int line = (int)(cycle / Machine.CyclesPerScanline) - FirstVisibleScanline;
+                if (cycle < 0 || line < 0 || line >= VisibleLines)
+                    return;
+
+                int beam = (int)(cycle % Machine.CyclesPerScanline) - DisplayStart;
+                int chunk = beam <= 0 ? 0 : Math.Min(beam / CyclesPerChunk, ChunksPerLine);
+                if (chunk == 0)
+                    return;     // Still in the left border, the whole line takes the new value
+
+                if (line != _rasterLine)
+                {
+                    _rasterLine = line;
+                    _rasterChunk = 0;
+                }
+
+                if (chunk > _rasterChunk)
+                {
+                    ConvertChunks(_machine.Frames.Back, _machine.VideoCounter, line, _rasterChunk, chunk);
+                    _rasterChunk = chunk;
+                }
+            }
+
+            // The rest of a split line, at its end. The line is always reported as changed and converted again next time.
+            void FinishRasterLine(int slot, uint[] buffer, uint StAddr, int line)
+            {
+                if (_rasterChunk < ChunksPerLine)
+                    ConvertChunks(buffer, StAddr, line, _rasterChunk, ChunksPerLine);
+
+                _rasterLine = -1;
+                _lineKeys[slot][line] = default;
+                _lastKey[line] = default;
+                _changedRows[line >> 6] |= 1ul << (line & 63);
+            }
+
+            // Chunks [from, to) of a line, with the palette and the resolution of now
+            void ConvertChunks(uint[] buffer, uint StAddr, int line, int from, int to)
+            {
+                StVideoMode mode = GetModeInfo(StVideoMode.Auto, out _, out _, out int planes, out _);
+                uint[] pal = StPalTo8888();
+
+                int bytes = (to - from) * ChunkBytes;
+                Span<byte> copy = stackalloc byte[bytes];
+                ReadOnlySpan<byte> src = FetchVideo(StAddr + (uint)(from * ChunkBytes), copy);
+                Span<uint> dst = buffer.AsSpan(line * 640 + from * ChunkPixels, (to - from) * ChunkPixels);
+
+                // A chunk is 8 bytes: one group of 4 planes, two of 2, four of 1
+                int groups = bytes / (planes * 2);
+
+                switch (mode)
+                {
+                    case StVideoMode.Low320x200x16:
+                        PlanarToChunky.ConvertLow(src, pal, dst, groups);
+                        break;
+                    case StVideoMode.Med640x200x4:
+                        PlanarToChunky.ConvertMedium(src, pal, dst, groups);
+                        break;
+                    default:
+                        PlanarToChunky.ConvertHigh(src, pal, dst, groups);
+                        break;
+                }
+            }
+
+            // Video RAM at addr, in place when it lies in RAM, anything else is fetched through the bus into copy
+            ReadOnlySpan<byte> FetchVideo(uint addr, Span<byte> copy)
+            {
+                if (addr + copy.Length <= _machine.Mem.RamSize)
+                    return _machine.Mem.RAM.AsSpan((int)addr, copy.Length);
+
+                for (int i = 0; i < copy.Length; i++)
+                    copy[i] = _machine.Mem.Read8(addr + (uint)i);
+                return copy;
+            }
+
+            /// <summary>
+            /// Copies the lines changed in the frame just rendered to <paramref name="rows"/>, and starts a new frame.
+            /// </summary>
+            public void TakeChangedRows(Span<ulong> rows)
+            {
+                _changedRows.CopyTo(rows);
+                Array.Clear(_changedRows);
+            }
+
+
+            public void BlitStLineToBuffer(uint[] buffer, uint StAddr = 0, int scanlineSrc = 0, int scanlineDst = 0, StVideoMode mode = StVideoMode.Auto)
             {
                 mode = GetModeInfo(mode, out int w, out int h, out int planes, out int wordsPerLine);
                 
@@ -74,8 +323,8 @@ namespace ASE
 
                 if (StAddr == 0)
                 {
-                    uint vramBaseHigh = ASEMain._mem.Read8(Memory.STPortAdress.ST_SCRHIGHADDR);
-                    uint vramBaseMid = ASEMain._mem.Read8(Memory.STPortAdress.ST_SCRMIDADDR);
+                    uint vramBaseHigh = _machine.Mem.Read8(Memory.STPortAdress.ST_SCRHIGHADDR);
+                    uint vramBaseMid = _machine.Mem.Read8(Memory.STPortAdress.ST_SCRMIDADDR);
 
                     vramBase = (vramBaseHigh * 0x10000) + (vramBaseMid * 0x100);
                 }
@@ -87,26 +336,22 @@ namespace ASE
                 uint srcLine = vramBase + (uint)(scanlineSrc * bytesPerLine);
                 int dstPixel = scanlineDst * 640;
 
-                for (int group = 0; group < wordsPerLine; group++)
-                {
-                    ushort w0 = ReadBEWord(srcLine, group, planes, 0);
-                    ushort w1 = planes > 1 ? ReadBEWord(srcLine, group, planes, 1) : (ushort)0;
-                    ushort w2 = planes > 2 ? ReadBEWord(srcLine, group, planes, 2) : (ushort)0;
-                    ushort w3 = planes > 3 ? ReadBEWord(srcLine, group, planes, 3) : (ushort)0;
-
-                    for (int bit = 15; bit >= 0; bit--)
-                    {
-                        int idx = 0;
-                        idx |= ((w0 >> bit) & 1) << 0;
-                        idx |= ((w1 >> bit) & 1) << 1;
-                        idx |= ((w2 >> bit) & 1) << 2;
-                        idx |= ((w3 >> bit) & 1) << 3;
+                Span<byte> copy = stackalloc byte[bytesPerLine];
+                ReadOnlySpan<byte> line = FetchVideo(srcLine, copy);
 
-                        buffer[dstPixel++] = pal[idx];
+                Span<uint> dst = buffer.AsSpan(dstPixel, 640);
 
-                        if (mode == StVideoMode.Low320x200x16)
-                            buffer[dstPixel++] = pal[idx];
-                    }
+                switch (mode)
+                {
+                    case StVideoMode.Low320x200x16:
+                        PlanarToChunky.ConvertLow(line, pal, dst);
+                        break;
+                    case StVideoMode.Med640x200x4:
+                        PlanarToChunky.ConvertMedium(line, pal, dst);
+                        break;
+                    default:
+                        PlanarToChunky.ConvertHigh(line, pal, dst);
+                        break;
                 }
             }
 
@@ -136,16 +381,10 @@ namespace ASE
                 }
             }
 
-            private static unsafe ushort ReadBEWord(uint srcLine, int group, int planes, int plane)
-            {
-                uint offsetBytes = (uint)((group * planes + plane) * 2);
-                return BigEndian.Read16(srcLine + offsetBytes);
-            }
-
-            private static StVideoMode GetModeInfo(StVideoMode mode, out int w, out int h, out int planes, out int wordsPerLine)
+            private StVideoMode GetModeInfo(StVideoMode mode, out int w, out int h, out int planes, out int wordsPerLine)
             {
                 if(mode == StVideoMode.Auto)
-                    mode = ASEMain._mem.Read8(Memory.STPortAdress.ST_RES) == 0 ? AtariStRenderer.StVideoMode.Low320x200x16 : AtariStRenderer.StVideoMode.Med640x200x4;
+                    mode = _machine.Mem.Read8(Memory.STPortAdress.ST_RES) == 0 ? AtariStRenderer.StVideoMode.Low320x200x16 : AtariStRenderer.StVideoMode.Med640x200x4;
 
                 switch (mode)
                 {
@@ -8,30 +8,31 @@
  * 
  */
 
-using Avalonia.Threading;
 using static ASE.Config;
 
 namespace ASE
 {
-    public static class WD1772
+    public class WD1772
     {
+        readonly Machine _machine;
+
         // Registros
-        static byte commandRegister;
-        static byte trackRegister;
-        static byte sectorRegister;
-        static byte statusRegister;
-        static byte dataRegister;
-        static ushort dmaModeRegister;
-        static byte dmaSectorCount;
-        static uint dmaAddress;
-        static ushort prevMode;
-        private static bool multiSectorInProgress;
+        byte commandRegister;
+        byte trackRegister;
+        byte sectorRegister;
+        byte statusRegister;
+        byte dataRegister;
+        ushort dmaModeRegister;
+        byte dmaSectorCount;
+        uint dmaAddress;
+        ushort prevMode;
+        private bool multiSectorInProgress;
 
         // Estado
-        static int currentDrive = -1;
-        static int currentSide;
-        static int headTrack;
-        static bool dmaError;
+        int currentDrive = -1;
+        int currentSide;
+        int headTrack;
+        bool dmaError;
 
         // Bits Status
         private const byte STATUS_BUSY = 0x01;
@@ -51,6 +52,29 @@ namespace ASE
         private const int DMA_SECTOR_COUNT_REG = 4;
         private const int DMA_RW_DIRECTION = 8;
 
+        // Command timing in CPU cycles (8 MHz). Data moves to RAM at once, BUSY and the
+        // interrupt wait for the CPU.EventId.FdcCommand event at the end of the command.
+        private const int CYCLES_PER_MS = 8000;
+        private const int CYCLES_PER_DISK_BYTE = 256;     // 250 kbit/s MFM, 32 us per byte
+        private const int CYCLES_PER_TRACK = 6250 * CYCLES_PER_DISK_BYTE;   // One rotation at 300 rpm
+        private const int CYCLES_INDEX_PULSE = 4 * CYCLES_PER_MS;
+        private const int CYCLES_MIN_COMMAND = 256;
+        private static readonly int[] StepRateMs = { 6, 12, 2, 3 }; // Type I r1r0
+        long commandCycles;
+
+        // Turbo floppy: every command ends CYCLES_TURBO_COMMAND after it starts, no step, spin-up or rotation
+        // time. The interrupt and the DMA status work as usual. It stays off until the next reset once the
+        // program shows it cares about the timing: polling the status register in a tight loop between commands
+        // (index pulse) or asking for an interrupt on the index pulse. TOS reading it once per VBL is fine.
+        private const int CYCLES_TURBO_COMMAND = 256;
+        private const int TURBO_MAX_STATUS_POLLS = 32;
+        private const int CYCLES_TIGHT_POLL = 512;
+        bool turboSuspended;
+        int statusPolls;
+        long lastStatusRead;
+
+        bool TurboActive => ConfigOptions.RunninConfig.TurboFloppy && !turboSuspended;
+
         // Comandos
         private const byte CMD_RESTORE = 0x00;
         private const byte CMD_SEEK = 0x10;
@@ -64,7 +88,12 @@ namespace ASE
         private const byte CMD_WRITE_TRACK = 0xF0;
         private const byte CMD_FORCE_INTERRUPT = 0xD0;
 
-        public static void Reset()
+        public WD1772(Machine machine)
+        {
+            _machine = machine;
+        }
+
+        public void Reset()
         {
             commandRegister = 0;
             trackRegister = 0;
@@ -76,12 +105,55 @@ namespace ASE
             headTrack = 0;
             dmaSectorCount = 0;
             statusRegister = 0;
+            turboSuspended = false;
+            statusPolls = 0;
+
+            _machine.Cpu.CancelEvent((int)CPU.EventId.FdcCommand);
+            _machine.Mfp.SetGPIOBit(5, true);
+        }
+
+        public void SaveState(BinaryWriter w)
+        {
+            w.Write(commandRegister);
+            w.Write(trackRegister);
+            w.Write(sectorRegister);
+            w.Write(statusRegister);
+            w.Write(dataRegister);
+            w.Write(dmaModeRegister);
+            w.Write(dmaSectorCount);
+            w.Write(dmaAddress);
+            w.Write(prevMode);
+            w.Write(multiSectorInProgress);
+
+            w.Write(currentDrive);
+            w.Write(currentSide);
+            w.Write(headTrack);
+            w.Write(dmaError);
+            w.Write(commandCycles);
+        }
 
-            if (ASEMain._mfp != null) 
-                ASEMain._mfp.SetGPIOBit(5, true);
+        // A command in progress completes through its event, restored with the CPU
+        public void LoadState(BinaryReader r)
+        {
+            commandRegister = r.ReadByte();
+            trackRegister = r.ReadByte();
+            sectorRegister = r.ReadByte();
+            statusRegister = r.ReadByte();
+            dataRegister = r.ReadByte();
+            dmaModeRegister = r.ReadUInt16();
+            dmaSectorCount = r.ReadByte();
+            dmaAddress = r.ReadUInt32();
+            prevMode = r.ReadUInt16();
+            multiSectorInProgress = r.ReadBoolean();
+
+            currentDrive = r.ReadInt32();
+            currentSide = r.ReadInt32();
+            headTrack = r.ReadInt32();
+            dmaError = r.ReadBoolean();
+            commandCycles = r.ReadInt64();
         }
 
-        public static void WriteByte(uint address, byte value)
+        public void WriteByte(uint address, byte value)
         {
             switch (address)
             {
@@ -110,7 +182,7 @@ namespace ASE
             }
         }
 
-        public static void WriteWord(uint address, ushort value)
+        public void WriteWord(uint address, ushort value)
         {
             switch (address)
             {
@@ -140,12 +212,12 @@ namespace ASE
             WriteByte(address + 1, (byte)(value & 0xFF));
         }
 
-        public static byte ReadByte(uint address)
+        public byte ReadByte(uint address)
         {
             switch (address)
             {
                 case 0xFF8604: 
-                    return ASEMain._mem.Ports[address - Memory.PortsBase];
+                    return _machine.Mem.Ports[address - Memory.PortsBase];
                 case 0xFF8605: 
                     return ReadFromFDCOrSectorCount();
                 case 0xFF8606: 
@@ -159,11 +231,11 @@ namespace ASE
                 case 0xFF860D: 
                     return (byte)(dmaAddress & 0xFE);
                 default: 
-                    return ASEMain._mem.Ports[address - Memory.PortsBase];
+                    return _machine.Mem.Ports[address - Memory.PortsBase];
             }
         }
 
-        public static ushort ReadWord(uint address)
+        public ushort ReadWord(uint address)
         {
             switch (address)
             {
@@ -182,7 +254,7 @@ namespace ASE
             }
         }
 
-        private static void HandleDMAModeChange()
+        private void HandleDMAModeChange()
         {
             bool prevDir = (prevMode & 0x0100) != 0;
             bool newDir = (dmaModeRegister & 0x0100) != 0;
@@ -197,7 +269,7 @@ namespace ASE
             prevMode = dmaModeRegister;
         }
 
-        public static void SetDriveAndSide(int drive, int side)
+        public void SetDriveAndSide(int drive, int side)
         {
             if (currentDrive != drive || currentSide != side)
             {
@@ -206,7 +278,7 @@ namespace ASE
             }
         }
 
-        private static ushort GetDMAStatus()
+        private ushort GetDMAStatus()
         {
             ushort status = 0;
 
@@ -220,7 +292,7 @@ namespace ASE
             return status;
         }
 
-        private static void WriteToFDCOrSectorCount(byte value)
+        private void WriteToFDCOrSectorCount(byte value)
         {
             bool selectSectorCount = ((dmaModeRegister >> DMA_SECTOR_COUNT_REG) & 1) == 1;
 
@@ -253,7 +325,7 @@ namespace ASE
             }
         }
 
-        private static byte ReadFromFDCOrSectorCount()
+        private byte ReadFromFDCOrSectorCount()
         {
             bool selectSectorCount = ((dmaModeRegister >> DMA_SECTOR_COUNT_REG) & 1) == 1;
 
@@ -268,6 +340,8 @@ namespace ASE
             {
                 case 0: // STATUS REGISTER
                     ClearInterrupt();
+                    if (TurboActive && (statusRegister & STATUS_BUSY) == 0)
+                        CountStatusPoll();
                     return statusRegister;
                 case 1: 
                     return trackRegister;
@@ -280,7 +354,7 @@ namespace ASE
             }
         }
 
-        private static void UpdateTypeIStatus()
+        private void UpdateTypeIStatus()
         {
             statusRegister = 0;
             statusRegister |= 0x80; // Motor On (Type I)
@@ -288,18 +362,21 @@ namespace ASE
 
             if (headTrack == 0) 
                 statusRegister |= STATUS_TRACK0;
-            if (ASEMain.driveA.WriteProtected) 
+            if (_machine.DriveA.WriteProtected) 
                 statusRegister |= STATUS_WRITE_PROTECT;
-            if ((System.Environment.TickCount & 32) != 0) 
+            // Index pulse once per rotation, from the emulated clock so that runs replay the same
+            if (_machine.Cpu.Clock % CYCLES_PER_TRACK < CYCLES_INDEX_PULSE)
                 statusRegister |= 0x02; // Index Pulse
         }
 
-        private static void ExecuteCommand(byte command)
+        private void ExecuteCommand(byte command)
         {
             commandRegister = command;
             byte cmdType = (byte)(command & 0xF0);
 
             statusRegister = 0;
+            commandCycles = 0;
+            statusPolls = 0;
 
             if (currentDrive == -1) 
             { 
@@ -310,9 +387,8 @@ namespace ASE
             statusRegister |= STATUS_BUSY;
             ClearInterrupt();
 
-            Dispatcher.UIThread.InvokeAsync(() => { 
-                ASEMain.MainWindow.DriveLed(true); 
-            }, DispatcherPriority.Background);
+            // Only the interactive machine has a LED to show
+            _machine.DriveLed?.Invoke(true);
 
             // Type I (0xF0)
             byte hiNibble = (byte)(command & 0xF0);
@@ -370,7 +446,12 @@ namespace ASE
             // Type IV: force interrupr (0xD0-0xDF)
             if ((command & 0xF0) == CMD_FORCE_INTERRUPT)
             {
+                // Interrupt on index pulse (I2) only makes sense with real rotation time
+                if ((command & 0x04) != 0 && TurboActive)
+                    SuspendTurbo("interrupt on index pulse");
+
                 // Termina cualquier operación multi-sector en curso
+                _machine.Cpu.CancelEvent((int)CPU.EventId.FdcCommand);
                 statusRegister &= unchecked((byte)~STATUS_BUSY);
                 ClearInterrupt();
 
@@ -382,37 +463,71 @@ namespace ASE
             PulseInterrupt();
         }
 
-        private static void EndCommandOK()
+        private void EndCommandOK()
+        {
+            // BUSY stays up until the command time has elapsed
+            statusRegister |= STATUS_BUSY;
+            long cycles = TurboActive ? CYCLES_TURBO_COMMAND : Math.Max(commandCycles, CYCLES_MIN_COMMAND);
+            _machine.Cpu.ScheduleEvent(_machine.Cpu.Clock + cycles, (int)CPU.EventId.FdcCommand);
+        }
+
+        private void CountStatusPoll()
+        {
+            long now = _machine.Cpu.Clock;
+            statusPolls = now - lastStatusRead < CYCLES_TIGHT_POLL ? statusPolls + 1 : 0;
+            lastStatusRead = now;
+
+            if (statusPolls > TURBO_MAX_STATUS_POLLS)
+                SuspendTurbo("status register polled");
+        }
+
+        private void SuspendTurbo(string reason)
+        {
+            turboSuspended = true;
+            ColoredConsole.WriteLine($"Turbo floppy [[yellow]]off[[/yellow]] until reset: {reason}");
+        }
+
+        /// <summary>
+        /// CPU.EventId.FdcCommand handler, the command in progress has finished.
+        /// </summary>
+        public void OnCommandEvent(long cycle)
         {
             statusRegister &= unchecked((byte)~STATUS_BUSY);
             PulseInterrupt();
         }
 
-        private static void PulseInterrupt()
+        private int StepCycles(int steps)
         {
-            ASEMain._mfp.SetGPIOBit(5, false);
+            return Math.Abs(steps) * StepRateMs[commandRegister & 0x03] * CYCLES_PER_MS;
         }
 
-        private static void ClearInterrupt() 
+        private void PulseInterrupt()
+        {
+            _machine.Mfp.SetGPIOBit(5, false);
+        }
+
+        private void ClearInterrupt() 
         { 
-            ASEMain._mfp.SetGPIOBit(5, true); 
+            _machine.Mfp.SetGPIOBit(5, true); 
         }
 
-        private static void ExecuteRestore()
+        private void ExecuteRestore()
         {
+            commandCycles = StepCycles(headTrack);
             headTrack = 0;
             trackRegister = 0;
             UpdateTypeIStatus();
             statusRegister &= 0xFE;
         }
 
-        private static void ExecuteSeek()
+        private void ExecuteSeek()
         {
             // SEEK -> move head where Data Register indicates
+            commandCycles = StepCycles(dataRegister - headTrack);
             headTrack = dataRegister;
             trackRegister = dataRegister;
 
-            if (!ASEMain.driveA.HasDisk)
+            if (!_machine.DriveA.HasDisk)
             {
                 statusRegister |= STATUS_RECORD_NOT_FOUND;
                 return;
@@ -421,21 +536,21 @@ namespace ASE
             if (headTrack < 0) 
                 headTrack = 0;
 
-            if (headTrack > ASEMain.driveA.DiskConfig.Tracks - 1) 
-                headTrack = ASEMain.driveA.DiskConfig.Tracks - 1;
+            if (headTrack > _machine.DriveA.DiskConfig.Tracks - 1) 
+                headTrack = _machine.DriveA.DiskConfig.Tracks - 1;
 
             UpdateTypeIStatus();
             statusRegister &= 0xFE;
         }
 
-        private static void ExecuteReadSector()
+        private void ExecuteReadSector()
         {
             bool multi = (commandRegister & 0x10) != 0; // bit 4 = multiple
 
-            if (!ASEMain.driveA.HasDisk)
+            if (!_machine.DriveA.HasDisk)
                 return;
 
-            if (sectorRegister < 1 || sectorRegister > ASEMain.driveA.DiskConfig.SectorsPerTrack)
+            if (sectorRegister < 1 || sectorRegister > _machine.DriveA.DiskConfig.SectorsPerTrack)
             {
                 statusRegister |= STATUS_RECORD_NOT_FOUND;
                 return;
@@ -455,36 +570,33 @@ namespace ASE
             }
 
             // LBA lineal para wrap correcto
-            int spt = ASEMain.driveA.DiskConfig.SectorsPerTrack;
-            int sides = ASEMain.driveA.DiskConfig.Sides;
-            int bps = ASEMain.driveA.DiskConfig.SectorSize;
+            int spt = _machine.DriveA.DiskConfig.SectorsPerTrack;
+            int sides = _machine.DriveA.DiskConfig.Sides;
+            int bps = _machine.DriveA.DiskConfig.SectorSize;
 
             int lba = ((headTrack * sides) + currentSide) * spt + (sectorRegister - 1);
 
-            string dump = string.Empty;
-            for (int n = 0; n < sectorsToRead; n++, lba++)
-            {
-                int offset = lba * bps;
-                if (ASEMain.driveA.Data == null || offset + bps > ASEMain.driveA.Data.Length)
-                {
-                    statusRegister |= STATUS_RECORD_NOT_FOUND;
-                    dmaError = true;
-                    break;
-                }
+            // All the sectors present on the image go in one DMA block, the command time is charged once
+            int offset = lba * bps;
+            int available = Math.Max(0, (_machine.DriveA.Size - offset) / bps);
+            int sectorsRead = Math.Min(sectorsToRead, available);
 
-                for (int j = 0; j < bps; j++)
-                {
-                    ASEMain._mem.Write8(dmaAddress++, ASEMain.driveA.Data[offset + j]);
-                    dump += $"{ASEMain.driveA.Data[offset + j]:X2} ";
-                }
+            ReadOnlySpan<byte> data = sectorsRead > 0 ? _machine.DriveA.ReadSectors(offset, sectorsRead * bps) : ReadOnlySpan<byte>.Empty;
+            _machine.Mem.DmaWrite(dmaAddress, data);
+            dmaAddress += (uint)data.Length;
+            dmaSectorCount = (byte)Math.Max(0, dmaSectorCount - sectorsRead);
+            commandCycles += data.Length * CYCLES_PER_DISK_BYTE;
 
-                if (dmaSectorCount > 0) dmaSectorCount--;
+            if (sectorsRead < sectorsToRead)
+            {
+                statusRegister |= STATUS_RECORD_NOT_FOUND;
+                dmaError = true;
             }
 
             if (ConfigOptions.RunninConfig.DiskDump)
             {
                 Console.WriteLine($"READ SECTOR: DMA={dmaAddress:X6} T={headTrack} S={currentSide} R={sectorRegister} count={sectorsToRead}");
-                Console.Write(" Data loaded: " + dump);
+                Console.Write(" Data loaded: " + BitConverter.ToString(data.ToArray()).Replace('-', ' '));
                 Console.Write(Environment.NewLine);
             }
 
@@ -498,54 +610,56 @@ namespace ASE
             }
         }
 
-        private static void ExecuteWriteSector()
+        private void ExecuteWriteSector()
         {
-            if (ASEMain.driveA.WriteProtected) { statusRegister |= STATUS_WRITE_PROTECT; statusRegister &= 0xFE; return; }
+            if (_machine.DriveA.WriteProtected) { statusRegister |= STATUS_WRITE_PROTECT; statusRegister &= 0xFE; return; }
             int sectorsToWrite = ((commandRegister & 0x10) != 0) ? Math.Max((byte)1, dmaSectorCount) : 1;
             for (int i = 0; i < sectorsToWrite; i++)
             {
                 int offset = CalculateDiskOffset(headTrack, currentSide, sectorRegister + i);
-                if (ASEMain.driveA.Data != null && offset + ASEMain.driveA.DiskConfig.SectorSize <= ASEMain.driveA.Data.Length)
+                if (_machine.DriveA.HasDisk && offset + _machine.DriveA.DiskConfig.SectorSize <= _machine.DriveA.Size)
                 {
-                    for (int j = 0; j < ASEMain.driveA.DiskConfig.SectorSize; j++)
-                    {
-                        ASEMain.driveA.Data[offset + j] = ASEMain._mem.Read8(dmaAddress++);
-                    }
+                    _machine.Mem.DmaRead(dmaAddress, _machine.DriveA.WriteSectors(offset, _machine.DriveA.DiskConfig.SectorSize));
+                    dmaAddress += (uint)_machine.DriveA.DiskConfig.SectorSize;
                 }
                 if (dmaSectorCount > 0) dmaSectorCount--;
+                commandCycles += _machine.DriveA.DiskConfig.SectorSize * CYCLES_PER_DISK_BYTE;
             }
             statusRegister = 0x00;
         }
 
-        private static void ExecuteReadAddress()
+        private void ExecuteReadAddress()
         {
-            ASEMain._mem.Write8(dmaAddress++, (byte)headTrack);
-            ASEMain._mem.Write8(dmaAddress++, (byte)currentSide);
-            ASEMain._mem.Write8(dmaAddress++, sectorRegister);
-            ASEMain._mem.Write8(dmaAddress++, 2);
-            ASEMain._mem.Write8(dmaAddress++, 0);
-            ASEMain._mem.Write8(dmaAddress++, 0);
+            _machine.Mem.Write8(dmaAddress++, (byte)headTrack);
+            _machine.Mem.Write8(dmaAddress++, (byte)currentSide);
+            _machine.Mem.Write8(dmaAddress++, sectorRegister);
+            _machine.Mem.Write8(dmaAddress++, 2);
+            _machine.Mem.Write8(dmaAddress++, 0);
+            _machine.Mem.Write8(dmaAddress++, 0);
+            commandCycles = 6 * CYCLES_PER_DISK_BYTE;
             statusRegister = 0x00;
         }
 
-        private static void ExecuteReadTrack() 
+        private void ExecuteReadTrack() 
         { 
+            commandCycles = CYCLES_PER_TRACK;
             statusRegister = 0x00; 
         }
 
-        private static void ExecuteWriteTrack() 
+        private void ExecuteWriteTrack() 
         { 
+            commandCycles = CYCLES_PER_TRACK;
             statusRegister = 0x00; 
         }
 
-        private static int CalculateDiskOffset(int track, int side, int sector)
+        private int CalculateDiskOffset(int track, int side, int sector)
         {
-            return (track * ASEMain.driveA.DiskConfig.Sides * ASEMain.driveA.DiskConfig.SectorsPerTrack + side * ASEMain.driveA.DiskConfig.SectorsPerTrack + (sector - 1)) * ASEMain.driveA.DiskConfig.SectorSize;
+            return (track * _machine.DriveA.DiskConfig.Sides * _machine.DriveA.DiskConfig.SectorsPerTrack + side * _machine.DriveA.DiskConfig.SectorsPerTrack + (sector - 1)) * _machine.DriveA.DiskConfig.SectorSize;
         }
 
-        public static void SetWriteProtect(int drive, bool protect)
+        public void SetWriteProtect(int drive, bool protect)
         {
-            if (drive >= 0 && drive < 2) ASEMain.driveA.WriteProtected = protect;
+            if (drive >= 0 && drive < 2) _machine.DriveA.WriteProtected = protect;
         }
     }
 }
@@ -20,12 +20,28 @@ namespace ASE
 
         // Output configuration
         private readonly int _outputSampleRate;
-        private readonly float[] _hostBuffer;         // Temporary buffer to deliver to SDL
 
         // Registers
+        // _regs is what the CPU reads back, _synth the registers the generators are running with. Writes reach
+        // _synth through _writes at the chip tick they happened, see Render.
         private byte[] _regs = new byte[16];
+        private byte[] _synth = new byte[16];
         private int _selectedReg = 0;
 
+        private struct RegisterWrite
+        {
+            public long Cycle;
+            public byte Reg;
+            public byte Value;
+        }
+
+        private RegisterWrite[] _writes = new RegisterWrite[256];
+        private int _writeCount;
+
+        // CPU cycle of the next chip tick to render (32 CPU cycles per tick)
+        private const int CPU_CYCLES_PER_TICK = 32;
+        private long _synthClock;
+
         // Internal counters
         private int _cntA, _perA;
         private int _cntB, _perB;
@@ -46,9 +62,14 @@ namespace ASE
         private int _envPos;      // Global position in the envelope (0..95)
         private bool _envPhase;   // Not used directly, implicit in envPos
 
-        // Oversampling / Downsampling variables
+        // Downsampling: box filter over every output sample, in 16.16 fixed point chip ticks
         private uint _resamplePos;
         private uint _resampleStep;
+        private readonly uint _nominalStep;
+        private double _resampleAcc;   // Level integrated since the last output sample
+        private float _level;          // Mixer output after the last generator edge
+        private readonly float[] _block = new float[1024];
+        private int _blockCount;
 
         // Precalculated tables (Ported from Hatari sound.c)
         // 16 waveforms * 3 blocks * 32 steps
@@ -97,19 +118,27 @@ namespace ASE
         private float _lastSample = 0;
         private float _lastOut = 0;
 
-        // Thread-safe circular queue to pass audio to SDL
-        public System.Collections.Concurrent.ConcurrentQueue<float> AudioQueue
-            = new System.Collections.Concurrent.ConcurrentQueue<float>();
+        // Lock-free ring passing the samples to SDL, sized from the output sample rate
+        public readonly AudioRing Audio;
+
+        // Second output of the same samples while a capture runs, see Capture
+        public AudioRing? CaptureAudio;
+
+        public int SampleRate => _outputSampleRate;
 
         static YM2149()
         {
             BuildEnvelopeTables();
         }
 
-        public YM2149(int sampleRate = 44100, double chipClockHz = 2000000.0)
+        // Clock of the register writes, port A selects the floppy drive
+        readonly Machine _machine;
+
+        public YM2149(Machine machine, int sampleRate = 44100, double chipClockHz = 2000000.0)
         {
+            _machine = machine;
             _outputSampleRate = sampleRate;
-            _hostBuffer = new float[2048]; // Temporary buffer
+            Audio = AudioRing.ForSampleRate(sampleRate);
 
             // Calculate resampling step.
             // We use 32-bit fixed point (16.16) for precision without floats in the critical loop
@@ -117,10 +146,24 @@ namespace ASE
             // Multiplied by 65536 for fixed point.
             long ratio = ((long)YM_FREQ_INTERNAL << 16) / _outputSampleRate;
             _resampleStep = (uint)ratio;
+            _nominalStep = (uint)ratio;
 
             Reset();
         }
 
+        /// <summary>
+        /// Changes the output rate by a small factor, for the dynamic rate control of the frame pacing. Above 1
+        /// more samples are generated per emulated second, below 1 fewer.
+        /// </summary>
+        public void SetRateAdjust(double factor)
+        {
+            _resampleStep = (uint)Math.Round(_nominalStep / factor);
+
+            // The sample in progress is cut short if it already is past the new step
+            if (_resamplePos >= _resampleStep)
+                _resamplePos = _resampleStep - 1;
+        }
+
         private static void BuildEnvelopeTables()
         {
             _envWaves = new byte[16][];
@@ -161,13 +204,70 @@ namespace ASE
             _envShape = 0;
 
             _resamplePos = 0;
+            _resampleAcc = 0;
+            _blockCount = 0;
+            _writeCount = 0;
+            _synthClock = _machine.Cpu != null ? _machine.Cpu.Clock : 0;
 
             // Clear queue
-            while (AudioQueue.TryDequeue(out _)) { }
+            Audio.Clear();
 
             // Safe default values
             _regs[7] = 0xFF; // Mixer all off
+            Array.Copy(_regs, _synth, _regs.Length);
             UpdatePeriods();
+            _level = Mix();
+        }
+
+        public void SaveState(BinaryWriter w)
+        {
+            w.Write(_regs);
+            w.Write(_selectedReg);
+
+            w.Write(_cntA); w.Write(_cntB); w.Write(_cntC);
+            w.Write(_cntNoise); w.Write(_cntEnv);
+            w.Write(_outA); w.Write(_outB); w.Write(_outC); w.Write(_outNoise);
+            w.Write(_rng);
+
+            w.Write(_envShape);
+            w.Write(_envPos);
+            w.Write(_envPhase);
+
+            w.Write(_resamplePos);
+            w.Write(_resampleAcc);
+            w.Write(_lastSample);
+            w.Write(_lastOut);
+        }
+
+        // Saved at frame end, once Render has applied every write. Periods are derived from the registers,
+        // the resampling step from the host sample rate.
+        public void LoadState(BinaryReader r)
+        {
+            r.BaseStream.ReadExactly(_regs, 0, _regs.Length);
+            Array.Copy(_regs, _synth, _regs.Length);
+            _writeCount = 0;
+            _selectedReg = r.ReadInt32();
+
+            _cntA = r.ReadInt32(); _cntB = r.ReadInt32(); _cntC = r.ReadInt32();
+            _cntNoise = r.ReadInt32(); _cntEnv = r.ReadInt32();
+            _outA = r.ReadInt32(); _outB = r.ReadInt32(); _outC = r.ReadInt32(); _outNoise = r.ReadInt32();
+            _rng = r.ReadUInt32();
+
+            _envShape = r.ReadInt32();
+            _envPos = r.ReadInt32();
+            _envPhase = r.ReadBoolean();
+
+            _resamplePos = r.ReadUInt32();
+            _resampleAcc = r.ReadDouble();
+            _lastSample = r.ReadSingle();
+            _lastOut = r.ReadSingle();
+
+            _synthClock = _machine.Cpu.Clock;
+            _blockCount = 0;
+            UpdatePeriods();
+            _level = Mix();
+
+            Audio.Clear();
         }
 
         public void PSGRegisterSelect(byte val)
@@ -179,7 +279,26 @@ namespace ASE
         {
             _regs[_selectedReg] = val;
 
-            switch (_selectedReg)
+            // Ports act at once, sound registers are queued with the CPU clock for the next Render
+            if (_selectedReg == 14)
+            {
+                HandlePortA(val);
+                return;
+            }
+            if (_selectedReg == 15)
+                return;
+
+            if (_writeCount == _writes.Length)
+                Array.Resize(ref _writes, _writes.Length * 2);
+
+            _writes[_writeCount++] = new RegisterWrite { Cycle = _machine.Cpu.Clock, Reg = (byte)_selectedReg, Value = val };
+        }
+
+        private void ApplyWrite(int reg, byte val)
+        {
+            _synth[reg] = val;
+
+            switch (reg)
             {
                 case 0:
                 case 1:
@@ -197,10 +316,9 @@ namespace ASE
                     _envPos = 0;
                     _cntEnv = 0;
                     break;
-                case 14:
-                    HandlePortA(val);
-                    break;
             }
+
+            _level = Mix();
         }
 
         public byte PSGRegisterData()
@@ -210,147 +328,168 @@ namespace ASE
 
         private void UpdatePeriods()
         {
-            _perA = ((_regs[1] & 0x0F) << 8) | _regs[0];
-            _perB = ((_regs[3] & 0x0F) << 8) | _regs[2];
-            _perC = ((_regs[5] & 0x0F) << 8) | _regs[4];
-            _perNoise = _regs[6] & 0x1F;
-            _perEnv = (_regs[12] << 8) | _regs[11];
+            _perA = ((_synth[1] & 0x0F) << 8) | _synth[0];
+            _perB = ((_synth[3] & 0x0F) << 8) | _synth[2];
+            _perC = ((_synth[5] & 0x0F) << 8) | _synth[4];
+            _perNoise = _synth[6] & 0x1F;
+            _perEnv = (_synth[12] << 8) | _synth[11];
         }
 
         /// <summary>
-        /// Generates samples based on elapsed CPU cycles.
-        /// Must be called from the main loop.
+        /// Generates the samples up to CPU cycle <paramref name="untilCycle"/> in one block, applying every register
+        /// write at the chip tick it was done. Called once per frame from the main loop.
         /// </summary>
-        /// <param name="cpuCycles">Elapsed CPU cycles (8MHz).</param>
-        public void Sync(int cpuCycles)
+        /// <remarks>The generators are not stepped tick by tick: the renderer jumps from one edge (tone or noise
+        /// flip, envelope step) to the next and integrates the constant level in between into the current output
+        /// sample, so every sample is the exact average of the 250kHz signal over its period (box filter).</remarks>
+        /// <param name="untilCycle">CPU clock (8MHz) to render up to, usually the current one.</param>
+        public void Render(long untilCycle)
         {
-            // Convert CPU cycles (8MHz) to ticks of our internal clock (250kHz)
-            // 8MHz / 32 = 250kHz
-            // We accumulate the remainder for precision if necessary, but on ST 
-            // the ratio is exact (32 CPU cycles = 1 internal YM cycle)
-
-            int ymUpdates = cpuCycles / 32;
-
-            // Simplified "Weighted Average" Resampling Algorithm from Hatari.
-            // Generates at 250kHz and accumulate until completing a 44.1kHz sample.
+            // The CPU clock went back (reset), start over from here
+            if (untilCycle < _synthClock)
+                _synthClock = untilCycle;
 
-            for (int i = 0; i < ymUpdates; i++)
+            for (int i = 0; i < _writeCount; i++)
             {
-                StepInternal250k();
-
-                // _resamplePos is a 16.16 counter
-                // Advance by the ratio (approx 5.66 250k ticks for every 44.1k tick)
-                _resamplePos += 0x10000;
-
-                // If we have accumulated enough 250k ticks to output a sample
-                while (_resamplePos >= _resampleStep)
-                {
-                    _resamplePos -= _resampleStep;
-
-                    // In perfect resampling (weighted average N), we should average 
-                    // all intermediate samples. For performance and simplicity in C#,
-                    // we take the current sample (Nearest/Last). Since we are downsampling 
-                    // from 250k to 44k, aliasing is low. To improve, a 'totalSample' 
-                    // accumulator can be implemented and divided at the end.
-
-                    float sample = Mix();
-
-                    // DC Filter (High Pass) to center the wave at 0
-                    // alpha = approx 0.995 for 44kHz
-                    float outSample = sample - _lastSample + 0.995f * _lastOut;
-                    _lastSample = sample;
-                    _lastOut = outSample;
-
-                    AudioQueue.Enqueue(outSample);
+                ref RegisterWrite write = ref _writes[i];
 
-                    // Protection against infinite latency
-                    if (AudioQueue.Count > _outputSampleRate / 4)
-                        AudioQueue.TryDequeue(out _);
-                }
+                long cycle = Math.Clamp(write.Cycle, _synthClock, untilCycle);
+                RunTicks((int)((cycle - _synthClock) / CPU_CYCLES_PER_TICK));
+                ApplyWrite(write.Reg, write.Value);
             }
+            _writeCount = 0;
+
+            RunTicks((int)((untilCycle - _synthClock) / CPU_CYCLES_PER_TICK));
+            FlushBlock();
         }
 
-        // Simulates a cycle at 250kHz (Exact hardware)
-        private void StepInternal250k()
+        /// <summary>
+        /// Moves to <paramref name="untilCycle"/> applying the register writes but generating nothing, for when audio
+        /// is not needed (headless mode).
+        /// </summary>
+        public void Skip(long untilCycle)
         {
-            // -> Tones
-            // Period 0 is treated as 1.
-
-            // Channel A
-            _cntA++;
-            if (_cntA >= (_perA == 0 ? 1 : _perA))
-            {
-                _cntA = 0;
-                _outA ^= 1;
-            }
-
-            // Channel B
-            _cntB++;
-            if (_cntB >= (_perB == 0 ? 1 : _perB))
-            {
-                _cntB = 0;
-                _outB ^= 1;
-            }
+            for (int i = 0; i < _writeCount; i++)
+                ApplyWrite(_writes[i].Reg, _writes[i].Value);
+            _writeCount = 0;
 
-            // Channel C
-            _cntC++;
-            if (_cntC >= (_perC == 0 ? 1 : _perC))
-            {
-                _cntC = 0;
-                _outC ^= 1;
-            }
-
-            // -> Noise
-            // Noise runs at 125kHz (half of 250kHz).
-            // We use effective period * 2 to simulate it running at half speed.
+            _synthClock += Math.Max(0, untilCycle - _synthClock) / CPU_CYCLES_PER_TICK * CPU_CYCLES_PER_TICK;
+        }
 
-            _cntNoise++;
-            int effectiveNoisePer = (_perNoise == 0 ? 1 : _perNoise) * 2;
+        // Runs the generators for 'ticks' ticks of the 250kHz internal clock
+        private void RunTicks(int ticks)
+        {
+            _synthClock += (long)ticks * CPU_CYCLES_PER_TICK;
 
-            if (_cntNoise >= effectiveNoisePer)
+            while (ticks > 0)
             {
-                _cntNoise = 0;
-                // LFSR 17-bit (Poly: bit 17 and 14)
-                if ((_rng & 1) != 0)
+                // Period 0 is treated as 1. A counter already past a period lowered by a write flips on the next tick.
+                // Noise runs at 125kHz (half of 250kHz), so its effective period is doubled.
+                // The envelope advances one of its 32 steps every EP ticks: Master / (256 * EP) per cycle of 32
+                // steps is 8 * EP master cycles per step, and our clock runs at Master / 8.
+                int perA = _perA == 0 ? 1 : _perA;
+                int perB = _perB == 0 ? 1 : _perB;
+                int perC = _perC == 0 ? 1 : _perC;
+                int perNoise = (_perNoise == 0 ? 1 : _perNoise) * 2;
+                int perEnv = _perEnv == 0 ? 1 : _perEnv;
+
+                // Ticks to the next edge of any generator, the edge itself is the last tick of the run
+                int run = Math.Min(ticks, Math.Max(1, perA - _cntA));
+                run = Math.Min(run, Math.Max(1, perB - _cntB));
+                run = Math.Min(run, Math.Max(1, perC - _cntC));
+                run = Math.Min(run, Math.Max(1, perNoise - _cntNoise));
+                run = Math.Min(run, Math.Max(1, perEnv - _cntEnv));
+
+                Accumulate(run - 1);
+
+                _cntA += run; _cntB += run; _cntC += run; _cntNoise += run; _cntEnv += run;
+                bool edge = false;
+
+                // -> Tones
+                if (_cntA >= perA) { _cntA = 0; _outA ^= 1; edge = true; }
+                if (_cntB >= perB) { _cntB = 0; _outB ^= 1; edge = true; }
+                if (_cntC >= perC) { _cntC = 0; _outC ^= 1; edge = true; }
+
+                // -> Noise, LFSR 17-bit (Poly: bit 17 and 14)
+                if (_cntNoise >= perNoise)
                 {
-                    _rng = (_rng >> 1) ^ 0x12000;
-                    _outNoise = 1;
+                    _cntNoise = 0;
+                    if ((_rng & 1) != 0)
+                    {
+                        _rng = (_rng >> 1) ^ 0x12000;
+                        _outNoise = 1;
+                    }
+                    else
+                    {
+                        _rng >>= 1;
+                        _outNoise = 0;
+                    }
+                    edge = true;
                 }
-                else
+
+                // -> Envelope
+                if (_cntEnv >= perEnv)
                 {
-                    _rng >>= 1;
-                    _outNoise = 0;
+                    _cntEnv = 0;
+                    _envPos++;
+
+                    // Block 0 is attack/initial. Blocks 1 and 2 are the loop (sustain/alternate).
+                    if (_envPos >= 3 * 32)
+                        _envPos -= 2 * 32; // Return to start of block 1
+                    edge = true;
                 }
-            }
 
-            // -> Envelope
-            // The envelope frequency is Master / (256 * EP).
-            // Since an envelope cycle has 32 steps, each step occurs every
-            // (256 * EP) / 32 = 8 * EP Master clock cycles.
-            // Our internal clock (StepInternal250k) runs at 250kHz (Master / 8).
-            // Therefore, the number of ticks of our clock to advance a step is:
-            // (8 * EP) / 8 = EP.
+                if (edge)
+                    _level = Mix();
+
+                Accumulate(1);
+                ticks -= run;
+            }
+        }
 
-            _cntEnv++;
-            int effectiveEnvPer = (_perEnv == 0 ? 1 : _perEnv);
+        // Adds 'ticks' chip ticks at the current level to the output, emitting every sample completed
+        private void Accumulate(int ticks)
+        {
+            ulong t = (ulong)ticks << 16;
 
-            if (_cntEnv >= effectiveEnvPer)
+            while (_resamplePos + t >= _resampleStep)
             {
-                _cntEnv = 0;
-                _envPos++;
-
-                // Block 0 is attack/initial. Blocks 1 and 2 are the loop (sustain/alternate).
-                if (_envPos >= 3 * 32)
-                {
-                    _envPos -= 2 * 32; // Return to start of block 1
-                }
+                uint part = _resampleStep - _resamplePos;
+                _resampleAcc += (double)_level * part;
+                t -= part;
+                _resamplePos = 0;
+
+                float sample = (float)(_resampleAcc / _resampleStep);
+                _resampleAcc = 0;
+
+                // DC Filter (High Pass) to center the wave at 0
+                // alpha = approx 0.995 for 44kHz
+                float outSample = sample - _lastSample + 0.995f * _lastOut;
+                _lastSample = sample;
+                _lastOut = outSample;
+
+                _block[_blockCount++] = outSample;
+                if (_blockCount == _block.Length)
+                    FlushBlock();
             }
+
+            _resampleAcc += (double)_level * t;
+            _resamplePos += (uint)t;
+        }
+
+        // Hands the samples rendered so far to the audio output
+        private void FlushBlock()
+        {
+            // A full ring drops the block tail, the ring bounds the latency
+            Audio.Write(_block.AsSpan(0, _blockCount));
+            CaptureAudio?.Write(_block.AsSpan(0, _blockCount));
+            _blockCount = 0;
         }
 
         private float Mix()
         {
             // Register 7: Mixer (0 = Enable, 1 = Disable)
-            int mixer = _regs[7];
+            int mixer = _synth[7];
 
             // Get current envelope volume
             // The _envWaves table already has the 0-31 volume precalculated for the current position
@@ -383,7 +522,7 @@ namespace ASE
             if (output == 0) return 0; // Silence
 
             // Determine base volume
-            int regVol = _regs[8 + ch];
+            int regVol = _synth[8 + ch];
 
             // If bit 4 (M) is set, use envelope
             if ((regVol & 0x10) != 0)
@@ -404,34 +543,24 @@ namespace ASE
             int drive = -1;
             if ((val & 0x02) == 0) drive = 0;
             else if ((val & 0x04) == 0) drive = 1;
-            WD1772.SetDriveAndSide(drive, side);
+            _machine.Fdc.SetDriveAndSide(drive, side);
         }
 
         // *** SDL Callback ***
-        private static float[] _marshalBuf;
+        private static float _lastPlayed;
 
-        public static void AudioCallback(IntPtr userdata, IntPtr stream, int len)
+        public static unsafe void AudioCallback(IntPtr userdata, IntPtr stream, int len)
         {
-            int samplesNeeded = len / sizeof(float);
-            if (_marshalBuf == null || _marshalBuf.Length < samplesNeeded)
-                _marshalBuf = new float[samplesNeeded];
+            var output = new Span<float>((void*)stream, len / sizeof(float));
 
-            int read = 0;
-            while (read < samplesNeeded)
-            {
-                if (ASEMain._ym.AudioQueue.TryDequeue(out float s))
-                {
-                    _marshalBuf[read++] = s;
-                }
-                else
-                {
-                    // Underrun: Fill with last value (or silence)
-                    // To avoid clicks, repeating the last sample is usually better than abrupt 0
-                    _marshalBuf[read++] = ASEMain._ym._lastOut;
-                }
-            }
+            // Nothing to play until the machine is powered on
+            int read = ASEMain.Machine?.Ym.Audio.Read(output) ?? 0;
+            if (read > 0)
+                _lastPlayed = output[read - 1];
 
-            Marshal.Copy(_marshalBuf, 0, stream, samplesNeeded);
+            // Underrun: Fill with last value (or silence)
+            // To avoid clicks, repeating the last sample is usually better than abrupt 0
+            output.Slice(read).Fill(_lastPlayed);
         }
     }
 }
@@ -0,0 +1,331 @@
+#include "Blitter.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLITTER_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define BLITTER_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Longest span moved in one go, lines longer than this take several
+static constexpr int MaxSpan = 256;
+
+// -------------------- Kernels --------------------
+
+// Every destination word takes the 16 bits at 'skew' of the two source words it spans. Moving right (positive
+// source increment) the older word g[i] is the high half, moving left it is the low half.
+static void skewWords(const uint16_t* g, uint16_t* out, int n, int skew, bool reverse) {
+    const uint16_t* hi = reverse ? g + 1 : g;
+    const uint16_t* lo = reverse ? g : g + 1;
+    int i = 0;
+
+#if defined(BLITTER_SSE2)
+    __m128i left = _mm_cvtsi32_si128(16 - skew);
+    __m128i right = _mm_cvtsi32_si128(skew);
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi + i));
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_sll_epi16(h, left), _mm_srl_epi16(l, right)));
+    }
+#elif defined(BLITTER_NEON)
+    int16x8_t left = vdupq_n_s16((int16_t)(16 - skew));
+    int16x8_t right = vdupq_n_s16((int16_t)-skew);
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(out + i, vorrq_u16(vshlq_u16(vld1q_u16(hi + i), left), vshlq_u16(vld1q_u16(lo + i), right)));
+#endif
+
+    for (; i < n; i++)
+        out[i] = (uint16_t)(((uint32_t)hi[i] << (16 - skew)) | (lo[i] >> skew));
+}
+
+// The 16 logic ops as their truth table: bit 0 is the result for S and D, bit 1 for S and not D, bit 2 for
+// not S and D, bit 3 for neither. The result lands inside 'mask', the rest of the word keeps D.
+static void combine(const uint16_t* s, const uint16_t* d, uint16_t* out, int n, uint8_t op, uint16_t mask) {
+    int i = 0;
+
+#if defined(BLITTER_SSE2)
+    const __m128i ones = _mm_set1_epi16(-1);
+    const __m128i k1 = (op & 1) ? ones : _mm_setzero_si128();
+    const __m128i k2 = (op & 2) ? ones : _mm_setzero_si128();
+    const __m128i k4 = (op & 4) ? ones : _mm_setzero_si128();
+    const __m128i k8 = (op & 8) ? ones : _mm_setzero_si128();
+    const __m128i m = _mm_set1_epi16((short)mask);
+    for (; i + 8 <= n; i += 8) {
+        __m128i vs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i vd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+        __m128i r = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_and_si128(vs, vd), k1), _mm_and_si128(_mm_andnot_si128(vd, vs), k2)),
+            _mm_or_si128(_mm_and_si128(_mm_andnot_si128(vs, vd), k4), _mm_and_si128(_mm_xor_si128(_mm_or_si128(vs, vd), ones), k8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_and_si128(r, m), _mm_andnot_si128(m, vd)));
+    }
+#elif defined(BLITTER_NEON)
+    const uint16x8_t k1 = vdupq_n_u16((op & 1) ? 0xFFFF : 0);
+    const uint16x8_t k2 = vdupq_n_u16((op & 2) ? 0xFFFF : 0);
+    const uint16x8_t k4 = vdupq_n_u16((op & 4) ? 0xFFFF : 0);
+    const uint16x8_t k8 = vdupq_n_u16((op & 8) ? 0xFFFF : 0);
+    const uint16x8_t m = vdupq_n_u16(mask);
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t vs = vld1q_u16(s + i);
+        uint16x8_t vd = vld1q_u16(d + i);
+        uint16x8_t r = vorrq_u16(
+            vorrq_u16(vandq_u16(vandq_u16(vs, vd), k1), vandq_u16(vbicq_u16(vs, vd), k2)),
+            vorrq_u16(vandq_u16(vbicq_u16(vd, vs), k4), vandq_u16(vmvnq_u16(vorrq_u16(vs, vd)), k8)));
+        vst1q_u16(out + i, vbslq_u16(m, r, vd));
+    }
+#endif
+
+    for (; i < n; i++) {
+        uint16_t vs = s[i], vd = d[i];
+        uint16_t r = (uint16_t)(((op & 1) ? (vs & vd) : 0) | ((op & 2) ? (vs & ~vd) : 0) |
+            ((op & 4) ? (~vs & vd) : 0) | ((op & 8) ? (~vs & ~vd) : 0));
+        out[i] = (uint16_t)((vd & ~mask) | (r & mask));
+    }
+}
+
+// -------------------- Registers --------------------
+
+void Blitter::reset() {
+    regs = {};
+}
+
+bool Blitter::read16(uint32_t offset, uint16_t& v) const {
+    offset &= ~1u;
+    if (offset >= RegisterSize) {
+        v = 0xFFFF;
+        return false;
+    }
+
+    if (offset < 0x20) {
+        v = regs.halftone[offset >> 1];
+        return true;
+    }
+
+    switch (offset) {
+        case 0x20: v = (uint16_t)regs.srcXInc; break;
+        case 0x22: v = (uint16_t)regs.srcYInc; break;
+        case 0x24: v = (uint16_t)(regs.srcAddr >> 16); break;
+        case 0x26: v = (uint16_t)regs.srcAddr; break;
+        case 0x28: v = regs.endMask[0]; break;
+        case 0x2A: v = regs.endMask[1]; break;
+        case 0x2C: v = regs.endMask[2]; break;
+        case 0x2E: v = (uint16_t)regs.dstXInc; break;
+        case 0x30: v = (uint16_t)regs.dstYInc; break;
+        case 0x32: v = (uint16_t)(regs.dstAddr >> 16); break;
+        case 0x34: v = (uint16_t)regs.dstAddr; break;
+        case 0x36: v = regs.xCount; break;
+        case 0x38: v = regs.yCount; break;
+        case 0x3A: v = (uint16_t)((regs.hop << 8) | regs.op); break;
+        default:   v = (uint16_t)((regs.ctrl << 8) | regs.skew); break;
+    }
+    return true;
+}
+
+bool Blitter::read8(uint32_t offset, uint8_t& v) const {
+    uint16_t word;
+    bool ok = read16(offset, word);
+    v = (uint8_t)((offset & 1) ? word : word >> 8);
+    return ok;
+}
+
+bool Blitter::write16(uint32_t offset, uint16_t v) {
+    offset &= ~1u;
+    if (offset >= RegisterSize) return false;
+
+    if (offset < 0x20) {
+        regs.halftone[offset >> 1] = v;
+        return true;
+    }
+
+    // Increments and addresses are even
+    switch (offset) {
+        case 0x20: regs.srcXInc = (int16_t)(v & 0xFFFE); break;
+        case 0x22: regs.srcYInc = (int16_t)(v & 0xFFFE); break;
+        case 0x24: regs.srcAddr = ((uint32_t)(v & 0xFF) << 16) | (regs.srcAddr & 0xFFFF); break;
+        case 0x26: regs.srcAddr = (regs.srcAddr & 0xFF0000) | (v & 0xFFFE); break;
+        case 0x28: regs.endMask[0] = v; break;
+        case 0x2A: regs.endMask[1] = v; break;
+        case 0x2C: regs.endMask[2] = v; break;
+        case 0x2E: regs.dstXInc = (int16_t)(v & 0xFFFE); break;
+        case 0x30: regs.dstYInc = (int16_t)(v & 0xFFFE); break;
+        case 0x32: regs.dstAddr = ((uint32_t)(v & 0xFF) << 16) | (regs.dstAddr & 0xFFFF); break;
+        case 0x34: regs.dstAddr = (regs.dstAddr & 0xFF0000) | (v & 0xFFFE); break;
+        case 0x36: regs.xCount = regs.xCountReload = v; break;
+        case 0x38: regs.yCount = v; break;
+        case 0x3A:
+            regs.hop = (uint8_t)((v >> 8) & 3);
+            regs.op = (uint8_t)(v & 15);
+            break;
+        default: {
+            regs.skew = (uint8_t)(v & (SkewFxsr | SkewNfsr | 15));
+
+            // Writing BUSY while a blit runs does nothing, programs in blit mode poll it that way to
+            // restart the blitter. A blit with no lines does not start.
+            uint8_t ctrl = (uint8_t)(v >> 8);
+            bool start = (ctrl & CtrlBusy) && !busy() && regs.yCount != 0;
+            regs.ctrl = (uint8_t)((ctrl & (CtrlHog | CtrlSmudge | 15)) | (regs.ctrl & CtrlBusy));
+            if (start) regs.ctrl |= CtrlBusy;
+            break;
+        }
+    }
+    return true;
+}
+
+bool Blitter::write8(uint32_t offset, uint8_t v) {
+    uint16_t word;
+    if (!read16(offset, word)) return false;
+
+    word = (offset & 1) ? (uint16_t)((word & 0xFF00) | v) : (uint16_t)((word & 0x00FF) | (v << 8));
+    return write16(offset, word);
+}
+
+// -------------------- Blit --------------------
+
+// S only changes the result of the ops where the truth table differs between S and not S (not 0, 5, 10 or 15),
+// D of those where it differs between D and not D
+bool Blitter::usesSource() const {
+    bool opUsesSource = (regs.op >> 2) != (regs.op & 3);
+    return opUsesSource && ((regs.hop & 2) || ((regs.hop & 1) && (regs.ctrl & CtrlSmudge)));
+}
+
+bool Blitter::usesDestination() const {
+    return ((regs.op ^ (regs.op >> 1)) & 5) != 0;
+}
+
+int Blitter::run(int accesses) {
+    int made = 0;
+
+    while (busy() && made < accesses) {
+        int lineWords = regs.xCountReload ? regs.xCountReload : 65536;
+        int left = regs.xCount ? regs.xCount : 65536;
+
+        // Words that fit in the accesses left, mid line words take one access per fetch, read and write
+        int perWord = 1 + usesSource() + (usesDestination() || regs.endMask[1] != 0xFFFF);
+        int count = std::clamp((accesses - made) / perWord, 1, std::min(left, MaxSpan));
+        if (count > 1 && !spanInOrder(count)) count = 1;
+
+        made += runSpan(lineWords - left, count, lineWords);
+    }
+    return made;
+}
+
+// A span reads all its words before writing any, while the blitter reads the source one word ahead of the
+// write. Both orders give the same result unless the span writes a word it reads afterwards: the source and
+// the destination overlap with the destination ahead in the direction of the move, or the destination does
+// not move. Those spans go one word at a time instead.
+bool Blitter::spanInOrder(int count) const {
+    if (regs.dstXInc == 0) return false;
+    if (!usesSource()) return true;
+
+    // Same increment and the source not behind the destination, every word is read before it is written
+    int64_t ahead = (int64_t)regs.srcAddr - regs.dstAddr;
+    if (regs.srcXInc == regs.dstXInc && (ahead == 0 || (ahead > 0) == (regs.dstXInc > 0))) return true;
+
+    int64_t srcFirst = regs.srcAddr, srcLast = srcFirst + (int64_t)count * regs.srcXInc;
+    int64_t dstFirst = regs.dstAddr, dstLast = dstFirst + (int64_t)(count - 1) * regs.dstXInc;
+    return std::max(srcFirst, srcLast) + 1 < std::min(dstFirst, dstLast) ||
+        std::max(dstFirst, dstLast) + 1 < std::min(srcFirst, srcLast);
+}
+
+int Blitter::runSpan(int pos, int count, int lineWords) {
+    bool first = pos == 0;
+    bool last = pos + count == lineWords;
+    int accesses = 0;
+
+    uint16_t g[MaxSpan + 1];
+    uint16_t s[MaxSpan];
+    uint16_t d[MaxSpan];
+
+    // Source: g[0] is the word already in the buffer and g[i + 1] the one shifted in for word i. FXSR fetches one
+    // more word first, into g[0], and NFSR shifts nothing in for the last word of the line. The source address
+    // moves by the X increment after each fetch but the last of the line, which takes the Y increment instead
+    // (also when NFSR skips it).
+    bool source = usesSource();
+    if (source) {
+        bool fxsr = first && (regs.skew & SkewFxsr);
+        bool nfsr = last && (regs.skew & SkewNfsr);
+        int fetches = count + fxsr - nfsr;
+
+        g[0] = regs.buffer;
+        bus.readWords(regs.srcAddr, regs.srcXInc, fetches, fxsr ? g : g + 1);
+        if (nfsr) g[count] = 0;
+        regs.buffer = g[count];
+
+        int32_t move = fetches * regs.srcXInc;
+        if (last) move += regs.srcYInc - (nfsr ? 0 : regs.srcXInc);
+        regs.srcAddr = (uint32_t)(regs.srcAddr + move) & 0xFFFFFE;
+        accesses += fetches;
+
+        skewWords(g, s, count, regs.skew & 15, regs.srcXInc < 0);
+    }
+
+    // Halftone: the word of the current line, or with SMUDGE the one picked by the low 4 bits of the source
+    uint16_t halftone = regs.halftone[regs.ctrl & 15];
+    bool smudge = source && (regs.ctrl & CtrlSmudge);
+    switch (regs.hop) {
+        case 0:
+            std::fill(s, s + count, (uint16_t)0xFFFF);
+            break;
+        case 1:
+            if (smudge) {
+                for (int i = 0; i < count; i++) s[i] = regs.halftone[s[i] & 15];
+            } else {
+                std::fill(s, s + count, halftone);
+            }
+            break;
+        case 2:
+            if (!source) std::fill(s, s + count, (uint16_t)0);
+            break;
+        default:
+            if (!source) {
+                std::fill(s, s + count, (uint16_t)0);
+            } else if (smudge) {
+                for (int i = 0; i < count; i++) s[i] &= regs.halftone[s[i] & 15];
+            } else {
+                for (int i = 0; i < count; i++) s[i] &= halftone;
+            }
+            break;
+    }
+
+    // End masks: the first word of a line takes mask 1, the last mask 3 (mask 1 alone for one word lines)
+    uint16_t firstMask = regs.endMask[0];
+    uint16_t lastMask = lineWords == 1 ? regs.endMask[0] : regs.endMask[2];
+    int from = first ? 1 : 0;
+    int to = last && count > from ? count - 1 : count;
+
+    // Each part reads the destination only when the result depends on it
+    auto part = [&](int at, int n, uint16_t mask) {
+        if (usesDestination() || mask != 0xFFFF) {
+            bus.readWords(regs.dstAddr + (uint32_t)(at * regs.dstXInc), regs.dstXInc, n, d + at);
+            accesses += n;
+        } else {
+            std::fill(d + at, d + at + n, (uint16_t)0);
+        }
+        combine(s + at, d + at, d + at, n, regs.op, mask);
+    };
+
+    if (first) part(0, 1, firstMask);
+    if (to > from) part(from, to - from, regs.endMask[1]);
+    if (to < count) part(to, 1, lastMask);
+
+    bus.writeWords(regs.dstAddr, regs.dstXInc, count, d);
+    accesses += count;
+
+    int32_t move = count * regs.dstXInc;
+    if (last) move += regs.dstYInc - regs.dstXInc;
+    regs.dstAddr = (uint32_t)(regs.dstAddr + move) & 0xFFFFFE;
+
+    // Counters, the line number follows the direction of the destination
+    if (!last) {
+        regs.xCount = (uint16_t)(lineWords - pos - count);
+        return accesses;
+    }
+
+    regs.xCount = regs.xCountReload;
+    int step = regs.dstYInc < 0 ? -1 : 1;
+    regs.ctrl = (uint8_t)((regs.ctrl & 0xF0) | ((regs.ctrl + step) & 15));
+    if (--regs.yCount == 0) regs.ctrl &= (uint8_t)~CtrlBusy;
+    return accesses;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+// BLiTTER of the Mega ST and the STE, registers at $FF8A00-$FF8A3D. The host maps the register page,
+// services the accesses through the read/write functions below and gives the blitter bus time with run(),
+// which moves whole spans of a line at a time: the source and destination words of a span are fetched
+// through the Bus, skewed, combined with the halftone and the logic op with SIMD, and stored back.
+class Blitter {
+public:
+    // Memory seen by the blitter, 'count' words from 'addr' every 'step' bytes, in host byte order
+    class Bus {
+    public:
+        virtual void readWords(uint32_t addr, int32_t step, int count, uint16_t* out) = 0;
+        virtual void writeWords(uint32_t addr, int32_t step, int count, const uint16_t* in) = 0;
+
+    protected:
+        ~Bus() = default;
+    };
+
+    // Registers plus the internal state of a blit in progress, saved as is in the core snapshot
+    struct State {
+        uint16_t halftone[16];      // $00-$1E
+        int16_t  srcXInc;           // $20
+        int16_t  srcYInc;           // $22
+        uint32_t srcAddr;           // $24
+        uint16_t endMask[3];        // $28, $2A, $2C
+        int16_t  dstXInc;           // $2E
+        int16_t  dstYInc;           // $30
+        uint32_t dstAddr;           // $32
+        uint16_t xCount;            // $36, words left in the line while busy
+        uint16_t yCount;            // $38, lines left
+        uint8_t  hop;               // $3A
+        uint8_t  op;                // $3B
+        uint8_t  ctrl;              // $3C
+        uint8_t  skew;              // $3D
+        uint16_t xCountReload;      // Last value written to $36, reloaded at the end of each line
+        uint16_t buffer;            // Last source word shifted in, carried over to the next span
+    };
+
+    static constexpr uint32_t RegisterSize = 0x3E;
+
+    static constexpr uint8_t CtrlBusy = 0x80;
+    static constexpr uint8_t CtrlHog = 0x40;
+    static constexpr uint8_t CtrlSmudge = 0x20;
+    static constexpr uint8_t SkewFxsr = 0x80;
+    static constexpr uint8_t SkewNfsr = 0x40;
+
+    explicit Blitter(Bus& bus) : bus(bus) { reset(); }
+
+    void reset();
+
+    bool busy() const { return (regs.ctrl & CtrlBusy) != 0; }
+    bool hog() const { return (regs.ctrl & CtrlHog) != 0; }
+
+    // Register access, 'offset' from the start of the registers. False past the last register, which the
+    // host turns into a bus error. Writing the BUSY bit starts a blit, see busy().
+    bool read8(uint32_t offset, uint8_t& v) const;
+    bool read16(uint32_t offset, uint16_t& v) const;
+    bool write8(uint32_t offset, uint8_t v);
+    bool write16(uint32_t offset, uint16_t v);
+
+    // Runs the blit in progress for up to 'accesses' bus accesses (at least one word is moved) and returns
+    // the accesses made, 4 cycles each. Clears BUSY when the last line is done.
+    int run(int accesses);
+
+    State regs;
+
+private:
+    Bus& bus;
+
+    bool usesSource() const;
+    bool usesDestination() const;
+    bool spanInOrder(int count) const;
+
+    // One span of the current line, 'count' words from word 'pos'
+    int runSpan(int pos, int count, int lineWords);
+};
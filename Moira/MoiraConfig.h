@@ -7,6 +7,11 @@
 
 #pragma once
 
+/* ASE: the settings below marked with #ifndef can be overridden from CMake to build
+ * other profiles of the library (moira_fast, moira_accurate, moira_static), see
+ * CMakeLists.txt. The values here are the ones of the default 'moira' library.
+ */
+
 /* Set to true to enable precise timing mode (68000 and 68010 only).
  *
  * When disabled, Moira calls the 'sync' function at the end of each instruction,
@@ -19,7 +24,9 @@
  *
  * Enable to improve accuracy, disable it to enhance performance.
  */
+#ifndef MOIRA_PRECISE_TIMING
 #define MOIRA_PRECISE_TIMING false
+#endif
 
 /* Set to true to implement the CPU interface as virtual functions.
  *
@@ -32,7 +39,9 @@
  *
  * Enable to adhere to the standard OOP paradigm, disable to gain speed.
  */
+#ifndef MOIRA_VIRTUAL_API
 #define MOIRA_VIRTUAL_API true
+#endif
 
 /* Set to true to enable address error checking.
  *
@@ -41,7 +50,9 @@
  *
  * Enable to improve accuracy, disable to gain speed.
  */
+#ifndef MOIRA_EMULATE_ADDRESS_ERROR
 #define MOIRA_EMULATE_ADDRESS_ERROR true
+#endif
 
 /* Set to true to emulate function code pins FC0 - FC2.
  *
@@ -51,7 +62,9 @@
  *
  * Enable to improve accuracy, disable to gain speed.
  */
+#ifndef MOIRA_EMULATE_FC
 #define MOIRA_EMULATE_FC true
+#endif
 
 /* Set to true to enable the disassembler.
  *
@@ -59,7 +72,9 @@
  *
  * Disable to save space.
  */
+#ifndef MOIRA_ENABLE_DASM
 #define MOIRA_ENABLE_DASM true
+#endif
 
 /* Set to true to build the InstrInfo lookup table.
  *
@@ -71,7 +86,9 @@
  *
  * Disable to save space.
  */
+#ifndef MOIRA_BUILD_INSTR_INFO_TABLE
 #define MOIRA_BUILD_INSTR_INFO_TABLE true
+#endif
 
 /* Enables Musashi compatibility mode.
  *
@@ -2,90 +2,812 @@
 #include "Moira_dotnet.h"
 
 #include "Moira.h"
+#include "Blitter.h"
 
-#if MOIRA_VIRTUAL_API != true
-#error "This wrapper requires MOIRA_VIRTUAL_API == true"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+// With MOIRA_VIRTUAL_API the bus functions below override Moira's virtual API. Without it,
+// Moira only declares them and the definitions after the class bind them statically
+// to MoiraHost, so every access and sync is a direct call (inlined across TUs with IPO).
+#if MOIRA_VIRTUAL_API == true
+#define HOST_OVERRIDE override
+#else
+#define HOST_OVERRIDE
 #endif
 
-class MoiraHost : public moira::Moira {
+class MoiraHost final : public moira::Moira, private Blitter::Bus {
 private:
     moira_callbacks cb;
-    
-    // Campos para manejar el bus error pendiente
+
+    // Handler sets for accesses that are not serviced from a native buffer, always called
+    // through the _ex signatures. Slot 0 forwards to the host callbacks, slot 1 raises a bus
+    // error, the rest are registered with moira_map_device(_ex). Plain handler sets are
+    // wrapped by the legacy* adapters, which report moira_triggerBusError as a fault status.
+    static constexpr int DevHost = 0;
+    static constexpr int DevBusError = 1;
+    static constexpr int MaxDevices = 32;
+
+    struct Device {
+        moira_device_ex fn;
+        moira_device legacy;
+        MoiraHost* host;
+    };
+
+    Device devices[MaxDevices];
+    int deviceCount;
+
+    // Page table over the 24-bit address space, 256 bytes per page.
+    // 'read'/'write' point at the native buffer for the page (or NULL), otherwise
+    // the access goes to devices[readDev/writeDev].
+    static constexpr int PageShift = 8;
+    static constexpr uint32_t PageSize = 1u << PageShift;
+    static constexpr uint32_t PageMask = PageSize - 1;
+    static constexpr int PageCount = 1 << (24 - PageShift);
+
+    struct Page {
+        uint8_t* read;
+        uint8_t* write;
+        uint8_t readDev;
+        uint8_t writeDev;
+    };
+
+    Page pages[PageCount];
+
+    // Write map (moira_get_write_map): one byte per page, bit n is set by any write to bytes
+    // n * 32 to n * 32 + 31 of a native buffer. Cleared by the host.
+    static constexpr int BlockShift = 5;
+
+    mutable uint8_t writeMap[PageCount];
+
+    void markWritten(uint32_t addr) const {
+        writeMap[addr >> PageShift] |= (uint8_t)(1u << ((addr >> BlockShift) & 7));
+    }
+
+    // Device event queue (moira_schedule_event). Indexed min-heap on the deadline with at
+    // most one entry per id, eventPos[id] is the heap slot of the id or -1 if not scheduled.
+    // The ids past the host's are the wrapper's own, dispatched natively by runUntil.
+    static constexpr int BlitterEvent = MOIRA_MAX_EVENTS;
+    static constexpr int MaxEvents = MOIRA_MAX_EVENTS + 1;
+
+    int64_t eventCycle[MaxEvents];
+    int eventPos[MaxEvents];
+    int eventHeap[MaxEvents];
+    int eventCount;
+    int64_t nextEvent; // Deadline at the top of the heap, INT64_MAX if empty
+    moira_event_fn eventFn;
+    void* eventUser;
+
+    void eventSwap(int i, int j) {
+        std::swap(eventHeap[i], eventHeap[j]);
+        eventPos[eventHeap[i]] = i;
+        eventPos[eventHeap[j]] = j;
+    }
+
+    void eventSiftUp(int i) {
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (eventCycle[eventHeap[parent]] <= eventCycle[eventHeap[i]]) break;
+            eventSwap(i, parent);
+            i = parent;
+        }
+    }
+
+    void eventSiftDown(int i) {
+        for (;;) {
+            int l = 2 * i + 1, r = l + 1, m = i;
+            if (l < eventCount && eventCycle[eventHeap[l]] < eventCycle[eventHeap[m]]) m = l;
+            if (r < eventCount && eventCycle[eventHeap[r]] < eventCycle[eventHeap[m]]) m = r;
+            if (m == i) break;
+            eventSwap(i, m);
+            i = m;
+        }
+    }
+
+    void eventRemove(int id) {
+        int i = eventPos[id];
+        if (i < 0) return;
+
+        eventPos[id] = -1;
+        if (i != --eventCount) {
+            eventHeap[i] = eventHeap[eventCount];
+            eventPos[eventHeap[i]] = i;
+            eventSiftDown(i);
+            eventSiftUp(i);
+        }
+        nextEvent = eventCount ? eventCycle[eventHeap[0]] : INT64_MAX;
+    }
+
+    void eventSchedule(int64_t cycle, int id) {
+        if (eventPos[id] < 0) {
+            eventPos[id] = eventCount;
+            eventHeap[eventCount++] = id;
+        }
+        eventCycle[id] = cycle;
+        eventSiftDown(eventPos[id]);
+        eventSiftUp(eventPos[id]);
+        nextEvent = eventCycle[eventHeap[0]];
+    }
+
+    // Set by moira_triggerBusError from a plain (non _ex) handler
     bool pendingBusError;
-    uint32_t busErrorAddress;
-    bool busErrorIsWrite;
-
-    // Método helper para lanzar bus error si está pendiente
-    void throwPendingBusErrorIfNeeded() const {
-        if (pendingBusError) {
-            auto* self = const_cast<MoiraHost*>(this);
-            self->pendingBusError = false;
-            
-            moira::StackFrame frame;
-            frame.code = (uint16_t)(busErrorIsWrite ? 0x0000 : 0x0010);
-            frame.addr = busErrorAddress;
-            frame.ird = getIRD();
-            frame.sr = getSR();
-            frame.pc = getPC();
-            
-            throw moira::BusError(frame);
+
+    // Instruction trace ring (moira_trace_enable). traceHead counts every entry recorded,
+    // traceTail the ones fetched, both grow forever and are masked into the ring.
+    std::unique_ptr<moira_trace_entry[]> trace;
+    uint32_t traceMask;
+    uint64_t traceHead;
+    uint64_t traceTail;
+
+    void traceRecord() {
+        moira_trace_entry& e = trace[traceHead++ & traceMask];
+        e.pc = getPC();
+        e.opcode = getIRD();
+        e.sr = getSR();
+        e.clock = clock;
+    }
+
+    // Hot spot profiler (moira_profile_start). The address histogram is split in chunks of 4 KB
+    // of address space, allocated the first time an instruction runs in them.
+    struct ProfileSlot {
+        uint64_t count;
+        uint64_t cycles;
+        uint16_t opcode;
+    };
+
+    static constexpr int ChunkShift = 12;
+    static constexpr int ChunkCount = 1 << (24 - ChunkShift);
+    static constexpr int ChunkSlots = 1 << (ChunkShift - 1); // Instructions are word aligned
+
+    std::unique_ptr<std::unique_ptr<ProfileSlot[]>[]> profileChunks;
+    std::unique_ptr<ProfileSlot[]> profileOpcodes;
+    uint32_t profilePeriod; // 0 counts every instruction
+    int64_t profileNext;
+
+    void profileRecord(uint32_t pc, uint16_t opcode, int64_t cycles) {
+        uint64_t count = 1;
+        if (profilePeriod) {
+            if (clock < profileNext) return;
+
+            count = (uint64_t)(clock - profileNext) / profilePeriod + 1;
+            profileNext += (int64_t)(count * profilePeriod);
+            cycles = (int64_t)(count * profilePeriod);
+        }
+
+        std::unique_ptr<ProfileSlot[]>& chunk = profileChunks[pc >> ChunkShift];
+        if (!chunk) {
+            chunk.reset(new (std::nothrow) ProfileSlot[ChunkSlots]());
+            if (!chunk) return;
         }
+
+        ProfileSlot& slot = chunk[(pc & ((1u << ChunkShift) - 1)) >> 1];
+        slot.count += count;
+        slot.cycles += (uint64_t)cycles;
+        slot.opcode = opcode;
+
+        ProfileSlot& op = profileOpcodes[opcode];
+        op.count += count;
+        op.cycles += (uint64_t)cycles;
+    }
+
+    // One instruction with the trace and the profiler, whichever are on
+    void executeInstrumented() {
+        if (trace) traceRecord();
+        if (!profileOpcodes) {
+            execute();
+            return;
+        }
+
+        uint32_t pc = getPC() & 0xFFFFFE;
+        uint16_t opcode = getIRD();
+        int64_t start = clock;
+        execute();
+        if (profileOpcodes) profileRecord(pc, opcode, clock - start); // May be stopped by a callback
+    }
+
+    // Performance counters (moira_counters_enable). Bus functions are const, so the block is
+    // mutable like the write map. Only touched while counting.
+    bool counting;
+    mutable moira_counters counters;
+
+    void countRead(uint64_t& width, const Page& p) const {
+        width++;
+        if (!p.read) counters.io++;
+        else if (p.write) counters.ram++;
+        else counters.rom++;
+    }
+
+    void countWrite(uint64_t& width, const Page& p) const {
+        width++;
+        if (p.write) counters.ram++;
+        else if (p.read) counters.rom++;
+        else counters.io++;
+    }
+
+    // The bus error handler set is the wrapper's own, not a call into the host
+    void countHandler(int dev) const {
+        if (dev != DevBusError) counters.callbacks++;
+    }
+
+    // Blitter (moira_map_blitter). Its registers are a device of the wrapper, its bus time an event of the
+    // wrapper's own: in blit mode the blitter and the CPU take turns of 64 bus accesses, in hog mode the CPU
+    // waits for the whole blit, handed out in slices that end with the run in progress so the line callbacks
+    // stay on time. Either way the clock moves 4 cycles per word the blitter reads or writes.
+    static constexpr int BlitterTurn = 64;
+    static constexpr int BlitterHogSlice = 4096;
+
+    Blitter blitter;
+    int blitterDoneEvent;
+
+    static int blitterRead8(void* user, uint32_t addr, uint8_t* v) {
+        return static_cast<MoiraHost*>(user)->blitter.read8(addr & PageMask, *v) ? MOIRA_BUS_OK : MOIRA_BUS_ERROR;
+    }
+    static int blitterRead16(void* user, uint32_t addr, uint16_t* v) {
+        return static_cast<MoiraHost*>(user)->blitter.read16(addr & PageMask, *v) ? MOIRA_BUS_OK : MOIRA_BUS_ERROR;
+    }
+    static int blitterWrite8(void* user, uint32_t addr, uint8_t v) {
+        MoiraHost* m = static_cast<MoiraHost*>(user);
+        bool idle = !m->blitter.busy();
+        if (!m->blitter.write8(addr & PageMask, v)) return MOIRA_BUS_ERROR;
+        if (idle && m->blitter.busy()) m->eventSchedule(m->clock, BlitterEvent);
+        return MOIRA_BUS_OK;
+    }
+    static int blitterWrite16(void* user, uint32_t addr, uint16_t v) {
+        MoiraHost* m = static_cast<MoiraHost*>(user);
+        bool idle = !m->blitter.busy();
+        if (!m->blitter.write16(addr & PageMask, v)) return MOIRA_BUS_ERROR;
+        if (idle && m->blitter.busy()) m->eventSchedule(m->clock, BlitterEvent);
+        return MOIRA_BUS_OK;
+    }
+
+    // The blitter's view of memory: native buffers directly, anything else through the page's handlers. The
+    // blitter has no bus error, a faulting word reads as whatever the handler returned and a write is lost.
+    void readWords(uint32_t addr, int32_t step, int count, uint16_t* out) override {
+        for (int i = 0; i < count; i++, addr += (uint32_t)step) {
+            uint32_t a = addr & 0xFFFFFE;
+            const Page& p = pages[a >> PageShift];
+            if (p.read) {
+                const uint8_t* b = p.read + (a & PageMask);
+                out[i] = (uint16_t)((b[0] << 8) | b[1]);
+            } else {
+                const moira_device_ex& d = devices[p.readDev].fn;
+                d.read16(d.user, a, &out[i]);
+            }
+        }
+    }
+
+    void writeWords(uint32_t addr, int32_t step, int count, const uint16_t* in) override {
+        for (int i = 0; i < count; i++, addr += (uint32_t)step) {
+            uint32_t a = addr & 0xFFFFFE;
+            const Page& p = pages[a >> PageShift];
+            if (p.write) {
+                uint8_t* b = p.write + (a & PageMask);
+                b[0] = (uint8_t)(in[i] >> 8);
+                b[1] = (uint8_t)in[i];
+                markWritten(a);
+            } else {
+                const moira_device_ex& d = devices[p.writeDev].fn;
+                d.write16(d.user, a, in[i]);
+            }
+        }
+    }
+
+    // BlitterEvent, 'limit' is the end of the run in progress
+    void runBlitter(int64_t limit) {
+        int accesses = BlitterTurn;
+        if (blitter.hog()) accesses = (int)std::clamp<int64_t>((limit - clock) / 4, 1, BlitterHogSlice);
+
+        int made = blitter.run(accesses);
+        if (made) sync(made * 4);
+
+        if (blitter.busy())
+            eventSchedule(blitter.hog() ? clock : clock + BlitterTurn * 4, BlitterEvent);
+        else if (blitterDoneEvent >= 0)
+            eventSchedule(clock, blitterDoneEvent);
+    }
+
+    int takeBusError() {
+        int status = pendingBusError ? MOIRA_BUS_ERROR : MOIRA_BUS_OK;
+        pendingBusError = false;
+        return status;
+    }
+
+    // Only called from the bus functions, so the exception is thrown and caught inside
+    // Moira's own execution loop, never across a callback into the host
+    [[noreturn]] void busError(uint32_t addr, bool isWrite) const {
+        moira::StackFrame frame;
+        frame.code = (uint16_t)(isWrite ? 0x0000 : 0x0010);
+        frame.addr = addr;
+        frame.ird = getIRD();
+        frame.sr = getSR();
+        frame.pc = getPC();
+
+        if (counting) counters.bus_errors++;
+        throw moira::BusError(frame);
+    }
+
+    // Adapters for plain handler sets (Device::legacy)
+    static int legacyRead8(void* user, uint32_t addr, uint8_t* v) {
+        Device* d = static_cast<Device*>(user);
+        *v = d->legacy.read8(d->legacy.user, addr);
+        return d->host->takeBusError();
+    }
+    static int legacyRead16(void* user, uint32_t addr, uint16_t* v) {
+        Device* d = static_cast<Device*>(user);
+        *v = d->legacy.read16(d->legacy.user, addr);
+        return d->host->takeBusError();
+    }
+    static int legacyWrite8(void* user, uint32_t addr, uint8_t v) {
+        Device* d = static_cast<Device*>(user);
+        d->legacy.write8(d->legacy.user, addr, v);
+        return d->host->takeBusError();
+    }
+    static int legacyWrite16(void* user, uint32_t addr, uint16_t v) {
+        Device* d = static_cast<Device*>(user);
+        d->legacy.write16(d->legacy.user, addr, v);
+        return d->host->takeBusError();
+    }
+
+    void setLegacyDevice(int slot, const moira_device& dev) {
+        Device& d = devices[slot];
+        d.legacy = dev;
+        d.host = this;
+        d.fn = { &d, legacyRead8, legacyRead16, legacyWrite8, legacyWrite16 };
+    }
+
+    // Bus error handler set (devices[DevBusError])
+    static int busErrorRead8(void*, uint32_t, uint8_t* v) { *v = 0xFF; return MOIRA_BUS_ERROR; }
+    static int busErrorRead16(void*, uint32_t, uint16_t* v) { *v = 0xFFFF; return MOIRA_BUS_ERROR; }
+    static int busErrorWrite8(void*, uint32_t, uint8_t) { return MOIRA_BUS_ERROR; }
+    static int busErrorWrite16(void*, uint32_t, uint16_t) { return MOIRA_BUS_ERROR; }
+
+    static bool isPageRange(uint32_t base, uint32_t size) {
+        return size != 0 && base <= 0xFFFFFF && size <= 0x1000000 - base &&
+            (base & PageMask) == 0 && (size & PageMask) == 0;
     }
 
 public:
-    explicit MoiraHost(const moira_callbacks& cbs) : cb(cbs), 
-        pendingBusError(false), busErrorAddress(0), busErrorIsWrite(false) {
+    explicit MoiraHost(const moira_callbacks& cbs) : cb(cbs), deviceCount(2),
+        eventCount(0), nextEvent(INT64_MAX), eventFn(nullptr), eventUser(nullptr),
+        pendingBusError(false), traceMask(0), traceHead(0), traceTail(0), profilePeriod(0), profileNext(0),
+        counting(false), counters(), blitter(*this), blitterDoneEvent(-1) {
         // Vectors for IRQs will be managed by ASE
         irqMode = moira::IrqMode::USER;
+
+        setLegacyDevice(DevHost, { cb.user, cb.read8, cb.read16, cb.write8, cb.write16 });
+        devices[DevBusError].fn = { nullptr, busErrorRead8, busErrorRead16, busErrorWrite8, busErrorWrite16 };
+
+        unmapAll();
+        memset(writeMap, 0, sizeof(writeMap));
+
+        for (int& pos : eventPos)
+            pos = -1;
     }
 
-    void sync(int cycles) override {
-        throwPendingBusErrorIfNeeded();
-        
+    void sync(int cycles) HOST_OVERRIDE {
+        if (counting && cb.sync) counters.callbacks++;
         if (cb.sync) cb.sync(cb.user, cycles);
+#if MOIRA_VIRTUAL_API == true
         else moira::Moira::sync(cycles);
+#else
+        else clock += cycles; // Moira's default, Moira::sync itself forwards here
+#endif
     }
 
-    uint8_t read8(uint32_t addr) const override {
-        uint8_t result = cb.read8(cb.user, addr);
-        throwPendingBusErrorIfNeeded();
+    // One page lookup selects the target. Native buffers are accessed directly, everything
+    // else goes through the page's handler set, whose return status is the only fault check.
+
+    uint8_t read8(uint32_t addr) const HOST_OVERRIDE {
+        addr &= 0xFFFFFF;
+        const Page& p = pages[addr >> PageShift];
+        if (counting) countRead(counters.reads8, p);
+        if (p.read)
+            return p.read[addr & PageMask];
+
+        if (counting) countHandler(p.readDev);
+        const moira_device_ex& d = devices[p.readDev].fn;
+        uint8_t result;
+        if (d.read8(d.user, addr, &result) != MOIRA_BUS_OK)
+            busError(addr, false);
         return result;
     }
 
-    uint16_t read16(uint32_t addr) const override {
-        uint16_t result = cb.read16(cb.user, addr);
-        throwPendingBusErrorIfNeeded();
+    uint16_t read16(uint32_t addr) const HOST_OVERRIDE {
+        addr &= 0xFFFFFF;
+        const Page& p = pages[addr >> PageShift];
+        if (counting) countRead(counters.reads16, p);
+        // A word at the last byte of a page may span two buffers, let the handler deal with it
+        if (p.read && (addr & PageMask) != PageMask) {
+            const uint8_t* b = p.read + (addr & PageMask);
+            return (uint16_t)((b[0] << 8) | b[1]);
+        }
+
+        if (counting) countHandler(p.readDev);
+        const moira_device_ex& d = devices[p.readDev].fn;
+        uint16_t result;
+        if (d.read16(d.user, addr, &result) != MOIRA_BUS_OK)
+            busError(addr, false);
         return result;
     }
 
-    void write8(uint32_t addr, uint8_t v) const override {
-        cb.write8(cb.user, addr, v);
-        throwPendingBusErrorIfNeeded();
+    void write8(uint32_t addr, uint8_t v) const HOST_OVERRIDE {
+        addr &= 0xFFFFFF;
+        const Page& p = pages[addr >> PageShift];
+        if (counting) countWrite(counters.writes8, p);
+        if (p.write) {
+            p.write[addr & PageMask] = v;
+            markWritten(addr);
+            return;
+        }
+
+        if (counting) countHandler(p.writeDev);
+        const moira_device_ex& d = devices[p.writeDev].fn;
+        if (d.write8(d.user, addr, v) != MOIRA_BUS_OK)
+            busError(addr, true);
     }
 
-    void write16(uint32_t addr, uint16_t v) const override {
-        cb.write16(cb.user, addr, v);
-        throwPendingBusErrorIfNeeded();
+    void write16(uint32_t addr, uint16_t v) const HOST_OVERRIDE {
+        addr &= 0xFFFFFF;
+        const Page& p = pages[addr >> PageShift];
+        if (counting) countWrite(counters.writes16, p);
+        if (p.write && (addr & PageMask) != PageMask) {
+            uint8_t* b = p.write + (addr & PageMask);
+            b[0] = (uint8_t)(v >> 8);
+            b[1] = (uint8_t)v;
+            markWritten(addr);
+            markWritten(addr + 1); // Odd addresses when address errors are not emulated
+            return;
+        }
+
+        if (counting) countHandler(p.writeDev);
+        const moira_device_ex& d = devices[p.writeDev].fn;
+        if (d.write16(d.user, addr, v) != MOIRA_BUS_OK)
+            busError(addr, true);
     }
 
-    uint16_t readIrqUserVector(uint8_t level) const override {
+    uint16_t readIrqUserVector(uint8_t level) const HOST_OVERRIDE {
+        if (counting) {
+            counters.irq_acks++;
+            if (cb.readIrqUserVector) counters.callbacks++;
+        }
         return cb.readIrqUserVector ? cb.readIrqUserVector(cb.user, level) : 0;
     }
 
-    void scheduleBusError(uint32_t faultaddress, bool isWrite) {
+    void scheduleBusError() {
         pendingBusError = true;
-        busErrorAddress = faultaddress;
-        busErrorIsWrite = isWrite;
+    }
+
+    bool mapRegion(uint32_t base, uint32_t size, void* ptr, uint32_t flags) {
+        if (!ptr || !isPageRange(base, size))
+            return false;
+
+        uint8_t* buf = static_cast<uint8_t*>(ptr);
+        for (uint32_t off = 0; off < size; off += PageSize) {
+            Page& p = pages[(base + off) >> PageShift];
+            if (flags & MOIRA_MAP_READ) { p.read = buf + off; p.readDev = DevHost; }
+            if (flags & MOIRA_MAP_WRITE) { p.write = buf + off; p.writeDev = DevHost; }
+        }
+        return true;
+    }
+
+    bool mapHandler(uint32_t base, uint32_t size, int dev, uint32_t flags) {
+        if (!isPageRange(base, size))
+            return false;
+
+        for (uint32_t off = 0; off < size; off += PageSize) {
+            Page& p = pages[(base + off) >> PageShift];
+            if (flags & MOIRA_MAP_READ) { p.read = nullptr; p.readDev = (uint8_t)dev; }
+            if (flags & MOIRA_MAP_WRITE) { p.write = nullptr; p.writeDev = (uint8_t)dev; }
+        }
+        return true;
+    }
+
+    bool mapDevice(uint32_t base, uint32_t size, const moira_device& dev) {
+        if (!dev.read8 || !dev.read16 || !dev.write8 || !dev.write16)
+            return false;
+        if (deviceCount == MaxDevices || !isPageRange(base, size))
+            return false;
+
+        setLegacyDevice(deviceCount, dev);
+        return mapHandler(base, size, deviceCount++, MOIRA_MAP_READ | MOIRA_MAP_WRITE);
+    }
+
+    bool mapDevice(uint32_t base, uint32_t size, const moira_device_ex& dev) {
+        if (!dev.read8 || !dev.read16 || !dev.write8 || !dev.write16)
+            return false;
+        if (deviceCount == MaxDevices || !isPageRange(base, size))
+            return false;
+
+        devices[deviceCount].fn = dev;
+        return mapHandler(base, size, deviceCount++, MOIRA_MAP_READ | MOIRA_MAP_WRITE);
+    }
+
+    bool mapBusError(uint32_t base, uint32_t size, uint32_t flags) {
+        return mapHandler(base, size, DevBusError, flags);
+    }
+
+    bool mapBlitter(uint32_t base, int doneEvent) {
+        if (doneEvent < -1 || doneEvent >= MOIRA_MAX_EVENTS)
+            return false;
+
+        moira_device_ex dev = { this, blitterRead8, blitterRead16, blitterWrite8, blitterWrite16 };
+        if (!mapDevice(base, PageSize, dev))
+            return false;
+
+        blitter.reset();
+        eventRemove(BlitterEvent);
+        blitterDoneEvent = doneEvent;
+        return true;
+    }
+
+    void unmapAll() {
+        for (Page& p : pages)
+            p = { nullptr, nullptr, DevHost, DevHost };
+        deviceCount = 2;
+    }
+
+    uint8_t* getWriteMap() { return writeMap; }
+
+    void setEventHandler(moira_event_fn fn, void* user) {
+        eventFn = fn;
+        eventUser = user;
+    }
+
+    bool scheduleEvent(int64_t cycle, int id) {
+        if (id < 0 || id >= MOIRA_MAX_EVENTS) return false;
+
+        eventSchedule(cycle, id);
+        return true;
+    }
+
+    void cancelEvent(int id) {
+        if (id >= 0 && id < MOIRA_MAX_EVENTS) eventRemove(id);
+    }
+
+    bool enableTrace(uint32_t capacity) {
+        trace.reset();
+        traceMask = 0;
+        traceHead = traceTail = 0;
+        if (capacity == 0) return true;
+
+        uint32_t size = 2;
+        while (size < capacity && size < 0x80000000u) size <<= 1;
+
+        trace.reset(new (std::nothrow) moira_trace_entry[size]);
+        if (!trace) return false;
+
+        traceMask = size - 1;
+        return true;
+    }
+
+    size_t fetchTrace(moira_trace_entry* buf, size_t n) {
+        // Entries overwritten since the last fetch are skipped
+        if (traceHead - traceTail > traceMask + 1ull) traceTail = traceHead - (traceMask + 1ull);
+
+        size_t count = (size_t)(traceHead - traceTail);
+        if (!buf) return count;
+
+        if (count > n) count = n;
+        for (size_t i = 0; i < count; i++)
+            buf[i] = trace[traceTail++ & traceMask];
+        return count;
+    }
+
+    bool startProfile(uint32_t sampleCycles) {
+        stopProfile();
+
+        profileChunks.reset(new (std::nothrow) std::unique_ptr<ProfileSlot[]>[ChunkCount]);
+        profileOpcodes.reset(new (std::nothrow) ProfileSlot[0x10000]());
+        if (!profileChunks || !profileOpcodes) {
+            stopProfile();
+            return false;
+        }
+
+        profilePeriod = sampleCycles;
+        profileNext = clock + sampleCycles;
+        return true;
+    }
+
+    void stopProfile() {
+        profileOpcodes.reset();
+        profileChunks.reset();
+    }
+
+    size_t fetchProfile(int kind, moira_profile_entry* buf, size_t n) const {
+        if (!profileOpcodes) return 0;
+
+        size_t count = 0;
+        auto add = [&](uint32_t key, const ProfileSlot& slot) {
+            if (!slot.count) return;
+            if (buf) {
+                if (count == n) return;
+                buf[count] = { key, slot.opcode, 0, slot.count, slot.cycles };
+            }
+            count++;
+        };
+
+        if (kind == MOIRA_PROFILE_OPCODE) {
+            for (uint32_t op = 0; op < 0x10000; op++)
+                add(op, profileOpcodes[op]);
+        } else {
+            for (uint32_t c = 0; c < (uint32_t)ChunkCount; c++) {
+                if (!profileChunks[c]) continue;
+                for (uint32_t i = 0; i < (uint32_t)ChunkSlots; i++)
+                    add((c << ChunkShift) | (i << 1), profileChunks[c][i]);
+            }
+        }
+        return count;
+    }
+
+    void enableCounters(bool enable) { counting = enable; }
+    void getCounters(moira_counters& out) const { out = counters; }
+    void resetCounters() { counters = {}; }
+
+    // moira_execute, one instruction
+    void step() {
+        int64_t start = clock;
+        executeInstrumented();
+        if (counting) counters.cycles += clock - start;
+    }
+
+    // Pending host events as a bit mask plus deadlines, for moira_serialize
+    uint32_t getEvents(int64_t* cycles) const {
+        uint32_t mask = 0;
+        for (int id = 0; id < MOIRA_MAX_EVENTS; id++) {
+            cycles[id] = eventPos[id] < 0 ? 0 : eventCycle[id];
+            if (eventPos[id] >= 0) mask |= 1u << id;
+        }
+        return mask;
+    }
+
+    void setEvents(uint32_t mask, const int64_t* cycles) {
+        for (int& pos : eventPos)
+            pos = -1;
+        eventCount = 0;
+        nextEvent = INT64_MAX;
+
+        for (int id = 0; id < MOIRA_MAX_EVENTS; id++)
+            if (mask & (1u << id)) eventSchedule(cycles[id], id);
+    }
+
+    // Blitter registers plus the deadline of its next turn (-1 if idle), for moira_serialize. Call
+    // setBlitter after setEvents.
+    int64_t getBlitter(Blitter::State& state) const {
+        state = blitter.regs;
+        return eventPos[BlitterEvent] < 0 ? -1 : eventCycle[BlitterEvent];
+    }
+
+    void setBlitter(const Blitter::State* state, int64_t cycle) {
+        if (state) blitter.regs = *state;
+        else blitter.reset();
+
+        eventRemove(BlitterEvent);
+        if (state && cycle >= 0) eventSchedule(cycle, BlitterEvent);
+    }
+
+    // executeUntil that stops at every due event. Events scheduled from a bus access or an
+    // event handler are seen at the next instruction boundary.
+    void runUntil(int64_t cycle) {
+        int64_t start = clock;
+
+        for (;;) {
+            if (trace || profileOpcodes) {
+                while (clock < cycle && clock < nextEvent)
+                    executeInstrumented();
+            } else {
+                while (clock < cycle && clock < nextEvent)
+                    execute();
+            }
+
+            if (nextEvent > clock || nextEvent > cycle) break;
+
+            int id = eventHeap[0];
+            int64_t due = eventCycle[id];
+            eventRemove(id);
+
+            if (id == BlitterEvent) {
+                runBlitter(cycle);
+                continue;
+            }
+
+            if (counting && eventFn) counters.callbacks++;
+            if (eventFn) eventFn(eventUser, id, due);
+        }
+
+        if (counting) counters.cycles += clock - start;
+    }
+
+    // Runs 'count' lines of 'cyclesPerLine' cycles, calling back at 'hblSplit' cycles into each
+    // line (if it is inside the line) and at its end. Line boundaries are absolute clock values,
+    // so the overshoot of the last instruction is taken from the next segment instead of drifting.
+    int runScanlines(int count, int cyclesPerLine, int hblSplit, moira_line_fn fn, void* user) {
+        bool split = hblSplit > 0 && hblSplit < cyclesPerLine;
+        int64_t lineStart = getClock();
+
+        for (int line = 0; line < count; line++) {
+            if (split) {
+                runUntil(lineStart + hblSplit);
+                if (counting) counters.callbacks++;
+                if (fn(user, line, MOIRA_LINE_HBL)) return line;
+            }
+
+            lineStart += cyclesPerLine;
+            runUntil(lineStart);
+            if (counting) counters.callbacks++;
+            if (fn(user, line, MOIRA_LINE_END)) return line + 1;
+        }
+        return count;
     }
 };
 
+#if MOIRA_VIRTUAL_API != true
+
+// Static binding of Moira's client API. MoiraHost is the only type ever instantiated, so each
+// function forwards to it (or does nothing, like the defaults of the virtual API).
+// Keep this list in sync with the client API of the Moira release in this directory.
+namespace moira {
+
+static inline const MoiraHost* host(const Moira* m) { return static_cast<const MoiraHost*>(m); }
+static inline MoiraHost* host(Moira* m) { return static_cast<MoiraHost*>(m); }
+
+void Moira::sync(int cycles) { host(this)->sync(cycles); }
+u8 Moira::read8(u32 addr) const { return host(this)->read8(addr); }
+u16 Moira::read16(u32 addr) const { return host(this)->read16(addr); }
+u16 Moira::read16OnReset(u32 addr) const { return host(this)->read16(addr); }
+u16 Moira::read16Dasm(u32 addr) const { return host(this)->read16(addr); }
+void Moira::write8(u32 addr, u8 val) const { host(this)->write8(addr, val); }
+void Moira::write16(u32 addr, u16 val) const { host(this)->write16(addr, val); }
+u16 Moira::readIrqUserVector(u8 level) const { return host(this)->readIrqUserVector(level); }
+
+void Moira::cpuDidReset() { }
+void Moira::cpuDidHalt() { }
+void Moira::willExecute(const char* func, Instr I, Mode M, Size S, u16 opcode) { }
+void Moira::didExecute(const char* func, Instr I, Mode M, Size S, u16 opcode) { }
+void Moira::willExecute(ExceptionType exc, u16 vector) { }
+void Moira::didExecute(ExceptionType exc, u16 vector) { }
+void Moira::didChangeCACR(u32 value) { }
+void Moira::didChangeCAAR(u32 value) { }
+void Moira::didReachSoftstop(u32 addr) { }
+void Moira::didReachBreakpoint(u32 addr) { }
+void Moira::didReachWatchpoint(u32 addr) { }
+void Moira::didReachCatchpoint(u8 vector) { }
+void Moira::didReachSoftwareTrap(u8 vector) { }
+
+} // namespace moira
+
+#endif
+
 static inline MoiraHost* H(moira_handle h) { 
     return static_cast<MoiraHost*>(h); 
 }
 
+#ifndef MOIRA_PROFILE
+#define MOIRA_PROFILE "moira"
+#endif
+
 extern "C" {
 
+// Build information
+void moira_get_build_info(moira_build_info* info) {
+    if (!info) return;
+
+    *info = {};
+    info->abi_version = MOIRA_C_ABI_VERSION;
+    snprintf(info->profile, sizeof(info->profile), "%s", MOIRA_PROFILE);
+    info->virtual_api = MOIRA_VIRTUAL_API;
+    info->precise_timing = MOIRA_PRECISE_TIMING;
+    info->emulate_address_error = MOIRA_EMULATE_ADDRESS_ERROR;
+    info->emulate_fc = MOIRA_EMULATE_FC;
+    info->dasm = MOIRA_ENABLE_DASM;
+    info->instr_info_table = MOIRA_BUILD_INSTR_INFO_TABLE;
+}
+
 // Creation/destruction
 moira_handle moira_create(const moira_callbacks* cb) {
     if (!cb || !cb->read8 || !cb->read16 || !cb->write8 || !cb->write16) 
@@ -104,14 +826,66 @@ void moira_destroy(moira_handle h) {
     catch (...) {}
 }
 
+// Native memory map
+int moira_map_region(moira_handle h, uint32_t base, uint32_t size, void* ptr, uint32_t flags) {
+    return H(h)->mapRegion(base, size, ptr, flags) ? 0 : -1;
+}
+
+int moira_map_device(moira_handle h, uint32_t base, uint32_t size, const moira_device* dev) {
+    if (!dev) return -1;
+    return H(h)->mapDevice(base, size, *dev) ? 0 : -1;
+}
+
+int moira_map_device_ex(moira_handle h, uint32_t base, uint32_t size, const moira_device_ex* dev) {
+    if (!dev) return -1;
+    return H(h)->mapDevice(base, size, *dev) ? 0 : -1;
+}
+
+int moira_map_bus_error(moira_handle h, uint32_t base, uint32_t size, uint32_t flags) {
+    return H(h)->mapBusError(base, size, flags) ? 0 : -1;
+}
+
+void moira_unmap_all(moira_handle h) { H(h)->unmapAll(); }
+
+int moira_map_blitter(moira_handle h, uint32_t base, int done_event) {
+    return H(h)->mapBlitter(base, done_event) ? 0 : -1;
+}
+
+uint8_t* moira_get_write_map(moira_handle h) { return H(h)->getWriteMap(); }
+
+// Instruction trace
+int moira_trace_enable(moira_handle h, uint32_t capacity) { return H(h)->enableTrace(capacity) ? 0 : -1; }
+size_t moira_trace_fetch(moira_handle h, moira_trace_entry* buf, size_t n) { return H(h)->fetchTrace(buf, n); }
+
+// Hot spot profiler
+int moira_profile_start(moira_handle h, uint32_t sample_cycles) { return H(h)->startProfile(sample_cycles) ? 0 : -1; }
+void moira_profile_stop(moira_handle h) { H(h)->stopProfile(); }
+size_t moira_profile_fetch(moira_handle h, int kind, moira_profile_entry* buf, size_t n) { return H(h)->fetchProfile(kind, buf, n); }
+
+// Performance counters
+void moira_counters_enable(moira_handle h, int enable) { H(h)->enableCounters(enable != 0); }
+void moira_get_counters(moira_handle h, moira_counters* counters) { if (counters) H(h)->getCounters(*counters); }
+void moira_reset_counters(moira_handle h) { H(h)->resetCounters(); }
+
 // Running CPU
 void moira_reset(moira_handle h) { H(h)->reset(); }
-void moira_execute(moira_handle h) { H(h)->execute(); }
-void moira_execute_cycles(moira_handle h, int64_t cycles) { H(h)->execute(cycles); }
-void moira_execute_until(moira_handle h, int64_t cycle) { H(h)->executeUntil(cycle); }
+void moira_execute(moira_handle h) { H(h)->step(); }
+void moira_execute_cycles(moira_handle h, int64_t cycles) { H(h)->runUntil(H(h)->getClock() + cycles); }
+void moira_execute_until(moira_handle h, int64_t cycle) { H(h)->runUntil(cycle); }
+
+// Device events
+void moira_set_event_handler(moira_handle h, moira_event_fn fn, void* user) { H(h)->setEventHandler(fn, user); }
+int moira_schedule_event(moira_handle h, int64_t cycle, int id) { return H(h)->scheduleEvent(cycle, id) ? 0 : -1; }
+void moira_cancel_event(moira_handle h, int id) { H(h)->cancelEvent(id); }
+
+int moira_run_scanlines(moira_handle h, int count, int cycles_per_line, int hbl_split, moira_line_fn callback, void* user) {
+    if (!callback || count <= 0 || cycles_per_line <= 0) return 0;
+    return H(h)->runScanlines(count, cycles_per_line, hbl_split, callback, user);
+}
 void moira_setSupervisorMode(moira_handle h, bool s) { H(h)->setSupervisorMode(s); }
+// The frame is built from the access in progress, faultaddress/isWrite are kept for the ABI
 void moira_triggerBusError(moira_handle h, uint32_t faultaddress, bool isWrite) { 
-    H(h)->scheduleBusError(faultaddress, isWrite);
+    H(h)->scheduleBusError();
 }
 
 // Clock
@@ -155,13 +929,112 @@ void moira_setSP(moira_handle h, uint32_t v) { H(h)->setSP(v); }
 uint8_t moira_getIPL(moira_handle h) { return H(h)->getIPL(); }
 void moira_setIPL(moira_handle h, uint8_t v) { H(h)->setIPL(v); }
 
+// Register snapshot. On the 68000 the supervisor stack pointer is Moira's ISP.
+int moira_get_state(moira_handle h, moira_cpu_state* state) {
+    if (!state) return -1;
+
+    MoiraHost* m = H(h);
+
+    for (int n = 0; n < 8; n++) {
+        state->d[n] = m->getD(n);
+        state->a[n] = m->getA(n);
+    }
+    state->usp = m->getUSP();
+    state->ssp = m->getISP();
+    state->pc = m->getPC();
+    state->pc0 = m->getPC0();
+    state->irc = m->getIRC();
+    state->ird = m->getIRD();
+    state->sr = m->getSR();
+    state->ipl = m->getIPL();
+    state->reserved = 0;
+    state->clock = m->getClock();
+    return 0;
+}
+
+int moira_set_state(moira_handle h, const moira_cpu_state* state) {
+    if (!state) return -1;
+
+    MoiraHost* m = H(h);
+
+    m->setSR(state->sr);
+    m->setUSP(state->usp);
+    m->setISP(state->ssp);
+    for (int n = 0; n < 8; n++) {
+        m->setD(n, state->d[n]);
+        m->setA(n, state->a[n]);
+    }
+    m->setPC(state->pc);
+    m->setPC0(state->pc0);
+    m->setIRC(state->irc);
+    m->setIRD(state->ird);
+    m->setIPL(state->ipl);
+    m->setClock(state->clock);
+    return 0;
+}
+
+// Core snapshot. Version 2 adds the blitter, version 1 snapshots load with it reset.
+static constexpr uint32_t SnapshotMagic = 0x5249414D; // "MAIR" in little endian
+static constexpr uint32_t SnapshotVersion = 2;
+
+struct Snapshot {
+    uint32_t magic;
+    uint32_t version;
+    moira_cpu_state cpu;
+    uint32_t eventMask;
+    uint32_t reserved;
+    int64_t eventCycle[MOIRA_MAX_EVENTS];
+    int64_t blitterCycle;
+    Blitter::State blitter;
+};
+
+static constexpr size_t SnapshotV1Size = offsetof(Snapshot, blitterCycle);
+
+size_t moira_serialize(moira_handle h, void* buf, size_t size) {
+    if (!buf || size < sizeof(Snapshot)) return sizeof(Snapshot);
+
+    Snapshot snap = {};
+    snap.magic = SnapshotMagic;
+    snap.version = SnapshotVersion;
+    moira_get_state(h, &snap.cpu);
+    snap.eventMask = H(h)->getEvents(snap.eventCycle);
+    snap.blitterCycle = H(h)->getBlitter(snap.blitter);
+
+    memcpy(buf, &snap, sizeof(snap));
+    return sizeof(snap);
+}
+
+int moira_deserialize(moira_handle h, const void* buf, size_t size) {
+    if (!buf || size < SnapshotV1Size) return -1;
+
+    Snapshot snap = {};
+    memcpy(&snap, buf, std::min(size, sizeof(snap)));
+    if (snap.magic != SnapshotMagic) return -1;
+    if (snap.version != 1 && (snap.version != SnapshotVersion || size < sizeof(Snapshot))) return -1;
+
+    moira_set_state(h, &snap.cpu);
+    H(h)->setEvents(snap.eventMask, snap.eventCycle);
+    H(h)->setBlitter(snap.version == 1 ? nullptr : &snap.blitter, snap.blitterCycle);
+    return 0;
+}
+
 // Disassembler / dumps
+// Profiles built without MOIRA_ENABLE_DASM return empty strings (one word per instruction)
 int moira_disassemble(moira_handle h, char* str, uint32_t addr) {
+#if MOIRA_ENABLE_DASM
     return H(h)->disassemble(str, addr);
+#else
+    str[0] = 0;
+    return 2;
+#endif
 }
 
 void moira_disassembleSR(moira_handle h, char* str) {
+#if MOIRA_ENABLE_DASM
     H(h)->disassembleSR(str);
+#else
+    str[0] = 0;
+#endif
 }
 
 void moira_dump8(moira_handle h, char* str, uint8_t v) { H(h)->dump8(str, v); }
@@ -49,16 +49,196 @@ extern "C" {
         uint16_t ssw;
     } moira_stackframe;
 
+    // Snapshot of the CPU registers (moira_get_state, moira_set_state)
+    typedef struct moira_cpu_state {
+        uint32_t d[8];
+        uint32_t a[8];                  // a[7] is the active stack pointer
+        uint32_t usp;
+        uint32_t ssp;
+        uint32_t pc;
+        uint32_t pc0;
+        uint16_t irc;
+        uint16_t ird;
+        uint16_t sr;
+        uint8_t  ipl;
+        uint8_t  reserved;
+        int64_t  clock;
+    } moira_cpu_state;
+
+    // Native memory map flags (moira_map_region, moira_map_bus_error)
+#define MOIRA_MAP_READ   0x01
+#define MOIRA_MAP_WRITE  0x02
+
+    // Handler set for a range of I/O pages (moira_map_device)
+    typedef struct moira_device {
+        void* user;
+        moira_read8_fn  read8;
+        moira_read16_fn read16;
+        moira_write8_fn write8;
+        moira_write16_fn write16;
+    } moira_device;
+
+    // Handler set returning a bus status (moira_map_device_ex). Return MOIRA_BUS_ERROR to end the
+    // access in a bus error, with no need for moira_triggerBusError.
+#define MOIRA_BUS_OK     0
+#define MOIRA_BUS_ERROR  1
+
+    typedef int      (*moira_read8_ex_fn)(void* user, uint32_t addr, uint8_t* value);
+    typedef int      (*moira_read16_ex_fn)(void* user, uint32_t addr, uint16_t* value);
+    typedef int      (*moira_write8_ex_fn)(void* user, uint32_t addr, uint8_t v);
+    typedef int      (*moira_write16_ex_fn)(void* user, uint32_t addr, uint16_t v);
+
+    typedef struct moira_device_ex {
+        void* user;
+        moira_read8_ex_fn  read8;
+        moira_read16_ex_fn read16;
+        moira_write8_ex_fn write8;
+        moira_write16_ex_fn write16;
+    } moira_device_ex;
+
+    // Line callback for moira_run_scanlines. 'phase' is MOIRA_LINE_HBL when the CPU reaches the
+    // H-Blank split of the line and MOIRA_LINE_END at the end of it. Return non zero to stop.
+#define MOIRA_LINE_HBL  0
+#define MOIRA_LINE_END  1
+
+    typedef int      (*moira_line_fn)(void* user, int line, int phase);
+
+    // Device event callback. 'cycle' is the deadline given to moira_schedule_event, the clock can be
+    // slightly past it because events are dispatched between instructions.
+#define MOIRA_MAX_EVENTS 32
+
+    typedef void     (*moira_event_fn)(void* user, int id, int64_t cycle);
+
+    // Build information (moira_get_build_info)
+    // abi_version changes whenever the C API in this header changes.
+#define MOIRA_C_ABI_VERSION 13
+
+    typedef struct moira_build_info {
+        uint32_t abi_version;
+        char profile[16];               // library variant: "moira", "moira_fast", ...
+        uint8_t virtual_api;
+        uint8_t precise_timing;
+        uint8_t emulate_address_error;
+        uint8_t emulate_fc;
+        uint8_t dasm;
+        uint8_t instr_info_table;
+    } moira_build_info;
+
+    MOIRA_C_API void moira_get_build_info(moira_build_info* info);
+
     // Lifecycle mínimo
     MOIRA_C_API moira_handle moira_create(const moira_callbacks* cb);
     MOIRA_C_API void         moira_destroy(moira_handle h);
 
+    // Native memory map
+    // The 24-bit address space is split in 256 byte pages, base and size must be page aligned.
+    // Every page starts routed to the callbacks given to moira_create. A page can then be backed
+    // by a native buffer (serviced big-endian by the wrapper, the buffer must stay pinned while
+    // mapped), by its own device handler set, or raise a bus error. Later mappings override
+    // earlier ones, per direction. All functions return 0 on success.
+    MOIRA_C_API int  moira_map_region(moira_handle h, uint32_t base, uint32_t size, void* ptr, uint32_t flags);
+    MOIRA_C_API int  moira_map_device(moira_handle h, uint32_t base, uint32_t size, const moira_device* dev);
+    MOIRA_C_API int  moira_map_device_ex(moira_handle h, uint32_t base, uint32_t size, const moira_device_ex* dev);
+    MOIRA_C_API int  moira_map_bus_error(moira_handle h, uint32_t base, uint32_t size, uint32_t flags);
+    MOIRA_C_API void moira_unmap_all(moira_handle h);
+
+    // Blitter: maps the registers of an ST BLiTTER ($FF8A00-$FF8A3D from base, the rest of the page
+    // raises a bus error) to the wrapper's own implementation, reset. Blits move memory through the
+    // page map, native buffers directly, and take the bus from the CPU in the functions that run it:
+    // turns of 64 accesses in blit mode, the whole blit in hog mode, 4 cycles per access. When a blit
+    // ends, done_event (-1 for none) is scheduled at that cycle so the host can raise the interrupt.
+    // Its state is part of the core snapshot.
+    MOIRA_C_API int  moira_map_blitter(moira_handle h, uint32_t base, int done_event);
+
+    // Write map: one byte per page, bit n is set when the CPU writes to bytes n * 32 to n * 32 + 31
+    // of a page backed by a native buffer. The host reads and clears it in place, the pointer is
+    // valid until moira_destroy.
+    MOIRA_C_API uint8_t* moira_get_write_map(moira_handle h);
+
+    // Instruction trace: while enabled, every instruction run by the functions below is recorded
+    // before it executes into a ring of 'capacity' entries (rounded up to a power of two), the
+    // oldest ones overwritten. The flag is checked once per run of instructions, not per instruction.
+    typedef struct moira_trace_entry {
+        uint32_t pc;
+        uint16_t opcode;
+        uint16_t sr;
+        int64_t  clock;
+    } moira_trace_entry;
+
+    // capacity 0 disables the trace and frees the ring. Returns 0 on success.
+    MOIRA_C_API int    moira_trace_enable(moira_handle h, uint32_t capacity);
+    // Moves up to 'n' of the entries recorded since the last fetch to buf, oldest first, and returns
+    // how many. Entries overwritten before being fetched are lost. With buf NULL only returns the
+    // number of entries waiting.
+    MOIRA_C_API size_t moira_trace_fetch(moira_handle h, moira_trace_entry* buf, size_t n);
+
+    // Hot spot profiler: while started, the instructions run by the functions below are counted per
+    // address and per opcode, with the cycles they took. With sample_cycles 0 every instruction is
+    // counted (exact), otherwise only the instruction running when each period of sample_cycles
+    // ends, which weighs the addresses by time at a lower cost. Interrupts and exceptions taken
+    // during an instruction are charged to it.
+#define MOIRA_PROFILE_PC      0
+#define MOIRA_PROFILE_OPCODE  1
+
+    typedef struct moira_profile_entry {
+        uint32_t key;                   // Instruction address, or opcode for MOIRA_PROFILE_OPCODE
+        uint16_t opcode;                // Opcode last seen at the address (the key itself for opcodes)
+        uint16_t reserved;
+        uint64_t count;                 // Instructions, or samples
+        uint64_t cycles;                // Cycles, sample_cycles per sample when sampled
+    } moira_profile_entry;
+
+    // Starts a new profile, discarding the previous one. Returns 0 on success.
+    MOIRA_C_API int    moira_profile_start(moira_handle h, uint32_t sample_cycles);
+    // Stops profiling and frees the histograms
+    MOIRA_C_API void   moira_profile_stop(moira_handle h);
+    // Copies up to 'n' entries with a non zero count to buf, by ascending key, and returns how many.
+    // With buf NULL only returns the number of entries. The profile keeps running.
+    MOIRA_C_API size_t moira_profile_fetch(moira_handle h, int kind, moira_profile_entry* buf, size_t n);
+
+    // Performance counters: while enabled, every bus access and every call out of the wrapper is
+    // counted. Accesses are classed by the page they hit: RAM is a native buffer mapped writable,
+    // ROM a native buffer mapped read only, IO everything serviced by a handler (host callbacks,
+    // devices, bus error pages). callbacks counts the calls into the host: memory callbacks, device
+    // handlers, sync, readIrqUserVector, event handlers and line callbacks. irq_acks counts the
+    // readIrqUserVector calls and cycles the clock advanced by the functions that run the CPU.
+    typedef struct moira_counters {
+        uint64_t reads8;
+        uint64_t reads16;
+        uint64_t writes8;
+        uint64_t writes16;
+        uint64_t ram;
+        uint64_t rom;
+        uint64_t io;
+        uint64_t callbacks;
+        uint64_t bus_errors;
+        uint64_t irq_acks;
+        int64_t  cycles;
+    } moira_counters;
+
+    // Counting is off after moira_create. Disabling keeps the values, moira_reset_counters clears them.
+    MOIRA_C_API void moira_counters_enable(moira_handle h, int enable);
+    MOIRA_C_API void moira_get_counters(moira_handle h, moira_counters* counters);
+    MOIRA_C_API void moira_reset_counters(moira_handle h);
+
     // Running CPU (1:1 con Moira)
     MOIRA_C_API void moira_reset(moira_handle h);
     MOIRA_C_API void moira_execute(moira_handle h);
     MOIRA_C_API void moira_execute_cycles(moira_handle h, int64_t cycles);
     MOIRA_C_API void moira_execute_until(moira_handle h, int64_t cycle);
 
+    // Device events
+    // Every id (0 to MOIRA_MAX_EVENTS - 1) has at most one pending deadline, scheduling it again moves it.
+    // moira_execute_cycles, moira_execute_until and moira_run_scanlines stop at each deadline and call
+    // the event handler before going on. moira_schedule_event returns 0 on success.
+    MOIRA_C_API void moira_set_event_handler(moira_handle h, moira_event_fn fn, void* user);
+    MOIRA_C_API int  moira_schedule_event(moira_handle h, int64_t cycle, int id);
+    MOIRA_C_API void moira_cancel_event(moira_handle h, int id);
+
+    // Runs 'count' scanlines natively, see moira_line_fn. hbl_split is the cycle of the line where
+    // H-Blank starts (0 to call back only at the end of each line). Returns the lines completed.
+    MOIRA_C_API int  moira_run_scanlines(moira_handle h, int count, int cycles_per_line, int hbl_split, moira_line_fn callback, void* user);
+
     // Clock (1:1)
     MOIRA_C_API int64_t moira_getClock(moira_handle h);
     MOIRA_C_API void    moira_setClock(moira_handle h, int64_t v);
@@ -94,7 +274,19 @@ extern "C" {
     MOIRA_C_API uint8_t  moira_getIPL(moira_handle h);
     MOIRA_C_API void     moira_setIPL(moira_handle h, uint8_t v);
 
+    // All registers in one call. moira_set_state writes SR first, so a[7] lands on the stack
+    // pointer selected by the new mode. Both return 0 on success, -1 if state is NULL.
+    MOIRA_C_API int moira_get_state(moira_handle h, moira_cpu_state* state);
+    MOIRA_C_API int moira_set_state(moira_handle h, const moira_cpu_state* state);
+
+    // Core snapshot: CPU state plus the pending device events, in a versioned blob owned by the
+    // wrapper. moira_serialize returns the bytes written, or the size needed when buf is NULL or
+    // too small. moira_deserialize returns 0 on success, -1 if the blob is not a valid snapshot.
+    MOIRA_C_API size_t moira_serialize(moira_handle h, void* buf, size_t size);
+    MOIRA_C_API int    moira_deserialize(moira_handle h, const void* buf, size_t size);
+
     MOIRA_C_API void moira_setSupervisorMode(moira_handle h, bool s);
+    // Call from a memory callback or plain device handler, the access in progress ends in a bus error
     MOIRA_C_API void moira_triggerBusError(moira_handle h, uint32_t faultaddress, bool isWrite);
 
     MOIRA_C_API int moira_disassemble(moira_handle h, char* str, uint32_t addr);
@@ -0,0 +1,259 @@
+// moira_bench: measures the wrapper and the core apart from ASE.
+//
+// Runs 68000 code in a flat RAM, once with every access going through the host callbacks and once
+// with the RAM mapped natively (moira_map_region), and writes the results as JSON. By default the
+// code is a built-in loop of moves, adds, shifts and branches. --image loads a RAM dump instead
+// (for example the RAM of a save state), started at --pc, with the I/O area reading as zero.
+//
+//   moira_bench [--cycles=N] [--image=<file> --pc=<hex>] [--out=<file>]
+
+#include "Moira_dotnet.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t RamSize = 4 * 1024 * 1024;
+constexpr uint32_t AddrMask = 0xFFFFFF;
+
+struct Bench {
+    std::vector<uint8_t> ram;
+    uint64_t reads8 = 0, reads16 = 0, writes8 = 0, writes16 = 0;
+
+    uint64_t accesses() const { return reads8 + reads16 + writes8 + writes16; }
+};
+
+uint8_t read8(void* user, uint32_t addr) {
+    Bench* b = static_cast<Bench*>(user);
+    b->reads8++;
+    addr &= AddrMask;
+    return addr < RamSize ? b->ram[addr] : 0;
+}
+
+uint16_t read16(void* user, uint32_t addr) {
+    Bench* b = static_cast<Bench*>(user);
+    b->reads16++;
+    addr &= AddrMask;
+    return addr + 1 < RamSize ? (uint16_t)((b->ram[addr] << 8) | b->ram[addr + 1]) : 0;
+}
+
+void write8(void* user, uint32_t addr, uint8_t v) {
+    Bench* b = static_cast<Bench*>(user);
+    b->writes8++;
+    addr &= AddrMask;
+    if (addr < RamSize) b->ram[addr] = v;
+}
+
+void write16(void* user, uint32_t addr, uint16_t v) {
+    Bench* b = static_cast<Bench*>(user);
+    b->writes16++;
+    addr &= AddrMask;
+    if (addr + 1 < RamSize) {
+        b->ram[addr] = (uint8_t)(v >> 8);
+        b->ram[addr + 1] = (uint8_t)v;
+    }
+}
+
+void put16(std::vector<uint8_t>& ram, uint32_t addr, uint16_t v) {
+    ram[addr] = (uint8_t)(v >> 8);
+    ram[addr + 1] = (uint8_t)v;
+}
+
+void put32(std::vector<uint8_t>& ram, uint32_t addr, uint32_t v) {
+    put16(ram, addr, (uint16_t)(v >> 16));
+    put16(ram, addr + 2, (uint16_t)v);
+}
+
+// Reset vectors plus the built-in loop at $400
+void buildSynthetic(std::vector<uint8_t>& ram) {
+    static const uint16_t code[] = {
+        0x41F9, 0x0001, 0x0000,     // lea     $10000,a0
+        0x43F9, 0x0002, 0x0000,     // lea     $20000,a1
+        0x343C, 0x03FF,             // move.w  #$3ff,d2
+        0x2018,                     // move.l  (a0)+,d0      <- $410
+        0xD280,                     // add.l   d0,d1
+        0x32C1,                     // move.w  d1,(a1)+
+        0xE389,                     // lsl.l   #1,d1
+        0x51CA, 0xFFF6,             // dbra    d2,$410
+        0x60E2,                     // bra.s   $400
+    };
+
+    put32(ram, 0, 0x8000);          // SSP
+    put32(ram, 4, 0x400);           // PC
+    for (size_t i = 0; i < sizeof(code) / sizeof(code[0]); i++)
+        put16(ram, 0x400 + (uint32_t)(i * 2), code[i]);
+}
+
+bool loadImage(std::vector<uint8_t>& ram, const char* path, uint32_t pc) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    size_t size = fread(ram.data(), 1, ram.size(), f);
+    fclose(f);
+
+    // The vectors of a RAM dump are the ROM's, start where asked with a stack below the code
+    put32(ram, 0, pc > 0x1000 ? pc - 4 : 0x8000);
+    put32(ram, 4, pc);
+    return size > 8;
+}
+
+struct Result {
+    const char* mode;
+    double seconds;
+    int64_t cycles;
+    uint64_t callbacks;
+};
+
+Result run(const std::vector<uint8_t>& image, bool native, int64_t cycles) {
+    Bench bench;
+    bench.ram = image;
+
+    moira_callbacks cb = { &bench, read8, read16, write8, write16, nullptr, nullptr };
+    moira_handle h = moira_create(&cb);
+    if (!h) {
+        fprintf(stderr, "moira_create failed\n");
+        exit(1);
+    }
+
+    if (native) moira_map_region(h, 0, RamSize, bench.ram.data(), MOIRA_MAP_READ | MOIRA_MAP_WRITE);
+    moira_reset(h);
+
+    // Warm up caches and branch predictors, not measured
+    moira_execute_cycles(h, cycles / 20);
+    bench.reads8 = bench.reads16 = bench.writes8 = bench.writes16 = 0;
+
+    int64_t start = moira_getClock(h);
+    auto t0 = std::chrono::steady_clock::now();
+    moira_execute_cycles(h, cycles);
+    auto t1 = std::chrono::steady_clock::now();
+
+    Result r = { native ? "native" : "callbacks", std::chrono::duration<double>(t1 - t0).count(),
+        moira_getClock(h) - start, bench.accesses() };
+
+    moira_destroy(h);
+    return r;
+}
+
+struct Profile {
+    double cyclesPerInstr;
+    double accessesPerInstr;
+};
+
+// Average instruction length in cycles and bus accesses per instruction, from a short traced run
+// with the counters on (both are off while timing)
+Profile measureProfile(const std::vector<uint8_t>& image) {
+    Bench bench;
+    bench.ram = image;
+
+    moira_callbacks cb = { &bench, read8, read16, write8, write16, nullptr, nullptr };
+    moira_handle h = moira_create(&cb);
+    moira_map_region(h, 0, RamSize, bench.ram.data(), MOIRA_MAP_READ | MOIRA_MAP_WRITE);
+    moira_reset(h);
+
+    const uint32_t samples = 1 << 16;
+    moira_trace_enable(h, samples);
+    moira_counters_enable(h, 1);
+
+    moira_execute_cycles(h, samples * 4);
+    size_t count = moira_trace_fetch(h, nullptr, 0);
+    moira_counters c;
+    moira_get_counters(h, &c);
+
+    moira_destroy(h);
+    if (!count) return { 0.0, 0.0 };
+
+    uint64_t accesses = c.reads8 + c.reads16 + c.writes8 + c.writes16;
+    return { (double)c.cycles / (double)count, (double)accesses / (double)count };
+}
+
+void writeResult(FILE* out, const Result& r, const Profile& profile, bool last) {
+    double instructions = profile.cyclesPerInstr > 0 ? r.cycles / profile.cyclesPerInstr : 0;
+    double busAccesses = instructions * profile.accessesPerInstr;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"mode\": \"%s\",\n", r.mode);
+    fprintf(out, "      \"seconds\": %.6f,\n", r.seconds);
+    fprintf(out, "      \"cycles\": %lld,\n", (long long)r.cycles);
+    fprintf(out, "      \"instructions_per_sec\": %.0f,\n", r.seconds > 0 ? instructions / r.seconds : 0);
+    fprintf(out, "      \"emulated_mhz\": %.3f,\n", r.seconds > 0 ? r.cycles / r.seconds / 1e6 : 0);
+    fprintf(out, "      \"callbacks_per_instruction\": %.4f,\n", instructions > 0 ? r.callbacks / instructions : 0);
+
+    fprintf(out, "      \"ns_per_bus_access\": %.3f\n", busAccesses > 0 ? r.seconds * 1e9 / busAccesses : 0);
+
+    fprintf(out, "    }%s\n", last ? "" : ",");
+}
+
+const char* option(const char* arg, const char* name) {
+    size_t n = strlen(name);
+    return strncmp(arg, name, n) == 0 && arg[n] == '=' ? arg + n + 1 : nullptr;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int64_t cycles = 200000000;     // 25 seconds of ST time
+    const char* image = nullptr;
+    const char* outPath = nullptr;
+    uint32_t pc = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char* v;
+        if ((v = option(argv[i], "--cycles"))) cycles = strtoll(v, nullptr, 10);
+        else if ((v = option(argv[i], "--image"))) image = v;
+        else if ((v = option(argv[i], "--pc"))) pc = (uint32_t)strtoul(v, nullptr, 16);
+        else if ((v = option(argv[i], "--out"))) outPath = v;
+        else {
+            fprintf(stderr, "Usage: moira_bench [--cycles=N] [--image=<file> --pc=<hex>] [--out=<file>]\n");
+            return 1;
+        }
+    }
+
+    moira_build_info info;
+    moira_get_build_info(&info);
+    if (info.abi_version != MOIRA_C_ABI_VERSION) {
+        fprintf(stderr, "moira_bench built for C API %d, library has %u\n", MOIRA_C_ABI_VERSION, info.abi_version);
+        return 1;
+    }
+
+    std::vector<uint8_t> ram(RamSize, 0);
+    if (image) {
+        if (!loadImage(ram, image, pc)) {
+            fprintf(stderr, "Cannot load %s\n", image);
+            return 1;
+        }
+    } else {
+        buildSynthetic(ram);
+    }
+
+    Profile profile = measureProfile(ram);
+    Result callbacks = run(ram, false, cycles);
+    Result native = run(ram, true, cycles);
+
+    FILE* out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"profile\": \"%s\",\n", info.profile);
+    fprintf(out, "  \"abi_version\": %u,\n", info.abi_version);
+    fprintf(out, "  \"virtual_api\": %s,\n", info.virtual_api ? "true" : "false");
+    fprintf(out, "  \"precise_timing\": %s,\n", info.precise_timing ? "true" : "false");
+    fprintf(out, "  \"workload\": \"%s\",\n", image ? "image" : "synthetic");
+    fprintf(out, "  \"cycles_per_instruction\": %.3f,\n", profile.cyclesPerInstr);
+    fprintf(out, "  \"bus_accesses_per_instruction\": %.3f,\n", profile.accessesPerInstr);
+    fprintf(out, "  \"runs\": [\n");
+    writeResult(out, callbacks, profile, false);
+    writeResult(out, native, profile, true);
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}